@@ -11,17 +11,52 @@
  *              manuales construidos con exclusión mutua y variables de condición para gestionar el bloqueo de procesos cuando el espacio está lleno o 
  *              vacío. Se garantiza la integridad de los datos en la sección crítica y se previene el deadlock mediante señales de control sincronizadas.
  *
+ * Compilación: gcc -O2 -Wall -pthread BoundedBuffer.c -o BoundedBuffer -lm
+ *              gcc -O2 -Wall DecodificadorLog.c -o DecodificadorLog
+ * Uso:         ./BoundedBuffer --help
+ *
  * Autores:     André Pivaral, Ángel Mérida y José Sánchez 
  * Fecha:       20 de Febrero de 2026
  * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
  */
 
+#define _GNU_SOURCE             // CPU_SET y pthread_attr_setaffinity_np (--afinidad)
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <getopt.h>
+#include <semaphore.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <dirent.h>
+#include <ucontext.h>
+#include <limits.h>
+#include <math.h>
+
+#include "LogBinario.h"
 
 /* -------------------- PARÁMETROS CONFIGURABLES -------------------- */
 #define BUFFER_SIZE      5
@@ -29,61 +64,898 @@
 #define NUM_EMPACADORES  2
 #define DURACION_SEG    60
 
+// Rangos por defecto de los tiempos simulados (milisegundos)
+#define ESCANEO_MIN_MS  200
+#define ESCANEO_MAX_MS 1000
+#define EMPAQUE_MIN_MS  400
+#define EMPAQUE_MAX_MS 1600
+
+// Eventos de traza preasignados por hilo (--traza-eventos)
+#define EVENTOS_TRAZA  65536
+
+// Registros que acumula cada hilo antes de escribir al log binario
+#define REGISTROS_LOG_BINARIO 4096
+
+// Buffer de texto por hilo: bytes, líneas y tiempo máximo antes de escribir
+#define LOG_BYTES_HILO     (64 * 1024)
+#define LOG_LINEAS_HILO     256
+#define LOG_INTERVALO_MS    100
+
+// Llegadas en lazo abierto (--llegadas): tasa total, cola por cajero y MMPP
+#define TASA_LLEGADAS        10.0
+#define COLA_MAX_LLEGADAS    1024
+#define MMPP_FACTOR          10.0
+#define MMPP_NORMAL_MS       1000.0
+#define MMPP_RAFAGA_MS       100.0
+
+// Muestreo por defecto del nivel "muestreo" (1 de cada N productos)
+#define LOG_MUESTREO_DEFECTO 100
+
+// Group commit del journal (--journal): espera máxima y registros por lote
+#define JOURNAL_INTERVALO_MS 10
+#define JOURNAL_LOTE         256
+
+// Intervalo entre snapshots del estado (--snapshot-intervalo)
+#define SNAPSHOT_INTERVALO_MS 1000
+
+// Clases de prioridad del área (--prioridades) y espera a partir de la cual
+// un producto de menor prioridad se atiende antes (--envejecimiento)
+#define MAX_PRIORIDADES      4
+#define ENVEJECIMIENTO_MS    2000
+
+// Etapas que se pueden encadenar después del empacado (--etapa) y grupos
+// de consumidores que leen el área además de los empacadores (--grupo)
+#define MAX_ETAPAS           8
+#define MAX_GRUPOS           4
+
+/**
+ * Nivel del log de texto de eventos
+ *
+ * LOG_OFF:      Ninguna línea de los hilos (solo el reporte final)
+ * LOG_RESUMEN:  Sin eventos; solo la línea [FIN] de cada hilo
+ * LOG_MUESTREO: 1 de cada cfg.log_muestreo productos (entrada y salida)
+ * LOG_COMPLETO: Todos los eventos, salvo que actúe el limitador adaptativo
+ */
+typedef enum {
+    LOG_OFF = 0,
+    LOG_RESUMEN,
+    LOG_MUESTREO,
+    LOG_COMPLETO
+} NivelLog;
+
+static const char *nombres_nivel_log[] = { "off", "resumen", "muestreo", "completo" };
+#define NUM_NIVELES_LOG (int)(sizeof(nombres_nivel_log)/sizeof(nombres_nivel_log[0]))
+
+/**
+ * Proceso de llegada de productos a los cajeros
+ *
+ * LLEGADAS_CERRADO: Lazo cerrado; el cajero escanea el siguiente producto
+ *                   solo cuando colocó el anterior (comportamiento original)
+ * LLEGADAS_POISSON: Lazo abierto; llegadas de Poisson a cfg.tasa_llegadas
+ * LLEGADAS_MMPP:    Lazo abierto; Poisson modulado por una cadena de Markov
+ *                   de dos estados (normal y ráfaga)
+ */
+typedef enum {
+    LLEGADAS_CERRADO = 0,
+    LLEGADAS_POISSON,
+    LLEGADAS_MMPP
+} ModoLlegadas;
+
+static const char *nombres_llegadas[] = { "cerrado", "poisson", "mmpp" };
+#define NUM_MODOS_LLEGADAS (int)(sizeof(nombres_llegadas)/sizeof(nombres_llegadas[0]))
+
+/**
+ * Hilos que corre cada proceso en modo multiproceso (--proceso)
+ */
+typedef enum {
+    PROCESO_AMBOS = 0,          // Cajeros y empacadores
+    PROCESO_PRODUCTOR,          // Solo cajeros
+    PROCESO_CONSUMIDOR          // Solo empacadores
+} RolProceso;
+
+static const char *nombres_proceso[] = { "ambos", "productor", "consumidor" };
+#define NUM_ROLES_PROCESO (int)(sizeof(nombres_proceso)/sizeof(nombres_proceso[0]))
+
+/**
+ * Distribución de un tiempo de servicio (ver parsear_distribucion)
+ *
+ * a, b:  Parámetros en ms según el tipo (mín/máx, media, mediana/sigma, mínimo/alfa)
+ * tabla: Muestras ordenadas de la distribución empírica
+ * n:     Cantidad de muestras en 'tabla'
+ */
+typedef enum {
+    DIST_CONSTANTE = 0,
+    DIST_UNIFORME,
+    DIST_EXPONENCIAL,
+    DIST_LOGNORMAL,
+    DIST_PARETO,
+    DIST_EMPIRICA
+} TipoDistribucion;
+
+typedef struct {
+    TipoDistribucion tipo;
+    double           a;
+    double           b;
+    double          *tabla;
+    int              n;
+} Distribucion;
+
+/**
+ * Etapa del pipeline después del empacado (--etapa NOMBRE:HILOS:CAPACIDAD:DIST)
+ *
+ * nombre:    Nombre para el reporte (ej. "cargar")
+ * hilos:     Trabajadores de la etapa
+ * capacidad: Espacios del buffer de entrada de la etapa
+ * servicio:  Tiempo de trabajo de cada producto
+ */
+typedef struct {
+    char         nombre[16];
+    int          hilos;
+    int          capacidad;
+    Distribucion servicio;
+} DefEtapa;
+
+/**
+ * Grupo de consumidores que lee todos los productos del área además de
+ * los empacadores (--grupo NOMBRE:HILOS:DIST)
+ *
+ * nombre:   Nombre para el reporte (ej. "auditar")
+ * hilos:    Trabajadores del grupo
+ * servicio: Tiempo de trabajo de cada producto
+ */
+typedef struct {
+    char         nombre[16];
+    int          hilos;
+    Distribucion servicio;
+} DefGrupo;
+
+// Máximo de valores distintos por parámetro en un barrido
+#define MAX_VALORES_BARRIDO 64
+
+// Máximo de carriles independientes (--carriles)
+#define MAX_CARRILES 64
+
+// Tamaño de una página enorme (--paginas enormes)
+#define TAM_PAGINA_ENORME (2u * 1024 * 1024)
+
+// Línea de caché: alineación de cada contexto de hilo en la arena
+#define TAM_LINEA_CACHE 64
+
+// Hilos por encima de los cuales la tabla de utilización solo muestra totales
+#define MAX_FILAS_UTILIZACION 64
+
+// Modo corrutinas (--modo corrutinas): pila de cada corrutina
+#define PILA_CORRUTINA   (64 * 1024)
+
+// Rueda de tiempos jerárquica: resolución de un tick y niveles de
+// 2^RUEDA_BITS ranuras (4 niveles de 100 us cubren ~5 días)
+#define RUEDA_TICK_NS    100000ull
+#define RUEDA_NIVELES    4
+#define RUEDA_BITS       8
+#define RUEDA_RANURAS    (1 << RUEDA_BITS)
+
+// Eventos que atiende el bucle epoll por llamada a epoll_wait
+#define BUCLE_EVENTOS    64
+
+/**
+ * Cómo se ejecutan los cajeros y empacadores
+ *
+ * MODO_HILOS:      Un hilo del sistema por cajero y por empacador
+ * MODO_CORRUTINAS: Corrutinas en espacio de usuario sobre cfg.trabajadores
+ *                  hilos; las esperas suspenden la corrutina, no el hilo
+ * MODO_EPOLL:      Corrutinas sobre un bucle epoll (cfg.trabajadores hilos,
+ *                  uno por defecto): los semáforos avisan con eventfd, la
+ *                  rueda de tiempos con un timerfd y SIGINT/SIGTERM llegan
+ *                  por signalfd
+ */
+typedef enum {
+    MODO_HILOS = 0,
+    MODO_CORRUTINAS,
+    MODO_EPOLL
+} ModoEjecucion;
+
+static const char *nombres_modo[] = { "hilos", "corrutinas", "epoll" };
+#define NUM_MODOS (int)(sizeof(nombres_modo)/sizeof(nombres_modo[0]))
+
+/**
+ * Páginas con que se reserva el área de cada carril
+ *
+ * PAGINAS_NORMALES: Páginas base del sistema
+ * PAGINAS_ENORMES:  2 MB con MAP_HUGETLB; si no hay reservadas, un bloque
+ *                   alineado con MADV_HUGEPAGE (páginas enormes transparentes)
+ */
+typedef enum {
+    PAGINAS_NORMALES = 0,
+    PAGINAS_ENORMES
+} TipoPaginas;
+
+static const char *nombres_paginas[] = { "normales", "enormes" };
+#define NUM_TIPOS_PAGINAS (int)(sizeof(nombres_paginas)/sizeof(nombres_paginas[0]))
+
+/**
+ * Ubicación de los hilos de cada carril en las CPUs (ver ubicar_carriles)
+ */
+typedef enum {
+    AFINIDAD_NINGUNA = 0,       // El planificador decide
+    AFINIDAD_PARES,             // Cajero y empacador en CPUs hermanas
+    AFINIDAD_SOCKETS,           // Carriles repartidos entre sockets
+    AFINIDAD_NODOS              // Un carril por nodo NUMA
+} Afinidad;
+
+static const char *nombres_afinidad[] = { "ninguna", "pares", "sockets", "nodos" };
+#define NUM_AFINIDADES (int)(sizeof(nombres_afinidad)/sizeof(nombres_afinidad[0]))
+
+/**
+ * Qué hace un cajero cuando el área de su carril está llena (--lleno)
+ *
+ * LLENO_BLOQUEAR:        Espera en sem_empty sin límite
+ * LLENO_TIMEOUT:         Espera hasta cfg.lleno_timeout_ms y descarta el producto
+ * LLENO_DESCARTAR_NUEVO: Descarta el producto nuevo sin esperar
+ * LLENO_DESCARTAR_VIEJO: Reemplaza el producto más viejo del área
+ * LLENO_RECHAZAR:        Devuelve el producto al cajero, que lo vuelve a
+ *                        presentar después de otro tiempo de escaneo
+ */
+typedef enum {
+    LLENO_BLOQUEAR = 0,
+    LLENO_TIMEOUT,
+    LLENO_DESCARTAR_NUEVO,
+    LLENO_DESCARTAR_VIEJO,
+    LLENO_RECHAZAR
+} PoliticaLleno;
+
+static const char *nombres_lleno[] = { "bloquear", "timeout", "descartar-nuevo", "descartar-viejo", "rechazar" };
+#define NUM_POLITICAS_LLENO (int)(sizeof(nombres_lleno)/sizeof(nombres_lleno[0]))
+
+/**
+ * Backend de sincronización usado por los semáforos del área de empaque
+ *
+ * BACKEND_MANUAL: semáforo construido con mutex + variable de condición
+ * BACKEND_POSIX:  semáforo sem_t de la biblioteca (sem_wait/sem_post)
+ */
+typedef enum {
+    BACKEND_MANUAL = 0,
+    BACKEND_POSIX
+} Backend;
+
+static const char *nombres_backend[] = { "manual", "posix" };
+#define NUM_BACKENDS (int)(sizeof(nombres_backend)/sizeof(nombres_backend[0]))
+
+/**
+ * Configuración de una corrida de la simulación
+ *
+ * Los valores por defecto provienen de las constantes anteriores y pueden
+ * sobreescribirse desde la línea de comandos (ver uso()). Los hilos solo
+ * leen esta estructura; no cambia mientras la corrida está activa.
+ */
+typedef struct {
+    int     capacidad;          // Espacios del área de empaque
+    int     num_cajeros;        // Hilos productores
+    int     num_empacadores;    // Hilos consumidores
+    int     duracion_seg;       // Duración máxima de la corrida
+    long    max_items;          // Termina al empacar N productos (0 = sin límite)
+    Backend backend;            // Implementación de los semáforos
+    Distribucion escaneo;       // Tiempo de escaneo de cada producto
+    Distribucion empaque;       // Tiempo de empacado de cada producto
+    NivelLog log_nivel;         // Qué eventos se escriben en el log de texto
+    int     log_muestreo;       // N del nivel "muestreo" (1 de cada N productos)
+    long    log_limite_eps;     // Eventos/s totales antes de pasar a muestreo (0 = sin límite)
+    int     reporte_ms;         // Intervalo del reportero en vivo (0 = desactivado)
+    const char *ruta_metricas;  // Socket Unix del servidor de métricas (NULL = desactivado)
+    const char *ruta_traza;     // JSON de trace-events de Chrome (NULL = desactivado)
+    int     eventos_traza;      // Capacidad del buffer de traza de cada hilo
+    const char *ruta_log_binario; // Log binario de eventos (NULL = log de texto)
+    const char *ruta_log;       // Archivo para el log de texto (NULL = stdout)
+    int     log_intervalo_ms;   // Tiempo máximo que una línea espera en el buffer del hilo (ver vaciador_log)
+    const char *ruta_replay;    // Traza de llegadas de los cajeros (NULL = aleatorias)
+    double  replay_velocidad;   // Aceleración del replay (0 = sin esperas)
+    ModoLlegadas llegadas;      // Lazo cerrado o proceso de llegadas abierto
+    double  tasa_llegadas;      // Productos/s ofrecidos entre todos los cajeros
+    int     cola_max;           // Llegadas que pueden esperar a cada cajero
+    double  mmpp_factor;        // Multiplicador de la tasa durante una ráfaga
+    double  mmpp_normal_ms;     // Duración media del estado normal
+    double  mmpp_rafaga_ms;     // Duración media de una ráfaga
+    const char *ruta_shm;       // Segmento shm_open del área (NULL = memoria del proceso)
+    RolProceso proceso;         // Hilos que corre este proceso con --shm
+    const char *ruta_journal;   // Journal de productos del área (NULL = desactivado)
+    int     journal_intervalo_ms; // Espera máxima de un registro antes del fdatasync
+    int     journal_lote;       // Registros que disparan el fdatasync sin esperar el intervalo
+    int     journal_recuperar;  // 1 = recupera el journal existente, 0 = lo trunca
+    const char *ruta_snapshot;  // Snapshot del estado para reiniciar rápido (NULL = desactivado)
+    int     snapshot_ms;        // Intervalo entre snapshots
+    int     carriles;           // Áreas independientes con sus propios hilos
+    Afinidad afinidad;          // Ubicación de los hilos de cada carril
+    TipoPaginas paginas;        // Páginas del área de cada carril
+    int     prefault;           // 1 = toca toda el área antes de arrancar los hilos
+    int     mlock;              // 1 = bloquea el área en RAM
+    ModoEjecucion modo;         // Hilos del sistema o corrutinas
+    int     trabajadores;       // Hilos que ejecutan las corrutinas (0 = uno por CPU; epoll: uno)
+    PoliticaLleno lleno;        // Política del cajero con el área llena
+    int     lleno_timeout_ms;   // Espera máxima de LLENO_TIMEOUT
+    int     prioridades;        // Clases de prioridad del área (1 = FIFO único)
+    int     pesos_prioridad[MAX_PRIORIDADES]; // Peso relativo de cada clase al escanear
+    int     envejecimiento_ms;  // Espera que adelanta a una clase menor (0 = sin envejecimiento)
+    int     num_etapas;         // Etapas encadenadas después del empacado
+    DefEtapa etapas[MAX_ETAPAS];
+    int     num_grupos;         // Grupos de consumidores además de los empacadores
+    DefGrupo grupos[MAX_GRUPOS];
+} Configuracion;
+
+// Valores por defecto; los campos que no aparecen empiezan en 0 / NULL
+Configuracion cfg = {
+    .capacidad            = BUFFER_SIZE,
+    .num_cajeros          = NUM_CAJEROS,
+    .num_empacadores      = NUM_EMPACADORES,
+    .duracion_seg         = DURACION_SEG,
+    .backend              = BACKEND_MANUAL,
+    .escaneo              = { DIST_UNIFORME, ESCANEO_MIN_MS, ESCANEO_MAX_MS, NULL, 0 },
+    .empaque              = { DIST_UNIFORME, EMPAQUE_MIN_MS, EMPAQUE_MAX_MS, NULL, 0 },
+    .log_nivel            = LOG_COMPLETO,
+    .log_muestreo         = LOG_MUESTREO_DEFECTO,
+    .eventos_traza        = EVENTOS_TRAZA,
+    .log_intervalo_ms     = LOG_INTERVALO_MS,
+    .replay_velocidad     = 1.0,
+    .llegadas             = LLEGADAS_CERRADO,
+    .tasa_llegadas        = TASA_LLEGADAS,
+    .cola_max             = COLA_MAX_LLEGADAS,
+    .mmpp_factor          = MMPP_FACTOR,
+    .mmpp_normal_ms       = MMPP_NORMAL_MS,
+    .mmpp_rafaga_ms       = MMPP_RAFAGA_MS,
+    .proceso              = PROCESO_AMBOS,
+    .journal_intervalo_ms = JOURNAL_INTERVALO_MS,
+    .journal_lote         = JOURNAL_LOTE,
+    .journal_recuperar    = 1,
+    .snapshot_ms          = SNAPSHOT_INTERVALO_MS,
+    .carriles             = 1,
+    .afinidad             = AFINIDAD_NINGUNA,
+    .paginas              = PAGINAS_NORMALES,
+    .modo                 = MODO_HILOS,
+    .lleno                = LLENO_BLOQUEAR,
+    .prioridades          = 1,
+    .pesos_prioridad      = { 1 },
+    .envejecimiento_ms    = ENVEJECIMIENTO_MS,
+};
+
+/* -------------------- SONDAS USDT -------------------- */
+/**
+ * Puntos de instrumentación estática (USDT) para perf y bpftrace
+ *
+ * Cada sonda es una instrucción nop más una nota en la sección
+ * .note.stapsdt que indica dónde están los argumentos; si nadie la
+ * activa no cuesta nada más. Se usa <sys/sdt.h> (systemtap-sdt-dev)
+ * cuando está disponible y, si no, una versión mínima equivalente para
+ * x86-64 y aarch64. Compilar con -DSIN_SONDAS las elimina por completo.
+ *
+ * Todas las sondas del proveedor "supermercado" llevan tres argumentos:
+ *   arg0: Id del hilo: el rol en el bit 31 (0 = cajero, 1 = empacador,
+ *         igual que LOG_ROL_ACCION) y el id del hilo en los bits bajos
+ *   arg1: Índice del espacio del área de empaque (-1 si no aplica)
+ *   arg2: Ocupación del área, o el contador del semáforo en las sondas
+ *         sem_wait_entrada / sem_wait_salida / sem_signal (-1 con el
+ *         backend posix)
+ *
+ * Listar:  perf list 'sdt_supermercado:*'  (tras perf buildid-cache --add)
+ * Ejemplo: sudo bpftrace espera_semaforos.bt
+ */
+#if !defined(SIN_SONDAS) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define SONDA(nombre, tid, espacio, ocupados) \
+         DTRACE_PROBE3(supermercado, nombre, (int64_t)(tid), (int64_t)(espacio), (int64_t)(ocupados))
+#  endif
+#endif
+
+#if !defined(SONDA) && !defined(SIN_SONDAS) && (defined(__x86_64__) || defined(__aarch64__))
+#  define SONDA(nombre, tid, espacio, ocupados)                                           \
+    __asm__ __volatile__ (                                                                \
+        "990: nop\n"                                                                      \
+        ".pushsection .note.stapsdt,\"\",\"note\"\n"                                        \
+        ".balign 4\n"                                                                     \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                                \
+        "991: .asciz \"stapsdt\"\n"                                                       \
+        "992: .balign 4\n"                                                                \
+        "993: .8byte 990b\n"                                                              \
+        ".8byte _.stapsdt.base\n"                                                         \
+        ".8byte 0\n"                                                                      \
+        ".asciz \"supermercado\"\n"                                                       \
+        ".asciz \"" #nombre "\"\n"                                                        \
+        ".asciz \"-8@%[a0] -8@%[a1] -8@%[a2]\"\n"                                          \
+        "994: .balign 4\n"                                                                \
+        ".popsection\n"                                                                   \
+        ".ifndef _.stapsdt.base\n"                                                        \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"            \
+        ".weak _.stapsdt.base\n"                                                          \
+        ".hidden _.stapsdt.base\n"                                                        \
+        "_.stapsdt.base: .space 1\n"                                                      \
+        ".size _.stapsdt.base, 1\n"                                                       \
+        ".popsection\n"                                                                   \
+        ".endif\n"                                                                        \
+        :: [a0] "nor" ((int64_t)(tid)), [a1] "nor" ((int64_t)(espacio)),                  \
+           [a2] "nor" ((int64_t)(ocupados)))
+#endif
+
+#ifndef SONDA
+#  define SONDA(nombre, tid, espacio, ocupados) ((void)sizeof((tid) + (espacio) + (ocupados)))
+#endif
+
+// Id de un trabajador para las sondas y la traza: el rol en el bit alto,
+// así no se confunden los ids por muchos cajeros que haya
+#define SONDA_TID(rol, id) (((uint32_t)(rol) << 31) | (uint32_t)(id))
+
+// Id del hilo actual para las sondas (0 = hilo que no es trabajador)
+static __thread uint32_t sonda_tid = 0;
+
+/* -------------------- CORRUTINAS -------------------- */
+/**
+ * Estado en que una corrutina le devuelve el control al planificador
+ */
+typedef enum {
+    CORRUTINA_LISTA = 0,        // En la cola de listas o ejecutándose
+    CORRUTINA_DORMIDA,          // Esperando su plazo en la rueda de tiempos
+    CORRUTINA_BLOQUEADA,        // En la cola de espera de un semáforo
+    CORRUTINA_TERMINADA         // Su función retornó
+} EstadoCorrutina;
+
+/**
+ * Plazo programado en la rueda de tiempos (ver RUEDA DE TIEMPOS)
+ *
+ * siguiente, anterior: Enlaces de la ranura; 'anterior' apunta al enlace
+ *                      que apunta a este evento, para quitarlo en O(1)
+ *                      (NULL = no está en la rueda)
+ * vence:               Instante absoluto del reloj monotónico
+ * nivel:               Nivel de la rueda en que está
+ * vencer:              Se ejecuta en el hilo del reloj, sin locks tomados
+ */
+typedef struct EventoRueda {
+    struct EventoRueda  *siguiente;
+    struct EventoRueda **anterior;
+    uint64_t             vence;
+    int                  nivel;
+    void               (*vencer)(struct EventoRueda *);
+} EventoRueda;
+
+/**
+ * Cajero o empacador ejecutado como corrutina (--modo corrutinas)
+ *
+ * evento:        Plazo en la rueda mientras duerme (CORRUTINA_DORMIDA); es
+ *                el primer miembro para recuperar la corrutina desde él
+ * siguiente:     Enlace en la cola de listas o en la de un semáforo
+ * uc:            Contexto guardado (registros y pila)
+ * estado:        Motivo por el que devolvió el control
+ * soltar:        Mutex que el planificador libera después de cambiar de pila
+ * funcion, arg:  Cuerpo de la corrutina (cajero o empacador) y su ContextoHilo
+ * tid:           Id para las sondas
+ * espera_journal: Registro del journal cuya durabilidad espera
+ * rng, rng_pub:  Estado del generador, que es por hilo del sistema y aquí
+ *                se guarda y restaura en cada cambio de contexto
+ */
+typedef struct Corrutina {
+    EventoRueda       evento;
+    struct Corrutina *siguiente;
+    ucontext_t        uc;
+    EstadoCorrutina   estado;
+    pthread_mutex_t  *soltar;
+    void           *(*funcion)(void *);
+    void             *arg;
+    uint32_t          tid;
+    uint64_t          espera_journal;
+    uint64_t          rng;
+    uint64_t         *rng_pub;
+} Corrutina;
+
+/**
+ * Cola FIFO de corrutinas enlazadas por 'siguiente'
+ */
+typedef struct {
+    Corrutina *ini;
+    Corrutina *fin;
+} ColaCorrutinas;
+
+static inline void cola_corrutinas_agregar(ColaCorrutinas *c, Corrutina *co)
+{
+    co->siguiente = NULL;
+    if (c->fin) c->fin->siguiente = co;
+    else        c->ini = co;
+    c->fin = co;
+}
+
+static inline Corrutina *cola_corrutinas_sacar(ColaCorrutinas *c)
+{
+    Corrutina *co = c->ini;
+    if (co) {
+        c->ini = co->siguiente;
+        if (!c->ini) c->fin = NULL;
+    }
+    return co;
+}
+
+/**
+ * Quita 'co' de la cola si está en ella (O(n); solo al vencer un plazo)
+ *
+ * Retorna:
+ *   1 si estaba en la cola, 0 en caso contrario
+ */
+static int cola_corrutinas_quitar(ColaCorrutinas *c, Corrutina *co)
+{
+    Corrutina *previa = NULL, *x;
+    for (x = c->ini; x && x != co; x = x->siguiente) previa = x;
+    if (!x) return 0;
+    if (previa) previa->siguiente = co->siguiente;
+    else        c->ini = co->siguiente;
+    if (c->fin == co) c->fin = previa;
+    co->siguiente = NULL;
+    return 1;
+}
+
+/**
+ * Planificador de corrutinas, compartido por los hilos trabajadores
+ *
+ * Las corrutinas dormidas no están aquí sino en la rueda del reloj, que
+ * las devuelve a 'listas' al vencer su plazo.
+ *
+ * mtx:        Protege la cola de listas
+ * cond:       Despierta a los trabajadores ociosos cuando hay corrutinas listas
+ * ociosos:    Trabajadores esperando en 'cond'
+ * listas:     Corrutinas listas para ejecutarse
+ * vivas:      Corrutinas que no han terminado
+ * pilas:      Región con las pilas de todas las corrutinas
+ * tam_pilas:  Tamaño de 'pilas'
+ * cambios:    Cambios de contexto hacia una corrutina
+ */
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t  cond;
+    int             ociosos;
+    ColaCorrutinas  listas;
+    int             vivas;
+    void           *pilas;
+    size_t          tam_pilas;
+    uint64_t        cambios;
+} Planificador;
+
+Planificador planificador = { .mtx = PTHREAD_MUTEX_INITIALIZER };
+
+// Corrutina que ejecuta este hilo (NULL fuera del modo corrutinas) y
+// contexto del planificador al que vuelve al suspenderse
+static __thread Corrutina  *co_actual       = NULL;
+static __thread ucontext_t *uc_planificador = NULL;
+
+/**
+ * Devuelve el control al planificador del hilo
+ *
+ * Parámetros:
+ *   estado: Motivo (el planificador actúa según él después del cambio)
+ *   soltar: Mutex tomado por la corrutina que se libera ya en la pila del
+ *           planificador, para que nadie la reanude antes de que su
+ *           contexto esté guardado (NULL = ninguno)
+ */
+static void corrutina_suspender(EstadoCorrutina estado, pthread_mutex_t *soltar)
+{
+    Corrutina *co = co_actual;
+    co->estado = estado;
+    co->soltar = soltar;
+    swapcontext(&co->uc, uc_planificador);
+}
+
+/**
+ * Pasa una corrutina suspendida a la cola de listas
+ */
+static void corrutina_despertar(Corrutina *co)
+{
+    pthread_mutex_lock(&planificador.mtx);
+    co->estado = CORRUTINA_LISTA;
+    cola_corrutinas_agregar(&planificador.listas, co);
+    if (planificador.ociosos > 0) pthread_cond_signal(&planificador.cond);
+    pthread_mutex_unlock(&planificador.mtx);
+}
+
 /* -------------------- IMPLEMENTACIÓN SEMÁFORO -------------------- */
+/**
+ * Toma un mutex que puede ser robusto (modo multiproceso)
+ *
+ * Si el dueño anterior murió con el mutex tomado, lo marca consistente
+ * y continúa; el llamador decide si debe reparar el estado que protegía.
+ *
+ * Retorna:
+ *   1 si se recuperó el mutex de un proceso caído, 0 en caso normal
+ */
+static inline int mutex_bloquear(pthread_mutex_t *m)
+{
+    if (pthread_mutex_lock(m) == EOWNERDEAD) {
+        pthread_mutex_consistent(m);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Inicializa un mutex privado del proceso o compartido y robusto
+ */
+static void mutex_inicializar(pthread_mutex_t *m, int compartido)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if (compartido) {
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    }
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
 /**
  * Estructura de datos para implementar un semáforo manual
  * Utiliza un mutex y una variable de condición para sincronización
  * 
- * value: Contador del semáforo (número de recursos disponibles)
- * mtx:   Mutex para proteger el acceso a 'value'
- * cond:  Variable de condición para bloquear/despertar hilos
+ * value:   Contador del semáforo (número de recursos disponibles)
+ * mtx:     Mutex para proteger el acceso a 'value'
+ * cond:    Variable de condición para bloquear/despertar hilos
+ * backend: BACKEND_POSIX delega todas las operaciones en 'posix'
+ * posix:   Semáforo de la biblioteca (solo con BACKEND_POSIX)
+ *
+ * Entre procesos (--shm) la espera no usa 'cond': las variables de
+ * condición de glibc pueden quedar bloqueadas si muere un proceso con
+ * hilos esperando en ellas. En su lugar cada signal deja un permiso en
+ * 'permisos' y despierta con un futex a un hilo, que lo consume. Dentro
+ * de un proceso el signal también deja el permiso (protegido por 'mtx')
+ * antes de señalar 'cond': así una espera con plazo distingue si la
+ * despertó un signal o venció.
+ *
+ * compartido: 1 si el semáforo vive en memoria compartida entre procesos
+ * permisos:   Despertares pendientes de consumir
+ *
+ * En modo corrutinas quien espera es una corrutina: se encola en
+ * 'esperando' y se suspende sin bloquear su hilo. El signal le entrega
+ * el recurso directamente al pasarla a la cola de listas.
+ *
+ * esperando:  Corrutinas suspendidas en el semáforo
+ *
+ * En modo epoll el signal no despierta a la corrutina directamente: la
+ * pasa a 'despiertas' y escribe en el eventfd 'evfd', que atiende el
+ * bucle de eventos.
+ *
+ * evfd:       eventfd del semáforo (-1 = fuera del modo epoll)
+ * despiertas: Corrutinas que ya recibieron el recurso y esperan al bucle
  */
 typedef struct {
     int             value;
     pthread_mutex_t mtx;
     pthread_cond_t  cond;
+    Backend         backend;
+    sem_t           posix;
+    int             compartido;
+    uint32_t        permisos;
+    ColaCorrutinas  esperando;
+    int             evfd;
+    ColaCorrutinas  despiertas;
 } Semaforo;
 
+/**
+ * Espera en un futex compartido entre procesos mientras *dir valga 'esperado'
+ */
+static inline void futex_esperar(uint32_t *dir, uint32_t esperado)
+{
+    syscall(SYS_futex, dir, FUTEX_WAIT, esperado, NULL, NULL, 0);
+}
+
+/**
+ * Como futex_esperar, pero con un plazo absoluto del reloj monotónico
+ *
+ * Retorna:
+ *   0 si despertó o el valor ya era otro, -1 con errno = ETIMEDOUT al vencer
+ */
+static inline int futex_esperar_hasta(uint32_t *dir, uint32_t esperado, const struct timespec *limite)
+{
+    return (int)syscall(SYS_futex, dir, FUTEX_WAIT_BITSET, esperado, limite, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+static inline void futex_despertar(uint32_t *dir, int n)
+{
+    syscall(SYS_futex, dir, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+// Contador del semáforo para las sondas (lectura sin lock, solo informativa)
+#define SEM_VALOR_SONDA(s) \
+    ((s)->backend == BACKEND_MANUAL ? __atomic_load_n(&(s)->value, __ATOMIC_RELAXED) : -1)
+
 /**
  * Inicializa un semáforo con un valor inicial
  * 
  * Parámetros:
- *   s:     Puntero al semáforo a inicializar
- *   valor: Valor inicial del contador (número de recursos disponibles)
+ *   s:          Puntero al semáforo a inicializar
+ *   valor:      Valor inicial del contador (número de recursos disponibles)
+ *   backend:    Implementación a usar (manual o POSIX)
+ *   compartido: 1 si el semáforo vive en memoria compartida entre procesos
  * 
  * Inicializa el mutex y la variable de condición necesarios para
  * implementar las operaciones wait y signal del semáforo.
  */
-void sem_inicializar(Semaforo *s, int valor)
+void sem_inicializar(Semaforo *s, int valor, Backend backend, int compartido)
 {
-    s->value = valor;
-    pthread_mutex_init(&s->mtx, NULL);
-    pthread_cond_init(&s->cond, NULL);
+    s->backend = backend;
+    if (backend == BACKEND_POSIX) sem_init(&s->posix, compartido, (unsigned int)valor);
+    s->value      = valor;
+    s->compartido = compartido;
+    s->permisos   = 0;
+    s->esperando.ini = s->esperando.fin = NULL;
+    s->despiertas.ini = s->despiertas.fin = NULL;
+    s->evfd       = -1;
+    mutex_inicializar(&s->mtx, compartido);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    if (compartido) pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);  // Plazos de sem_wait_timeout
+    pthread_cond_init(&s->cond, &attr);
+    pthread_condattr_destroy(&attr);
 }
 
 /**
- * Operación WAIT del semáforo (también conocida como P o down)
- * 
+ * Espera de una corrutina con plazo en un semáforo (ver sem_wait_timeout)
+ *
+ * Vive en la pila de la corrutina mientras está suspendida. Si el plazo
+ * vence antes que un signal, su función la saca de la cola del semáforo
+ * y la despierta; si el signal llegó primero, la corrutina cancela el
+ * plazo o, si el reloj ya lo sacó de la rueda, espera a que su función
+ * termine antes de retornar (y liberar esta estructura).
+ *
+ * evento:    Plazo en la rueda (primer miembro: vencer() recibe su dirección)
+ * sem, co:   Semáforo y corrutina que espera
+ * expirada:  1 si venció el plazo sin recibir el recurso
+ * atendida:  1 cuando la función del plazo ya no toca la estructura
+ * esperando: 1 si la corrutina espera a que se atienda el plazo
+ */
+typedef struct {
+    EventoRueda evento;
+    Semaforo   *sem;
+    Corrutina  *co;
+    int         expirada;
+    int         atendida;
+    int         esperando;
+} EsperaCorrutina;
+
+static void reloj_programar(EventoRueda *ev, uint64_t vence);
+static int  reloj_cancelar(EventoRueda *ev);
+
+static void espera_corrutina_vencer(EventoRueda *ev)
+{
+    EsperaCorrutina *e = (EsperaCorrutina *)ev;
+    Semaforo        *s = e->sem;
+
+    mutex_bloquear(&s->mtx);
+    if (cola_corrutinas_quitar(&s->esperando, e->co)) {
+        s->value++;                     // Devuelve el lugar que había tomado
+        e->expirada = 1;
+        corrutina_despertar(e->co);
+    } else if (e->esperando) {
+        corrutina_despertar(e->co);
+    }
+    e->atendida = 1;
+    pthread_mutex_unlock(&s->mtx);
+}
+
+/**
+ * Operación WAIT del semáforo con plazo
+ *
  * Parámetros:
- *   s: Puntero al semáforo
- * 
+ *   s:      Puntero al semáforo
+ *   limite: Instante absoluto del reloj monotónico en que se deja de
+ *           esperar (0 = sin límite)
+ *
  * Decrementa el contador del semáforo. Si el resultado es negativo,
- * el hilo se bloquea esperando que otro hilo haga signal.
- * 
+ * el hilo se bloquea esperando que otro hilo haga signal; si el plazo
+ * vence antes, devuelve su lugar (incrementa el contador) y retorna.
+ *
  * Implementación:
  *   1. Adquiere el mutex para proteger la sección crítica
  *   2. Decrementa el contador
- *   3. Si el contador es negativo, el hilo se duerme en la variable de condición
+ *   3. Si el contador es negativo, el hilo espera un permiso del signal
+ *      (variable de condición, futex o cola de corrutinas)
  *   4. Libera el mutex al salir (o automáticamente si se bloquea)
+ *
+ * Retorna:
+ *   1 si el hilo tuvo que bloquearse, 0 si había recursos disponibles,
+ *   -1 si venció el plazo sin obtener el recurso
  */
-void sem_wait_manual(Semaforo *s)
+int sem_wait_timeout(Semaforo *s, uint64_t limite)
 {
-    pthread_mutex_lock(&s->mtx);        // Entra a sección crítica
+    int             bloqueado = 0;
+    struct timespec plazo     = { (time_t)(limite / 1000000000ull), (long)(limite % 1000000000ull) };
+
+    SONDA(sem_wait_entrada, sonda_tid, -1, SEM_VALOR_SONDA(s));
+    if (s->backend == BACKEND_POSIX) {
+        if (sem_trywait(&s->posix) != 0) {
+            int rc;
+            bloqueado = 1;
+            do {
+                rc = limite ? sem_clockwait(&s->posix, CLOCK_MONOTONIC, &plazo) : sem_wait(&s->posix);
+            } while (rc == -1 && errno == EINTR);
+            if (rc != 0) bloqueado = -1;
+        }
+        SONDA(sem_wait_salida, sonda_tid, -1, -1);
+        return bloqueado;
+    }
+    mutex_bloquear(&s->mtx);            // Entra a sección crítica
     s->value--;                         // Decrementa recurso
-    if (s->value < 0) {
-        pthread_cond_wait(&s->cond, &s->mtx);  // Bloquea si no hay recursos
+    if (s->value < 0 && s->compartido) {
+        bloqueado = 1;
+        // Bloquea hasta que haya un permiso; el futex compara el valor
+        // sin el mutex, así que un signal intermedio no se pierde
+        while (__atomic_load_n(&s->permisos, __ATOMIC_RELAXED) == 0) {
+            pthread_mutex_unlock(&s->mtx);
+            int rc = limite ? futex_esperar_hasta(&s->permisos, 0, &plazo) : (futex_esperar(&s->permisos, 0), 0);
+            mutex_bloquear(&s->mtx);
+            if (rc != 0 && errno == ETIMEDOUT && __atomic_load_n(&s->permisos, __ATOMIC_RELAXED) == 0) {
+                bloqueado = -1;
+                break;
+            }
+        }
+        if (bloqueado > 0) __atomic_store_n(&s->permisos, s->permisos - 1, __ATOMIC_RELAXED);
+        else               s->value++;  // Devuelve su lugar
+    } else if (s->value < 0 && co_actual) {
+        EsperaCorrutina e = { { NULL, NULL, 0, 0, espera_corrutina_vencer }, s, co_actual, 0, 0, 0 };
+        bloqueado = 1;
+        if (limite) reloj_programar(&e.evento, limite);
+        // El planificador suelta 'mtx' cuando el contexto ya está guardado
+        cola_corrutinas_agregar(&s->esperando, co_actual);
+        corrutina_suspender(CORRUTINA_BLOQUEADA, &s->mtx);
+        mutex_bloquear(&s->mtx);
+        if (e.expirada) {
+            bloqueado = -1;             // El plazo ya devolvió su lugar
+        } else if (limite && !reloj_cancelar(&e.evento)) {
+            // El plazo ya salió de la rueda: espera a que su función termine
+            while (!e.atendida) {
+                e.esperando = 1;
+                corrutina_suspender(CORRUTINA_BLOQUEADA, &s->mtx);
+                mutex_bloquear(&s->mtx);
+            }
+        }
+    } else if (s->value < 0) {
+        bloqueado = 1;
+        while (s->permisos == 0) {      // Bloquea si no hay recursos
+            if (!limite) {
+                pthread_cond_wait(&s->cond, &s->mtx);
+            } else if (pthread_cond_timedwait(&s->cond, &s->mtx, &plazo) == ETIMEDOUT && s->permisos == 0) {
+                bloqueado = -1;
+                break;
+            }
+        }
+        if (bloqueado > 0) s->permisos--;
+        else               s->value++;  // Devuelve su lugar
     }
+    int valor = s->value;
     pthread_mutex_unlock(&s->mtx);      // Sale de sección crítica
+    SONDA(sem_wait_salida, sonda_tid, -1, valor);
+    return bloqueado;
+}
+
+/**
+ * Operación WAIT del semáforo (también conocida como P o down)
+ *
+ * Igual a sem_wait_timeout() sin plazo.
+ *
+ * Retorna:
+ *   1 si el hilo tuvo que bloquearse, 0 si había recursos disponibles
+ */
+int sem_wait_manual(Semaforo *s)
+{
+    return sem_wait_timeout(s, 0);
+}
+
+/**
+ * Toma un recurso del semáforo solo si hay uno disponible
+ *
+ * Retorna:
+ *   0 si lo tomó, -1 si el contador no era positivo (no espera)
+ */
+int sem_trywait_manual(Semaforo *s)
+{
+    int tomado;
+    if (s->backend == BACKEND_POSIX) return sem_trywait(&s->posix) == 0 ? 0 : -1;
+    mutex_bloquear(&s->mtx);
+    tomado = s->value > 0;
+    if (tomado) s->value--;
+    pthread_mutex_unlock(&s->mtx);
+    return tomado ? 0 : -1;
 }
 
 /**
@@ -103,12 +975,29 @@ void sem_wait_manual(Semaforo *s)
  */
 void sem_signal_manual(Semaforo *s)
 {
-    pthread_mutex_lock(&s->mtx);        // Entra a sección crítica
+    int avisar = 0;
+    SONDA(sem_signal, sonda_tid, -1, SEM_VALOR_SONDA(s));
+    if (s->backend == BACKEND_POSIX) { sem_post(&s->posix); return; }
+    mutex_bloquear(&s->mtx);            // Entra a sección crítica
     s->value++;                         // Incrementa recurso
-    if (s->value <= 0) {
+    if (s->value <= 0 && s->compartido) {
+        __atomic_store_n(&s->permisos, s->permisos + 1, __ATOMIC_RELAXED);
+        futex_despertar(&s->permisos, 1);  // Despierta un hilo esperando
+    } else if (s->value <= 0 && s->esperando.ini) {
+        Corrutina *co = cola_corrutinas_sacar(&s->esperando);  // Le entrega el recurso
+        if (s->evfd < 0) {
+            corrutina_despertar(co);
+        } else {
+            // Basta un aviso mientras el bucle no haya recogido las anteriores
+            avisar = !s->despiertas.ini;
+            cola_corrutinas_agregar(&s->despiertas, co);
+        }
+    } else if (s->value <= 0) {
+        s->permisos++;
         pthread_cond_signal(&s->cond);  // Despierta un hilo esperando
     }
     pthread_mutex_unlock(&s->mtx);      // Sale de sección crítica
+    if (avisar) eventfd_write(s->evfd, 1);
 }
 
 /**
@@ -122,6 +1011,7 @@ void sem_signal_manual(Semaforo *s)
  */
 void sem_destruir(Semaforo *s)
 {
+    if (s->backend == BACKEND_POSIX) sem_destroy(&s->posix);
     pthread_mutex_destroy(&s->mtx);
     pthread_cond_destroy(&s->cond);
 }
@@ -137,252 +1027,6629 @@ static const char *productos[] = {
 /**
  * Estructura que representa un producto del supermercado
  * 
- * nombre: Nombre del producto (ej: "Leche", "Pan")
- * codigo: Código único del producto para identificación
+ * nombre:       Nombre del producto (ej: "Leche", "Pan")
+ * codigo:       Código único del producto para identificación
+ * catalogo:     Índice del producto en 'productos'
+ * t_escaneo_ns: Instante (reloj monotónico) en que el cajero terminó de escanearlo
+ * t_llegada_ns: Instante en que el producto llegó al cajero (en lazo cerrado,
+ *               cuando el cajero empezó a escanearlo)
+ * seq:          Secuencia del producto en el journal (--journal)
+ * prioridad:    Clase de prioridad (0 = la más urgente, ver --prioridades)
  */
 typedef struct {
-    char nombre[32];
-    int  codigo;
+    char     nombre[32];
+    int      codigo;
+    int      catalogo;
+    int      prioridad;
+    uint64_t t_escaneo_ns;
+    uint64_t t_llegada_ns;
+    uint64_t seq;
 } Producto;
 
-// Buffer circular compartido entre cajeros y empacadores
-Producto area_empaque[BUFFER_SIZE];  // Área donde se colocan productos escaneados
-int      indice_in   = 0;             // Índice donde el productor inserta (cajero)
-int      indice_out  = 0;             // Índice donde el consumidor extrae (empacador)
-int      total_producidos = 0;        // Contador total de productos escaneados
-int      total_consumidos = 0;        // Contador total de productos empacados
-
-/* -------------------- PRIMITIVAS SINCRONIZACIÓN -------------------- */
+/**
+ * Buffer circular de una clase de prioridad dentro del área
+ *
+ * Cada clase tiene 'capacidad' espacios propios, pero todas comparten el
+ * presupuesto del área: sem_empty cuenta los espacios libres del total.
+ * Los contadores permiten recalcular los índices (ver area_reparar).
+ *
+ * indice_in:  Índice donde el cajero inserta
+ * indice_out: Índice donde el empacador extrae
+ * producidos: Productos colocados en esta clase
+ * retirados:  Productos empacados o reemplazados de esta clase
+ */
+typedef struct {
+    int  indice_in;
+    int  indice_out;
+    long producidos;
+    long retirados;
+} AnilloPrioridad;
 
-// Semáforo que cuenta espacios vacíos en el buffer (inicia con BUFFER_SIZE)
-Semaforo        sem_empty;
+/**
+ * Área de empaque: buffer circular y todo su estado de sincronización
+ *
+ * Todo lo que cajeros y empacadores comparten vive en esta estructura,
+ * para poder ubicarla tanto en memoria del proceso (modo hilos) como en
+ * un segmento shm_open (--shm), donde la usan procesos separados. En el
+ * segundo caso las primitivas se crean con PTHREAD_PROCESS_SHARED y los
+ * mutex son robustos, para sobrevivir a la caída de otro proceso.
+ *
+ * magia:              AREA_MAGIA cuando el creador terminó de inicializarla
+ * capacidad:          Espacios de 'espacios' (la fija el creador)
+ * procesos:           Procesos conectados; el último en salir la elimina
+ * activa:             Bandera que controla la duración de la simulación;
+ *                     volatile asegura que el compilador no optimice su lectura
+ * prioridades:        Clases de prioridad (la fija el creador)
+ * envejecimiento_ns:  Espera a partir de la cual una clase menor pasa primero
+ * anillos:            Buffer circular de cada clase (solo el 0 sin --prioridades)
+ * total_producidos:   Contador total de productos escaneados
+ * total_consumidos:   Contador total de productos empacados
+ * total_sobrescritos: Productos reemplazados sin empacar (LLENO_DESCARTAR_VIEJO)
+ * politica:           Qué hace un cajero con el área llena (la fija el creador)
+ * espera_max_ns:      Espera máxima en sem_empty con LLENO_TIMEOUT
+ * total_promovidos:   Productos tomados antes que otros de mayor prioridad
+ *                     por haber esperado más que envejecimiento_ns
+ * ocupacion_integral: Suma de (espacios ocupados * ns), para la ocupación media
+ * t_creacion_ns:      Instante desde el que se integra la ocupación
+ * t_ultimo_cambio_ns: Instante del último cambio de ocupación
+ * sem_empty:          Cuenta espacios vacíos (inicia con la capacidad)
+ * sem_full:           Cuenta espacios llenos (inicia con 0)
+ * mutex:              Protege el buffer y los campos anteriores (sección crítica)
+ * espacios:           Productos colocados por los cajeros; la clase c ocupa
+ *                     los espacios [c * capacidad, (c + 1) * capacidad)
+ */
+typedef struct {
+    uint32_t        magia;
+    int             capacidad;
+    int             procesos;
+    volatile int    activa;
+    int             prioridades;
+    uint64_t        envejecimiento_ns;
+    AnilloPrioridad anillos[MAX_PRIORIDADES];
+    long            total_producidos;
+    long            total_consumidos;
+    long            total_sobrescritos;
+    PoliticaLleno   politica;
+    uint64_t        espera_max_ns;
+    long            total_promovidos;
+    uint64_t        ocupacion_integral;
+    uint64_t        t_creacion_ns;
+    uint64_t        t_ultimo_cambio_ns;
+    Semaforo        sem_empty;
+    Semaforo        sem_full;
+    pthread_mutex_t mutex;
+    Producto        espacios[];
+} AreaEmpaque;
 
-// Semáforo que cuenta espacios llenos en el buffer (inicia con 0)
-Semaforo        sem_full;
+#define AREA_MAGIA 0x534d4152u  // "SMAR"
 
-// Mutex para proteger el acceso al buffer compartido (sección crítica)
-pthread_mutex_t mutex;
+// Área de la corrida actual (memoria propia o segmento compartido)
+AreaEmpaque *area     = NULL;
+size_t       tam_area = 0;            // Bytes reservados o mapeados para cada área
 
-/* -------------------- CONTROL TIEMPO -------------------- */
-// Bandera global para controlar la duración de la simulación
-// volatile asegura que el compilador no optimice su lectura
-volatile int simulacion_activa = 1;
+// Carriles (--carriles): áreas independientes, cada una con sus cajeros y
+// empacadores; 'area' es el primero y el único con --shm, --journal o --replay
+AreaEmpaque **carriles     = NULL;
+int           num_carriles = 1;
 
-/* -------------------- UTILIDADES LOG -------------------- */
 /**
- * Imprime un evento de la simulación con formato consistente y timestamp
- * 
- * Parámetros:
- *   rol:      Tipo de hilo ("CAJERO" o "EMPACADOR")
- *   id:       Número identificador del hilo
- *   accion:   Descripción de la acción realizada
- *   producto: Nombre del producto involucrado
- *   ocupados: Número actual de espacios ocupados en el buffer
- * 
- * Formato de salida:
- *   [HH:MM:SS] ROL #ID | ACCIÓN | Producto: NOMBRE | Buffer: X/Y
+ * Repara el área después de recuperar 'mutex' de un proceso caído
+ *
+ * El proceso pudo morir entre copiar el producto, avanzar el índice y
+ * sumar el total. Como los totales se actualizan al final, los índices
+ * se recalculan a partir de ellos: un depósito o retiro a medias se
+ * descarta. Los semáforos pueden quedar con un permiso de diferencia
+ * (el que el proceso caído había tomado o no llegó a devolver).
  */
-void log_evento(const char *rol, int id, const char *accion,
-                const char *producto, int ocupados)
+static void area_reparar(void)
 {
-    time_t    t  = time(NULL);
-    struct tm *tm = localtime(&t);
-    printf("[%02d:%02d:%02d] %-10s #%d | %-35s | Producto: %-10s | Buffer: %d/%d\n",
-           tm->tm_hour, tm->tm_min, tm->tm_sec,
-           rol, id, accion, producto, ocupados, BUFFER_SIZE);
-    fflush(stdout);  // Asegura que el mensaje se imprima inmediatamente
+    for (int c = 0; c < area->prioridades; c++) {
+        AnilloPrioridad *r = &area->anillos[c];
+        r->indice_in  = (int)(r->producidos % area->capacidad);
+        r->indice_out = (int)(r->retirados  % area->capacidad);
+    }
 }
 
+/* -------------------- CONTROL TIEMPO -------------------- */
+
+// Permiten terminar la corrida antes de tiempo (límite de productos)
+pthread_mutex_t mtx_fin;
+pthread_cond_t  cond_fin;
+uint64_t        t_inicio_ns = 0;      // Instante en que arrancó la corrida
+uint64_t        t_fin_ns = 0;         // Instante en que se detuvo la simulación
+
 /**
- * Calcula el número de espacios ocupados en el buffer circular
- * 
- * Retorna:
- *   Número de productos actualmente en el buffer (0 a BUFFER_SIZE)
- * 
- * La fórmula maneja correctamente el caso cuando indice_in < indice_out
- * debido a que el buffer es circular.
+ * Retorna el instante actual del reloj monotónico en nanosegundos
+ *
+ * Se usa CLOCK_MONOTONIC para que las mediciones no se vean afectadas
+ * por ajustes del reloj del sistema.
  */
-int buffer_ocupados(void)
+static inline uint64_t ahora_ns(void)
 {
-    return (indice_in - indice_out + BUFFER_SIZE) % BUFFER_SIZE;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Incrementa un contador de un solo escritor de forma visible para lectores
+ *
+ * Como solo el hilo dueño escribe, basta leer y publicar con un store
+ * relajado; no se necesita una operación atómica de lectura-escritura.
+ */
+static inline void contador_sumar(uint64_t *c, uint64_t v)
+{
+    __atomic_store_n(c, *c + v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t contador_leer(const uint64_t *c)
+{
+    return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+/* -------------------- RUEDA DE TIEMPOS -------------------- */
+/**
+ * Rueda de tiempos jerárquica (hashed hierarchical timing wheel)
+ *
+ * Guarda todos los plazos pendientes de la corrida: escaneos y empaques
+ * simulados, esperas de llegadas y replay, y el fin de la simulación.
+ * Un plazo que vence en el tick t, a distancia d = t - tick del tick
+ * actual, va al nivel L más bajo con d < 2^(RUEDA_BITS*(L+1)), en la
+ * ranura (t >> RUEDA_BITS*L) % RUEDA_RANURAS. Insertar y quitar es O(1);
+ * cada tick procesa solo su ranura del nivel 0 y, cuando los bits bajos
+ * del tick dan la vuelta, reparte la ranura del nivel superior que toca
+ * entre los niveles inferiores (cascada).
+ *
+ * ranuras:  Listas doblemente enlazadas por nivel y ranura
+ * por_nivel: Eventos en cada nivel
+ * tick:     Siguiente tick por procesar
+ * n:        Eventos en la rueda
+ * eventos:  Plazos insertados en la corrida
+ * cascadas: Eventos movidos a un nivel inferior
+ */
+typedef struct {
+    EventoRueda *ranuras[RUEDA_NIVELES][RUEDA_RANURAS];
+    uint64_t     por_nivel[RUEDA_NIVELES];
+    uint64_t     tick;
+    uint64_t     n;
+    uint64_t     eventos;
+    uint64_t     cascadas;
+} RuedaTiempos;
+
+/**
+ * Coloca un evento en su nivel y ranura según su tick de vencimiento
+ */
+static void rueda_colocar(RuedaTiempos *r, EventoRueda *ev)
+{
+    uint64_t t = (ev->vence + RUEDA_TICK_NS - 1) / RUEDA_TICK_NS;
+    uint64_t d;
+    int      nivel = 0;
+
+    if (t < r->tick) t = r->tick;  // Ya venció: sale en el próximo tick
+    d = t - r->tick;
+    while (nivel < RUEDA_NIVELES - 1 && d >> (RUEDA_BITS * (nivel + 1))) nivel++;
+    if (d >> (RUEDA_BITS * RUEDA_NIVELES)) {
+        // Más allá del último nivel: se coloca al final y, al llegar a
+        // esa ranura antes de tiempo, rueda_vencer lo vuelve a colocar
+        t = r->tick + (1ull << (RUEDA_BITS * RUEDA_NIVELES)) - 1;
+    }
+
+    EventoRueda **ranura = &r->ranuras[nivel][(t >> (RUEDA_BITS * nivel)) & (RUEDA_RANURAS - 1)];
+    ev->siguiente = *ranura;
+    if (*ranura) (*ranura)->anterior = &ev->siguiente;
+    ev->anterior = ranura;
+    ev->nivel    = nivel;
+    *ranura      = ev;
+    r->por_nivel[nivel]++;
+}
+
+/**
+ * Quita un evento de la rueda (O(1))
+ */
+static void rueda_quitar(RuedaTiempos *r, EventoRueda *ev)
+{
+    *ev->anterior = ev->siguiente;
+    if (ev->siguiente) ev->siguiente->anterior = ev->anterior;
+    ev->siguiente = NULL;
+    ev->anterior  = NULL;
+    r->por_nivel[ev->nivel]--;
+}
+
+/**
+ * Inserta un evento con 'vence' asignado
+ *
+ * Parámetros:
+ *   ahora: Instante actual; con la rueda vacía el tick se adelanta a él,
+ *          para no recorrer los ticks en que no hubo nada
+ */
+static void rueda_insertar(RuedaTiempos *r, EventoRueda *ev, uint64_t ahora)
+{
+    if (r->n == 0 && r->tick < ahora / RUEDA_TICK_NS) r->tick = ahora / RUEDA_TICK_NS;
+    rueda_colocar(r, ev);
+    r->n++;
+    r->eventos++;
+}
+
+/**
+ * Reparte la ranura 'ranura' del nivel 'nivel' entre los niveles inferiores
+ */
+static void rueda_cascada(RuedaTiempos *r, int nivel, int ranura)
+{
+    EventoRueda *ev = r->ranuras[nivel][ranura];
+    r->ranuras[nivel][ranura] = NULL;
+    while (ev) {
+        EventoRueda *sig = ev->siguiente;
+        r->por_nivel[nivel]--;
+        rueda_colocar(r, ev);
+        r->cascadas++;
+        ev = sig;
+    }
+}
+
+/**
+ * Procesa los ticks transcurridos y saca de la rueda los eventos vencidos
+ *
+ * Parámetros:
+ *   ahora:   Instante actual
+ *   vencidos: Recibe la lista (enlazada por 'siguiente') de eventos vencidos
+ *
+ * Retorna:
+ *   Número de eventos vencidos
+ */
+static int rueda_vencer(RuedaTiempos *r, uint64_t ahora, EventoRueda **vencidos)
+{
+    uint64_t hasta = ahora / RUEDA_TICK_NS;
+    int      n = 0, nivel;
+
+    *vencidos = NULL;
+    for (; r->tick <= hasta && r->n > 0; r->tick++) {
+        // Cascada: cada vez que los bits de un nivel dan la vuelta, la
+        // ranura correspondiente del nivel siguiente baja un nivel
+        for (nivel = 1; nivel < RUEDA_NIVELES; nivel++) {
+            if (r->tick & ((1ull << (RUEDA_BITS * nivel)) - 1)) break;
+            rueda_cascada(r, nivel, (int)((r->tick >> (RUEDA_BITS * nivel)) & (RUEDA_RANURAS - 1)));
+        }
+
+        EventoRueda **ranura = &r->ranuras[0][r->tick & (RUEDA_RANURAS - 1)];
+        while (*ranura) {
+            EventoRueda *ev = *ranura;
+            rueda_quitar(r, ev);
+            if ((ev->vence + RUEDA_TICK_NS - 1) / RUEDA_TICK_NS > r->tick) {
+                rueda_colocar(r, ev);   // Estaba más allá del horizonte: sigue esperando
+                continue;
+            }
+            r->n--;
+            ev->siguiente = *vencidos;
+            *vencidos     = ev;
+            n++;
+        }
+    }
+    if (r->n == 0 && r->tick <= hasta) r->tick = hasta + 1;
+    return n;
+}
+
+/**
+ * Retorna el instante en que hay que volver a procesar la rueda (0 = vacía)
+ *
+ * Es exacto para los eventos del nivel 0; si hay eventos en niveles
+ * superiores es a lo sumo la próxima cascada, después de la cual el
+ * nivel 0 vuelve a tener los que están por vencer.
+ */
+static uint64_t rueda_proximo(const RuedaTiempos *r)
+{
+    uint64_t limite = RUEDA_RANURAS - (r->tick & (RUEDA_RANURAS - 1));  // Ticks a la próxima cascada
+    uint64_t i;
+
+    if (r->n == 0) return 0;
+    if (r->por_nivel[0] > 0) {
+        for (i = 0; i < RUEDA_RANURAS; i++) {
+            if (r->n > r->por_nivel[0] && i >= limite) break;
+            if (r->ranuras[0][(r->tick + i) & (RUEDA_RANURAS - 1)]) return (r->tick + i) * RUEDA_TICK_NS;
+        }
+    }
+    return (r->tick + limite) * RUEDA_TICK_NS;
+}
+
+/**
+ * Hilo del reloj y la rueda que maneja
+ *
+ * Un solo hilo procesa los plazos de todos los cajeros y empacadores:
+ * duerme hasta el próximo vencimiento, saca los eventos vencidos y ejecuta
+ * su función fuera del lock. Así una espera no ocupa un temporizador del
+ * kernel ni, en el modo corrutinas, un hilo del sistema.
+ *
+ * mtx:          Protege la rueda
+ * cond:         Despierta al hilo cuando llega un plazo anterior al que espera
+ * rueda:        Plazos pendientes
+ * espera_hasta: Instante que espera el hilo (0 = está procesando eventos)
+ * fd_timer:     En modo epoll no hay hilo: el bucle de eventos procesa la
+ *               rueda cuando vence este timerfd, armado en 'espera_hasta'
+ *               (UINT64_MAX = desarmado); -1 en los demás modos
+ * activo:       1 mientras el hilo corre
+ * terminar:     Pide al hilo que termine
+ * despertares:  Veces que el hilo despertó a procesar la rueda
+ */
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t  cond;
+    RuedaTiempos    rueda;
+    uint64_t        espera_hasta;
+    int             fd_timer;
+    int             activo;
+    int             terminar;
+    uint64_t        despertares;
+    pthread_t       hilo;
+} Reloj;
+
+Reloj reloj = { .mtx = PTHREAD_MUTEX_INITIALIZER, .fd_timer = -1 };
+
+/**
+ * Arma el timerfd del reloj para el instante 't' (0 = desarmarlo)
+ * Se llama con reloj.mtx tomado.
+ */
+static void reloj_armar(uint64_t t)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = (time_t)(t / 1000000000ull);
+    its.it_value.tv_nsec = (long)(t % 1000000000ull);
+    reloj.espera_hasta   = t ? t : UINT64_MAX;
+    timerfd_settime(reloj.fd_timer, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * Programa (o reprograma) un evento para el instante 'vence'
+ */
+static void reloj_programar(EventoRueda *ev, uint64_t vence)
+{
+    pthread_mutex_lock(&reloj.mtx);
+    if (ev->anterior) {  // Ya programado: se mueve
+        rueda_quitar(&reloj.rueda, ev);
+        reloj.rueda.n--;
+    }
+    ev->vence = vence;
+    rueda_insertar(&reloj.rueda, ev, ahora_ns());
+    // Solo hace falta despertar al reloj si espera un instante posterior;
+    // el timerfd se arma en el tick en que el plazo sale de la rueda
+    if (vence < reloj.espera_hasta) {
+        if (reloj.fd_timer >= 0) reloj_armar((vence + RUEDA_TICK_NS - 1) / RUEDA_TICK_NS * RUEDA_TICK_NS);
+        else                     pthread_cond_signal(&reloj.cond);
+    }
+    pthread_mutex_unlock(&reloj.mtx);
+}
+
+/**
+ * Quita un evento de la rueda si todavía no venció
+ *
+ * Retorna:
+ *   1 si lo quitó, 0 si ya había salido de la rueda (su función ya corrió
+ *   o está por correr)
+ */
+static int reloj_cancelar(EventoRueda *ev)
+{
+    int quitado;
+    pthread_mutex_lock(&reloj.mtx);
+    quitado = ev->anterior != NULL;
+    if (quitado) {
+        rueda_quitar(&reloj.rueda, ev);
+        reloj.rueda.n--;
+    }
+    pthread_mutex_unlock(&reloj.mtx);
+    return quitado;
+}
+
+/**
+ * Ejecuta las funciones de una lista de eventos vencidos (sin locks tomados)
+ */
+static void reloj_ejecutar(EventoRueda *ev)
+{
+    while (ev) {
+        EventoRueda *sig = ev->siguiente;  // vencer() puede reprogramarlo
+        ev->siguiente = NULL;
+        ev->vencer(ev);
+        ev = sig;
+    }
+}
+
+/**
+ * Atiende el timerfd del reloj (modo epoll): vence los plazos y lo rearma
+ */
+static void reloj_disparo(void)
+{
+    uint64_t     expiraciones;
+    EventoRueda *ev;
+
+    // Con varios hilos en el bucle, solo uno lee la expiración
+    if (read(reloj.fd_timer, &expiraciones, sizeof(expiraciones)) != (ssize_t)sizeof(expiraciones)) return;
+    pthread_mutex_lock(&reloj.mtx);
+    rueda_vencer(&reloj.rueda, ahora_ns(), &ev);
+    reloj_armar(rueda_proximo(&reloj.rueda));
+    reloj.despertares++;
+    pthread_mutex_unlock(&reloj.mtx);
+    reloj_ejecutar(ev);
+}
+
+/**
+ * Función del hilo del reloj: vence los plazos hasta que se pida terminar
+ */
+void *hilo_reloj(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&reloj.mtx);
+    while (!reloj.terminar) {
+        EventoRueda *ev;
+        if (rueda_vencer(&reloj.rueda, ahora_ns(), &ev) > 0) {
+            pthread_mutex_unlock(&reloj.mtx);
+            reloj_ejecutar(ev);
+            pthread_mutex_lock(&reloj.mtx);
+            continue;
+        }
+
+        uint64_t proximo = rueda_proximo(&reloj.rueda);
+        reloj.espera_hasta = proximo ? proximo : UINT64_MAX;
+        if (proximo) {
+            struct timespec ts = { (time_t)(proximo / 1000000000ull), (long)(proximo % 1000000000ull) };
+            pthread_cond_timedwait(&reloj.cond, &reloj.mtx, &ts);
+        } else {
+            pthread_cond_wait(&reloj.cond, &reloj.mtx);
+        }
+        reloj.espera_hasta = 0;
+        reloj.despertares++;
+    }
+    pthread_mutex_unlock(&reloj.mtx);
+    return NULL;
+}
+
+/**
+ * Limpia la rueda y arranca el hilo del reloj
+ *
+ * Parámetros:
+ *   con_timerfd: 1 = sin hilo; el bucle epoll atiende reloj.fd_timer
+ */
+static void reloj_iniciar(int con_timerfd)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&reloj.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    memset(&reloj.rueda, 0, sizeof(reloj.rueda));
+    reloj.rueda.tick   = ahora_ns() / RUEDA_TICK_NS;
+    reloj.espera_hasta = 0;
+    reloj.terminar     = 0;
+    reloj.despertares  = 0;
+    if (con_timerfd) {
+        reloj.fd_timer     = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        reloj.espera_hasta = UINT64_MAX;
+    } else {
+        pthread_create(&reloj.hilo, NULL, hilo_reloj, NULL);
+    }
+    __atomic_store_n(&reloj.activo, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Detiene el hilo del reloj; los eventos que queden en la rueda se descartan
+ */
+static void reloj_terminar(void)
+{
+    if (!reloj.activo) return;
+    if (reloj.fd_timer >= 0) {
+        close(reloj.fd_timer);
+        reloj.fd_timer = -1;
+    } else {
+        pthread_mutex_lock(&reloj.mtx);
+        reloj.terminar = 1;
+        pthread_cond_signal(&reloj.cond);
+        pthread_mutex_unlock(&reloj.mtx);
+        pthread_join(reloj.hilo, NULL);
+    }
+    __atomic_store_n(&reloj.activo, 0, __ATOMIC_RELEASE);
+    pthread_cond_destroy(&reloj.cond);
+}
+
+/**
+ * Espera de un hilo del sistema en la rueda
+ *
+ * El reloj publica 'listo' y despierta al hilo con un futex; el evento
+ * vive en la pila del hilo, que no retorna hasta ver 'listo'.
+ */
+typedef struct {
+    EventoRueda evento;     // Primer miembro: vencer() recibe su dirección
+    uint32_t    listo;
+} EsperaHilo;
+
+static void espera_hilo_vencer(EventoRueda *ev)
+{
+    EsperaHilo *e = (EsperaHilo *)ev;
+    __atomic_store_n(&e->listo, 1, __ATOMIC_RELEASE);
+    futex_despertar(&e->listo, 1);
+}
+
+static void corrutina_vencer(EventoRueda *ev)
+{
+    corrutina_despertar((Corrutina *)ev);
+}
+
+/**
+ * Duerme hasta un instante absoluto del reloj monotónico
+ *
+ * Una corrutina se suspende y el trabajador que la ejecutaba la programa
+ * en la rueda; un hilo programa un EsperaHilo y espera en su futex. Fuera
+ * de una corrida (sin hilo del reloj) se usa clock_nanosleep.
+ */
+static void dormir_hasta(uint64_t instante)
+{
+    if (co_actual) {
+        co_actual->evento.vence = instante;
+        corrutina_suspender(CORRUTINA_DORMIDA, NULL);
+        return;
+    }
+    if (__atomic_load_n(&reloj.activo, __ATOMIC_ACQUIRE)) {
+        EsperaHilo e = { { NULL, NULL, 0, 0, espera_hilo_vencer }, 0 };
+        reloj_programar(&e.evento, instante);
+        while (!__atomic_load_n(&e.listo, __ATOMIC_ACQUIRE)) futex_esperar(&e.listo, 0);
+        return;
+    }
+    struct timespec ts = { (time_t)(instante / 1000000000ull), (long)(instante % 1000000000ull) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// Fin de la corrida: vence a los cfg.duracion_seg o antes con
+// detener_simulacion(); con --shm, 'vigilancia' revisa cada 200 ms si otro
+// proceso detuvo la simulación
+EventoRueda evento_fin;
+EventoRueda evento_vigilancia;
+int         simulacion_finalizada = 0;
+
+static void pipeline_despertar(void);
+static void disruptor_despertar(void);
+
+/**
+ * Termina la corrida (función de evento_fin, idempotente)
+ *
+ * Comportamiento:
+ *   1. Establece 'activa' = 0 en todos los carriles para detener los hilos
+ *      y registra el instante de fin
+ *   2. Despierta al reportero y a los demás hilos que esperan en cond_fin
+ *   3. Envía señales a los semáforos para despertar hilos bloqueados
+ *      y permitirles terminar correctamente
+ */
+static void finalizar_simulacion(EventoRueda *ev)
+{
+    int i, k;
+    (void)ev;
+    pthread_mutex_lock(&mtx_fin);
+    if (simulacion_finalizada) {
+        pthread_mutex_unlock(&mtx_fin);
+        return;
+    }
+    simulacion_finalizada = 1;
+    for (k = 0; k < num_carriles; k++) carriles[k]->activa = 0;  // Señala a todos los hilos que deben terminar
+    t_fin_ns = ahora_ns();
+    pthread_cond_broadcast(&cond_fin);  // Despierta al reportero en vivo
+    pthread_mutex_unlock(&mtx_fin);
+
+    // Despierta todos los hilos que puedan estar bloqueados en semáforos
+    // para que puedan verificar 'activa' de su carril y terminar
+    for (k = 0; k < num_carriles; k++) {
+        for (i = 0; i < cfg.num_cajeros + cfg.num_empacadores; i++) {
+            sem_signal_manual(&carriles[k]->sem_full);   // Despierta empacadores
+            sem_signal_manual(&carriles[k]->sem_empty);  // Despierta cajeros
+        }
+    }
+    pipeline_despertar();
+    disruptor_despertar();
+}
+
+/**
+ * Con --shm, revisa si otro proceso bajó 'activa' del área compartida
+ */
+static void vigilar_area(EventoRueda *ev)
+{
+    if (!area->activa) finalizar_simulacion(ev);
+    else reloj_programar(ev, ahora_ns() + 200000000ull);
+}
+
+/**
+ * Detiene la simulación antes de que venza su duración
+ *
+ * Baja la bandera 'activa' de cada carril y adelanta evento_fin a ahora,
+ * con lo que el reloj libera a los hilos bloqueados en los semáforos y
+ * despierta al reportero en vivo si está activo.
+ * No debe llamarse con 'mutex' tomado.
+ */
+void detener_simulacion(void)
+{
+    pthread_mutex_lock(&mtx_fin);
+    for (int k = 0; k < num_carriles; k++) carriles[k]->activa = 0;
+    pthread_cond_broadcast(&cond_fin);  // Hilos de journal, snapshots y reportero
+    pthread_mutex_unlock(&mtx_fin);
+    if (reloj.activo) reloj_programar(&evento_fin, ahora_ns());
+}
+
+/* -------------------- HISTOGRAMA LATENCIA -------------------- */
+/**
+ * Histograma log-lineal de duraciones en nanosegundos
+ *
+ * Cada potencia de dos se divide en 2^HIST_SUB_BITS sub-intervalos, por lo
+ * que el error relativo de un percentil es menor a 12.5% sin importar la
+ * escala. Cada hilo registra en su propio histograma (sin sincronización)
+ * y al final se combinan; los valores se publican con contador_sumar()
+ * para que el servidor de métricas pueda leerlos durante la corrida.
+ *
+ * cuenta: Número de muestras por intervalo
+ * total:  Número total de muestras
+ * suma:   Suma de todas las muestras (para el promedio)
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t cuenta[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t suma;
+} Histograma;
+
+/**
+ * Calcula el intervalo del histograma que corresponde a un valor
+ */
+static inline int hist_indice(uint64_t v)
+{
+    if (v < HIST_SUB) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB
+           + (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/**
+ * Retorna el límite superior (inclusivo) del intervalo 'idx'
+ */
+static uint64_t hist_limite(int idx)
+{
+    if (idx < HIST_SUB) return (uint64_t)idx;
+    int      msb  = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t mant = (uint64_t)(idx % HIST_SUB + HIST_SUB);
+    return ((mant + 1) << (msb - HIST_SUB_BITS)) - 1;
+}
+
+static inline void hist_registrar(Histograma *h, uint64_t v)
+{
+    contador_sumar(&h->cuenta[hist_indice(v)], 1);
+    contador_sumar(&h->total, 1);
+    contador_sumar(&h->suma, v);
+}
+
+static void hist_combinar(Histograma *dst, const Histograma *src)
+{
+    int i;
+    for (i = 0; i < HIST_BUCKETS; i++) dst->cuenta[i] += src->cuenta[i];
+    dst->total += src->total;
+    dst->suma  += src->suma;
+}
+
+/**
+ * Estima el percentil 'p' (0-100) del histograma
+ *
+ * Retorna el límite superior del intervalo donde cae el percentil,
+ * o 0 si el histograma está vacío.
+ */
+static uint64_t hist_percentil(const Histograma *h, double p)
+{
+    if (h->total == 0) return 0;
+    uint64_t objetivo  = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    uint64_t acumulado = 0;
+    int i;
+    if (objetivo == 0) objetivo = 1;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        acumulado += h->cuenta[i];
+        if (acumulado >= objetivo) return hist_limite(i);
+    }
+    return hist_limite(HIST_BUCKETS - 1);
+}
+
+/* -------------------- ESTADÍSTICAS POR HILO -------------------- */
+/**
+ * Desglose del tiempo de vida de un hilo trabajador (reloj monotónico)
+ *
+ * ns_servicio:     Escaneo o empacado simulado (espera en la rueda)
+ * ns_espera_sem:   Bloqueado en sem_empty (cajero) o sem_full (empacador)
+ * ns_espera_mutex: Esperando para adquirir 'mutex'
+ * ns_sc:           Dentro de la sección crítica (con 'mutex' tomado)
+ * ns_total:        Tiempo de vida del hilo; la diferencia con la suma
+ *                  anterior es trabajo propio (crear producto, señales)
+ */
+typedef struct {
+    uint64_t ns_servicio;
+    uint64_t ns_espera_sem;
+    uint64_t ns_espera_mutex;
+    uint64_t ns_sc;
+    uint64_t ns_total;
+} TiemposHilo;
+
+/**
+ * Estado actual de un hilo trabajador, publicado para el reportero en vivo
+ */
+typedef enum {
+    ESTADO_TRABAJANDO = 0,      // Escaneando, empacando o entre operaciones
+    ESTADO_ESPERA_SEM,          // Bloqueado en sem_empty / sem_full
+    ESTADO_ESPERA_MUTEX,        // Esperando 'mutex'
+    ESTADO_EN_SC                // Dentro de la sección crítica
+} EstadoHilo;
+
+/**
+ * Contadores privados de cada hilo trabajador
+ *
+ * Solo el hilo dueño escribe en su estructura. Los contadores se
+ * publican con stores atómicos relajados (contador_sumar) para que el
+ * reportero en vivo y el servidor de métricas puedan leerlos sin tomar
+ * 'mutex'; ns_total lo lee main después de pthread_join.
+ *
+ * items:              Productos colocados (cajero) o tomados (empacador)
+ * estado:             EstadoHilo actual
+ * esperas_sem:        Llamadas a sem_wait_manual en el semáforo del rol
+ * esperas_bloqueadas: Cuántas de esas llamadas tuvieron que bloquearse
+ * contencion_mutex:   Adquisiciones de 'mutex' que lo encontraron tomado
+ * tiempos:            Desglose del tiempo de vida del hilo
+ * latencia:           Tiempo que cada producto pasó en el área (solo empacadores)
+ * latencia_llegada:   Desde la llegada al cajero hasta que se toma (solo empacadores)
+ * ns_entrega:         Esperando espacio en la primera etapa del pipeline
+ *                     (solo empacadores con --etapa)
+ *
+ * Llegadas en lazo abierto (solo cajeros):
+ * llegadas:           Productos que llegaron al cajero
+ * retrasados:         Llegaron con el cajero ocupado y esperaron en su cola
+ * descartados:        Llegaron con la cola llena y se perdieron
+ *
+ * Área llena (solo cajeros, según --lleno):
+ * lleno_descartados:  Productos nuevos descartados sin esperar
+ * lleno_sobrescritos: Productos viejos que el cajero reemplazó
+ * lleno_expirados:    Esperas en sem_empty que vencieron (producto descartado)
+ * lleno_rechazados:   Productos devueltos al cajero para reintentar
+ *
+ * rng:                Estado del generador del hilo (para los snapshots)
+ */
+typedef struct {
+    uint64_t    items;
+    int         estado;
+    uint64_t    esperas_sem;
+    uint64_t    esperas_bloqueadas;
+    uint64_t    contencion_mutex;
+    TiemposHilo tiempos;
+    Histograma  latencia;
+    Histograma  latencia_llegada;
+    uint64_t    ns_entrega;
+    uint64_t    llegadas;
+    uint64_t    retrasados;
+    uint64_t    descartados;
+    uint64_t    lleno_descartados;
+    uint64_t    lleno_sobrescritos;
+    uint64_t    lleno_expirados;
+    uint64_t    lleno_rechazados;
+    uint64_t    rng;
+} EstadisticasHilo;
+
+static inline void estado_publicar(EstadisticasHilo *st, EstadoHilo e)
+{
+    __atomic_store_n(&st->estado, (int)e, __ATOMIC_RELAXED);
+}
+
+/**
+ * Espera en un semáforo registrando la espera en las estadísticas del hilo
+ */
+static inline void sem_esperar_contado(Semaforo *s, EstadisticasHilo *st)
+{
+    int bloqueado = sem_wait_manual(s);
+    contador_sumar(&st->esperas_sem, 1);
+    if (bloqueado) contador_sumar(&st->esperas_bloqueadas, 1);
+}
+
+/**
+ * Adquiere 'm' contando si estaba tomado por otro hilo (contención)
+ */
+static inline void mutex_adquirir(pthread_mutex_t *m, EstadisticasHilo *st)
+{
+    int rc = pthread_mutex_trylock(m);
+    int recuperado;
+    if (rc == EBUSY) {
+        contador_sumar(&st->contencion_mutex, 1);
+        recuperado = mutex_bloquear(m);
+    } else {
+        recuperado = rc == EOWNERDEAD;
+        if (recuperado) pthread_mutex_consistent(m);
+    }
+    if (recuperado) area_reparar();
+}
+
+/* -------------------- CONTEXTO DE HILO -------------------- */
+/**
+ * Estado privado de un cajero o empacador
+ *
+ * Todos los contextos de la corrida viven en una sola arena reservada
+ * antes de crear los hilos (ver contextos_reservar): cada hilo recibe
+ * el puntero a su contexto y nunca llama al asignador durante la corrida.
+ * Las direcciones no cambian hasta la siguiente corrida, así que el
+ * reportero, el servidor de métricas y los snapshots leen 'estad' directo.
+ * Cada contexto ocupa líneas de caché propias para que los contadores de
+ * un hilo no compartan línea con los de otro (false sharing).
+ *
+ * hilo:           pthread del hilo
+ * id:             Número del hilo dentro de su rol (desde 1)
+ * rol:            ROL_CAJERO o ROL_EMPACADOR
+ * carril:         Índice del carril que atiende
+ * estad:          Contadores, tiempos e histogramas del hilo
+ * traza:          Buffer de traza (NULL sin --traza)
+ * logtxt:         Buffer del log de texto (NULL si no se usa)
+ * logbin:         Buffer del log binario (NULL sin --log-binario)
+ * cola_llegadas:  Cola de instantes de llegada (solo cajeros en lazo abierto)
+ * latencia_clase: Espera en el área de cada clase de prioridad (solo
+ *                 empacadores con --prioridades)
+ * co:             Corrutina del hilo (solo --modo corrutinas)
+ */
+typedef struct {
+    pthread_t                 hilo;
+    int                       id;
+    RolHilo                   rol;
+    int                       carril;
+    EstadisticasHilo          estad;
+    struct BufferTraza       *traza;
+    struct BufferLogTexto    *logtxt;
+    struct BufferLogBinario  *logbin;
+    uint64_t                 *cola_llegadas;
+    Histograma               *latencia_clase;
+    Corrutina                *co;
+} __attribute__((aligned(TAM_LINEA_CACHE))) ContextoHilo;
+
+void         *arena_hilos     = NULL;   // Única reserva de la corrida
+ContextoHilo *ctx_cajeros     = NULL;   // Primeros cfg.num_cajeros contextos de la arena
+ContextoHilo *ctx_empacadores = NULL;   // Siguientes cfg.num_empacadores
+
+/**
+ * Retorna el contexto del hilo indicado
+ */
+static inline ContextoHilo *contexto_de(RolHilo rol, int id)
+{
+    return rol == ROL_CAJERO ? &ctx_cajeros[id - 1] : &ctx_empacadores[id - 1];
+}
+
+/* -------------------- TRAZA DE SINCRONIZACIÓN -------------------- */
+/**
+ * Tipos de intervalo que se registran en la traza
+ */
+typedef enum {
+    SPAN_SERVICIO = 0,          // Escaneo (cajero) o empacado (empacador) simulado
+    SPAN_ESPERA_SEM,            // Dentro de sem_wait_manual
+    SPAN_ESPERA_MUTEX,          // Esperando 'mutex'
+    SPAN_SC                     // Con 'mutex' tomado
+} TipoSpan;
+
+/**
+ * Intervalo registrado por un hilo (instantes del reloj monotónico)
+ */
+typedef struct {
+    uint64_t inicio;
+    uint64_t fin;
+    uint32_t tipo;
+} RegistroTraza;
+
+/**
+ * Buffer de traza privado de un hilo
+ *
+ * Se reserva completo antes de crear los hilos, así que registrar un
+ * intervalo es solo escribir tres campos (los instantes ya se toman para
+ * la contabilidad de tiempos). Cuando se llena se cuentan los perdidos.
+ *
+ * eventos:   Arreglo preasignado de 'capacidad' registros
+ * n:         Registros usados
+ * perdidos:  Intervalos descartados por buffer lleno
+ */
+typedef struct BufferTraza {
+    RegistroTraza *eventos;
+    uint32_t       n;
+    uint32_t       capacidad;
+    uint64_t       perdidos;
+} BufferTraza;
+
+/**
+ * Registra un intervalo en el buffer de traza del hilo
+ *
+ * Parámetros:
+ *   b:      Buffer del hilo (NULL si la traza está desactivada)
+ *   tipo:   TipoSpan del intervalo
+ *   inicio: Instante de inicio (ahora_ns)
+ *   fin:    Instante de fin (ahora_ns)
+ */
+static inline void traza_registrar(BufferTraza *b, TipoSpan tipo, uint64_t inicio, uint64_t fin)
+{
+    if (!b) return;
+    if (b->n < b->capacidad) {
+        RegistroTraza *r = &b->eventos[b->n++];
+        r->inicio = inicio;
+        r->fin    = fin;
+        r->tipo   = (uint32_t)tipo;
+    } else {
+        b->perdidos++;
+    }
+}
+
+/**
+ * Escribe los intervalos de un grupo de hilos como trace-events "X"
+ *
+ * Parámetros:
+ *   f:        Archivo JSON de salida
+ *   c:        Contextos de los hilos del grupo
+ *   n:        Número de hilos
+ *   rol:      Nombre del rol para los metadatos ("CAJERO" / "EMPACADOR")
+ *   servicio: Nombre del intervalo de servicio del rol ("escaneo" / "empaque")
+ *   sem:      Nombre del semáforo que espera el rol
+ *   primero:  Indica si todavía no se ha escrito ningún evento (para las comas)
+ */
+static void traza_escribir_grupo(FILE *f, const ContextoHilo *c, int n, const char *rol,
+                                 const char *servicio, const char *sem, int *primero)
+{
+    const char *nombres[] = { servicio, sem, "espera mutex", "seccion critica" };
+    int i;
+    uint32_t j;
+    for (i = 0; i < n; i++) {
+        uint32_t tid = SONDA_TID(c[i].rol, c[i].id);
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"%s #%d\"}}", *primero ? "" : ",", tid, rol, i + 1);
+        *primero = 0;
+        for (j = 0; j < c[i].traza->n; j++) {
+            const RegistroTraza *r = &c[i].traza->eventos[j];
+            const char *nombre = nombres[r->tipo];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"sync\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                       "\"ts\":%.3f,\"dur\":%.3f}",
+                    nombre, tid, (double)(r->inicio - t_inicio_ns) / 1e3,
+                    (double)(r->fin - r->inicio) / 1e3);
+        }
+    }
+}
+
+/**
+ * Vuelca la traza de la corrida en formato JSON de trace-events de Chrome
+ *
+ * El archivo se puede abrir en Perfetto (ui.perfetto.dev) o en
+ * chrome://tracing. Cada hilo aparece como una pista con sus intervalos
+ * de servicio, espera de semáforo, espera de mutex y sección crítica.
+ *
+ * Retorna:
+ *   0 si se escribió el archivo, -1 si no se pudo abrir
+ */
+int traza_volcar(const char *ruta)
+{
+    FILE *f = fopen(ruta, "w");
+    int primero = 1, i;
+    uint64_t perdidos = 0;
+    if (!f) return -1;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    traza_escribir_grupo(f, ctx_cajeros, cfg.num_cajeros, "CAJERO",
+                         "escaneo", "sem_wait(sem_empty)", &primero);
+    traza_escribir_grupo(f, ctx_empacadores, cfg.num_empacadores, "EMPACADOR",
+                         "empaque", "sem_wait(sem_full)", &primero);
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    for (i = 0; i < cfg.num_cajeros;     i++) perdidos += ctx_cajeros[i].traza->perdidos;
+    for (i = 0; i < cfg.num_empacadores; i++) perdidos += ctx_empacadores[i].traza->perdidos;
+    if (perdidos > 0)
+        fprintf(stderr, "[TRAZA] %lu intervalos descartados por buffer lleno (ver --traza-eventos)\n",
+                (unsigned long)perdidos);
+    return 0;
+}
+
+/* -------------------- LOG BINARIO -------------------- */
+/**
+ * Buffer privado de registros binarios de un hilo
+ *
+ * registros: Arreglo preasignado de REGISTROS_LOG_BINARIO eventos
+ * n:         Registros pendientes de escribir
+ */
+typedef struct BufferLogBinario {
+    RegistroLog registros[REGISTROS_LOG_BINARIO];
+    int         n;
+} BufferLogBinario;
+
+int fd_log_binario = -1;     // Archivo del log binario (-1 = desactivado)
+
+/**
+ * Escribe los registros pendientes de un hilo en el log binario
+ *
+ * El archivo se abre con O_APPEND, así que cada bloque queda contiguo
+ * aunque varios hilos escriban a la vez.
+ */
+static void log_binario_vaciar(BufferLogBinario *b)
+{
+    const char *datos = (const char *)b->registros;
+    size_t      total = (size_t)b->n * sizeof(RegistroLog), escrito = 0;
+    while (escrito < total) {
+        ssize_t w = write(fd_log_binario, datos + escrito, total - escrito);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        escrito += (size_t)w;
+    }
+    b->n = 0;
+}
+
+/**
+ * Agrega un evento al buffer binario del hilo (copia de 24 bytes)
+ */
+static inline void log_binario_registrar(BufferLogBinario *b, RolHilo rol, int id, AccionLog accion,
+                                         int catalogo, int ocupados)
+{
+    RegistroLog *r = &b->registros[b->n];
+    r->ts_ns      = ahora_ns() - t_inicio_ns;
+    r->ocupados   = (uint32_t)ocupados;
+    r->id         = (uint32_t)id;
+    r->rol_accion = LOG_ROL_ACCION(rol, accion);
+    r->catalogo   = (uint8_t)catalogo;
+    memset(r->reservado, 0, sizeof(r->reservado));
+    if (++b->n == REGISTROS_LOG_BINARIO) log_binario_vaciar(b);
+}
+
+/**
+ * Crea el archivo del log binario y escribe su encabezado
+ *
+ * Retorna:
+ *   0 si se pudo crear, -1 en caso contrario (errno indica la causa)
+ */
+static int log_binario_abrir(const char *ruta)
+{
+    EncabezadoLog enc;
+    struct timespec real;
+    int i;
+
+    fd_log_binario = open(ruta, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd_log_binario < 0) return -1;
+
+    // t_inicio_ns (monotónico) corresponde a este instante de reloj real
+    clock_gettime(CLOCK_REALTIME, &real);
+    memset(&enc, 0, sizeof(enc));
+    memcpy(enc.magia, LOG_MAGIA, sizeof(enc.magia));
+    enc.version        = LOG_VERSION;
+    enc.tam_registro   = sizeof(RegistroLog);
+    enc.capacidad      = (uint32_t)cfg.capacidad;
+    enc.num_productos  = NUM_PRODUCTOS;
+    enc.t_base_real_ns = (uint64_t)real.tv_sec * 1000000000ull + (uint64_t)real.tv_nsec
+                         - (ahora_ns() - t_inicio_ns);
+    for (i = 0; i < NUM_PRODUCTOS && i < LOG_MAX_CATALOGO; i++)
+        strncpy(enc.catalogo[i], productos[i], LOG_LARGO_NOMBRE - 1);
+
+    if (write(fd_log_binario, &enc, sizeof(enc)) != (ssize_t)sizeof(enc)) {
+        close(fd_log_binario);
+        fd_log_binario = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Escribe los buffers pendientes de todos los hilos y cierra el archivo
+ */
+static void log_binario_cerrar(void)
+{
+    int i;
+    if (fd_log_binario < 0) return;
+    for (i = 0; i < cfg.num_cajeros;     i++) log_binario_vaciar(ctx_cajeros[i].logbin);
+    for (i = 0; i < cfg.num_empacadores; i++) log_binario_vaciar(ctx_empacadores[i].logbin);
+    close(fd_log_binario);
+    fd_log_binario = -1;
+}
+
+/* -------------------- LOG DE TEXTO POR HILO -------------------- */
+/**
+ * Buffer privado de líneas de log de un hilo
+ *
+ * Cada evento se formatea directamente en 'datos' y se agrega un iovec
+ * que apunta a la línea. El buffer se escribe con un solo writev cuando
+ * se llena, cuando el hilo vaciador_log lo encuentra con líneas de más de
+ * cfg.log_intervalo_ms (aunque el hilo esté bloqueado) o al terminar el
+ * hilo; así cada evento ya no cuesta un printf + fflush.
+ *
+ * mutex:       Protege las líneas pendientes entre el hilo y vaciador_log
+ *              (casi nunca hay contención)
+ * datos:       Texto de las líneas pendientes
+ * usado:       Bytes ocupados en 'datos'
+ * lineas:      Un iovec por línea pendiente
+ * n:           Líneas pendientes
+ * t_primera:   Instante (monotónico) de la línea más vieja pendiente
+ * segundo:     Segundo de reloj real del último timestamp formateado
+ * hhmmss:      "HH:MM:SS" de 'segundo' (evita un localtime_r por evento)
+ *
+ * Muestreo (ver log_muestrear):
+ * escritos:        Eventos escritos en el log
+ * descartados:     Eventos omitidos por el nivel, el muestreo o el limitador
+ * productos:       Productos vistos (el muestreo decide por producto)
+ * factor:          Muestreo actual del limitador adaptativo (1 = todo)
+ * ventana_inicio:  Inicio de la ventana de 1 s del limitador
+ * ventana_eventos: Eventos vistos en la ventana actual
+ * ventana_escritos: Eventos escritos en la ventana actual
+ * escribir_salida: Decisión tomada en la entrada, que aplica a su "SALE SC"
+ */
+typedef struct BufferLogTexto {
+    pthread_mutex_t mutex;
+    char         datos[LOG_BYTES_HILO];
+    size_t       usado;
+    struct iovec lineas[LOG_LINEAS_HILO];
+    int          n;
+    uint64_t     t_primera;
+    time_t       segundo;
+    char         hhmmss[16];
+    uint64_t     escritos;
+    uint64_t     descartados;
+    uint64_t     productos;
+    uint64_t     factor;
+    uint64_t     ventana_inicio;
+    uint64_t     ventana_eventos;
+    uint64_t     ventana_escritos;
+    int          escribir_salida;
+} BufferLogTexto;
+
+int fd_log_texto = STDOUT_FILENO;  // stdout o --log-archivo
+
+// Serializa las escrituras de los buffers para que las líneas nunca se
+// mezclen (writev solo es atómico en pipes hasta PIPE_BUF bytes)
+pthread_mutex_t mtx_salida_log = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Escribe las líneas pendientes de un hilo con un solo writev (con
+ * b->mutex tomado)
+ */
+static void log_texto_escribir(BufferLogTexto *b)
+{
+    struct iovec *iov = b->lineas;
+    int           n   = b->n;
+    if (n == 0) return;
+
+    pthread_mutex_lock(&mtx_salida_log);
+    if (fd_log_texto == STDOUT_FILENO) fflush(stdout);  // Respeta lo ya impreso con printf
+    while (n > 0) {
+        ssize_t w = writev(fd_log_texto, iov, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        // Escritura parcial: avanza los iovec ya escritos
+        while (n > 0 && (size_t)w >= iov->iov_len) { w -= (ssize_t)iov->iov_len; iov++; n--; }
+        if (n > 0) { iov->iov_base = (char *)iov->iov_base + w; iov->iov_len -= (size_t)w; }
+    }
+    pthread_mutex_unlock(&mtx_salida_log);
+    b->n = 0;
+    b->usado = 0;
+}
+
+/**
+ * Escribe las líneas pendientes de un hilo
+ */
+static void log_texto_vaciar(BufferLogTexto *b)
+{
+    pthread_mutex_lock(&b->mutex);
+    log_texto_escribir(b);
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/**
+ * Agrega una línea formateada al buffer del hilo
+ *
+ * Parámetros:
+ *   b:   Buffer del hilo
+ *   fmt: Formato printf de la línea (debe terminar en '\n')
+ */
+static void log_texto_agregar(BufferLogTexto *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void log_texto_agregar(BufferLogTexto *b, const char *fmt, ...)
+{
+    va_list ap;
+    int     largo;
+    uint64_t ahora = ahora_ns();
+
+    pthread_mutex_lock(&b->mutex);
+    for (;;) {
+        size_t libre = sizeof(b->datos) - b->usado;
+        va_start(ap, fmt);
+        largo = vsnprintf(b->datos + b->usado, libre, fmt, ap);
+        va_end(ap);
+        if (largo < 0) { pthread_mutex_unlock(&b->mutex); return; }
+        if ((size_t)largo < libre && b->n < LOG_LINEAS_HILO) break;
+        if (b->n == 0) { largo = (int)libre - 1; break; }  // Línea más grande que el buffer: se trunca
+        log_texto_escribir(b);
+    }
+
+    if (b->n == 0) b->t_primera = ahora;
+    b->lineas[b->n].iov_base = b->datos + b->usado;
+    b->lineas[b->n].iov_len  = (size_t)largo;
+    b->n++;
+    b->usado += (size_t)largo;
+
+    if (b->n == LOG_LINEAS_HILO ||
+        ahora - b->t_primera >= (uint64_t)cfg.log_intervalo_ms * 1000000ull)
+        log_texto_escribir(b);
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/**
+ * Función del hilo vaciador del log de texto (con --log-intervalo > 0)
+ *
+ * Cada cfg.log_intervalo_ms escribe las líneas pendientes de todos los
+ * buffers, así ninguna espera más que eso aunque su hilo siga bloqueado
+ * en un semáforo. Los hilos vacían lo que queda al terminar.
+ */
+void *vaciador_log(void *arg)
+{
+    (void)arg;
+    int n = cfg.num_cajeros + cfg.num_empacadores;
+    struct timespec limite;
+    clock_gettime(CLOCK_MONOTONIC, &limite);
+
+    pthread_mutex_lock(&mtx_fin);
+    while (area->activa) {
+        limite.tv_nsec += (long)(cfg.log_intervalo_ms % 1000) * 1000000L;
+        limite.tv_sec  += cfg.log_intervalo_ms / 1000 + limite.tv_nsec / 1000000000L;
+        limite.tv_nsec %= 1000000000L;
+        while (area->activa &&
+               pthread_cond_timedwait(&cond_fin, &mtx_fin, &limite) != ETIMEDOUT) ;
+        if (!area->activa) break;
+        pthread_mutex_unlock(&mtx_fin);
+
+        for (int i = 0; i < n; i++) log_texto_vaciar(ctx_cajeros[i].logtxt);  // Los empacadores siguen a los cajeros
+
+        pthread_mutex_lock(&mtx_fin);
+    }
+    pthread_mutex_unlock(&mtx_fin);
+    return NULL;
+}
+
+/**
+ * Retorna el buffer de texto del hilo indicado (NULL si no hay buffers)
+ */
+static inline BufferLogTexto *log_texto_buffer(RolHilo rol, int id)
+{
+    return contexto_de(rol, id)->logtxt;
+}
+
+/**
+ * Formatea el timestamp [HH:MM:SS] del buffer, recalculándolo solo
+ * cuando cambia el segundo
+ */
+static const char *log_texto_hora(BufferLogTexto *b)
+{
+    time_t t = time(NULL);
+    if (t != b->segundo) {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        snprintf(b->hhmmss, sizeof(b->hhmmss), "%02d:%02d:%02d", tm.tm_hour, tm.tm_min, tm.tm_sec);
+        b->segundo = t;
+    }
+    return b->hhmmss;
+}
+
+/**
+ * Decide si un evento se escribe según el nivel y el limitador adaptativo
+ *
+ * Parámetros:
+ *   b:      Buffer (y estado de muestreo) del hilo
+ *   accion: Acción del evento; "SALE SC" sigue la decisión de su entrada
+ *           para no dejar líneas huérfanas
+ *
+ * Retorna:
+ *   1 si el evento debe escribirse, 0 si se descarta (y se cuenta)
+ *
+ * Limitador: cfg.log_limite_eps se reparte entre los hilos. Al cerrar
+ * cada ventana de 1 s el hilo calcula el muestreo necesario para quedar
+ * bajo su cuota con la tasa observada; dentro de la ventana, si aun así
+ * la supera, descarta el resto hasta la siguiente. Todo es estado privado
+ * del hilo, sin contadores compartidos en el camino de cada evento.
+ */
+static int log_muestrear(BufferLogTexto *b, AccionLog accion)
+{
+    int escribir;
+
+    if (accion == ACCION_SALE_SC) {
+        escribir = b->escribir_salida;
+    } else if (cfg.log_nivel < LOG_MUESTREO) {
+        escribir = 0;
+    } else {
+        uint64_t factor = cfg.log_nivel == LOG_MUESTREO ? (uint64_t)cfg.log_muestreo : 1;
+        uint64_t cuota  = 0;
+
+        if (cfg.log_limite_eps > 0) {
+            uint64_t ahora = ahora_ns();
+            cuota = (uint64_t)cfg.log_limite_eps / (uint64_t)(cfg.num_cajeros + cfg.num_empacadores);
+            if (cuota == 0) cuota = 1;
+            if (ahora - b->ventana_inicio >= 1000000000ull) {
+                // Nueva ventana: muestreo proporcional a la tasa observada
+                double seg = (double)(ahora - b->ventana_inicio) / 1e9;
+                double tasa = (double)b->ventana_eventos / seg;
+                b->factor = tasa > (double)cuota ? (uint64_t)(tasa / (double)cuota) + 1 : 1;
+                b->ventana_inicio   = ahora;
+                b->ventana_eventos  = 0;
+                b->ventana_escritos = 0;
+            }
+            if (b->factor > factor) factor = b->factor;
+        }
+
+        escribir = (b->productos++ % factor) == 0;
+        if (cuota && b->ventana_escritos >= cuota) escribir = 0;
+        b->escribir_salida = escribir;
+    }
+
+    b->ventana_eventos++;
+    if (escribir) { b->escritos++; b->ventana_escritos++; }
+    else          b->descartados++;
+    return escribir;
+}
+
+/* -------------------- UTILIDADES LOG -------------------- */
+/**
+ * Registra un evento de la simulación con formato consistente y timestamp
+ * 
+ * Parámetros:
+ *   rol:      Tipo de hilo (ROL_CAJERO o ROL_EMPACADOR)
+ *   id:       Número identificador del hilo
+ *   accion:   Acción realizada (ver nombres_accion)
+ *   p:        Producto involucrado
+ *   ocupados: Número actual de espacios ocupados en el buffer
+ * 
+ * Formato de salida:
+ *   [HH:MM:SS] ROL #ID | ACCIÓN | Producto: NOMBRE | Buffer: X/Y
+ *
+ * Con --log-binario el evento se copia al buffer binario del hilo en
+ * lugar de formatearse (DecodificadorLog reproduce este formato). Sin él,
+ * la línea se agrega al buffer de texto del hilo, que se escribe por
+ * bloques en stdout o en --log-archivo. Qué eventos se escriben depende
+ * de cfg.log_nivel y del limitador (ver log_muestrear); el log binario
+ * siempre es completo.
+ */
+void log_evento(RolHilo rol, int id, AccionLog accion,
+                const Producto *p, int ocupados)
+{
+    if (fd_log_binario >= 0) {
+        log_binario_registrar(contexto_de(rol, id)->logbin, rol, id, accion, p->catalogo, ocupados);
+        return;
+    }
+    if (cfg.log_nivel == LOG_OFF) return;
+
+    BufferLogTexto *b = log_texto_buffer(rol, id);
+    if (b) {
+        if (!log_muestrear(b, accion)) return;
+        log_texto_agregar(b, "[%s] %-10s #%d | %-35s | Producto: %-10s | Buffer: %d/%d\n",
+                          log_texto_hora(b), nombres_rol[rol], id, nombres_accion[accion],
+                          p->nombre, ocupados, cfg.capacidad);
+        return;
+    }
+
+    if (cfg.log_nivel != LOG_COMPLETO) return;  // Sin buffer no hay estado de muestreo
+
+    time_t    t  = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    printf("[%02d:%02d:%02d] %-10s #%d | %-35s | Producto: %-10s | Buffer: %d/%d\n",
+           tm.tm_hour, tm.tm_min, tm.tm_sec,
+           nombres_rol[rol], id, nombres_accion[accion], p->nombre, ocupados, cfg.capacidad);
+    fflush(stdout);  // Asegura que el mensaje se imprima inmediatamente
+}
+
+/**
+ * Calcula el número de espacios ocupados en el buffer circular
+ * 
+ * Parámetros:
+ *   a: Área (carril) a consultar
+ *
+ * Retorna:
+ *   Número de productos actualmente en el buffer (0 a cfg.capacidad)
+ * 
+ * Se calcula con los contadores en lugar de los índices, ya que con
+ * el buffer lleno indice_in == indice_out y la resta daría 0. Suma
+ * todas las clases de prioridad.
+ * Debe llamarse con 'mutex' tomado.
+ */
+int buffer_ocupados(const AreaEmpaque *a)
+{
+    // Con --grupo los consumidores avanzan total_consumidos sin 'mutex'
+    return (int)(a->total_producidos - __atomic_load_n(&a->total_consumidos, __ATOMIC_RELAXED) - a->total_sobrescritos);
+}
+
+/**
+ * Acumula la ocupación actual desde el último cambio hasta 'ahora'
+ *
+ * Debe llamarse con 'mutex' tomado y antes de modificar el buffer.
+ */
+static void acumular_ocupacion(AreaEmpaque *a, uint64_t ahora)
+{
+    if (ahora > a->t_ultimo_cambio_ns) {
+        a->ocupacion_integral += (uint64_t)buffer_ocupados(a) * (ahora - a->t_ultimo_cambio_ns);
+        a->t_ultimo_cambio_ns  = ahora;
+    }
+}
+
+// ===== CLASES DE PRIORIDAD =====
+// Todas se llaman con 'mutex' tomado; sin --prioridades solo existe la
+// clase 0 y equivalen al buffer circular único.
+
+static inline Producto *anillo_espacio(AreaEmpaque *a, int clase, int i)
+{
+    return &a->espacios[(size_t)clase * (size_t)a->capacidad + (size_t)i];
+}
+
+static inline int anillo_ocupados(const AreaEmpaque *a, int clase)
+{
+    return (int)(a->anillos[clase].producidos - a->anillos[clase].retirados);
+}
+
+/**
+ * Coloca 'p' al final del anillo de su clase
+ *
+ * Retorna:
+ *   El espacio usado dentro del anillo
+ */
+static int area_depositar(AreaEmpaque *a, const Producto *p)
+{
+    AnilloPrioridad *r       = &a->anillos[p->prioridad];
+    int              espacio = r->indice_in;
+    *anillo_espacio(a, p->prioridad, espacio) = *p;
+    r->indice_in = (r->indice_in + 1) % a->capacidad;  // Avanza índice circularmente
+    r->producidos++;
+    a->total_producidos++;
+    return espacio;
+}
+
+/**
+ * Elige la clase de la que el empacador toma el siguiente producto
+ *
+ * Normalmente es la clase más urgente con productos. Para que las clases
+ * menores no esperen indefinidamente, si el primer producto de alguna
+ * clase lleva más de envejecimiento_ns en el área, se toma el más viejo
+ * de esos primeros productos (y se cuenta como promovido si no era de
+ * la clase más urgente con productos).
+ *
+ * Retorna:
+ *   La clase elegida; el área debe tener al menos un producto
+ */
+static int area_elegir_clase(AreaEmpaque *a, uint64_t ahora)
+{
+    int c, mejor = 0, elegida;
+    while (mejor < a->prioridades - 1 && anillo_ocupados(a, mejor) == 0) mejor++;
+    if (a->envejecimiento_ns == 0) return mejor;
+
+    uint64_t mas_viejo = UINT64_MAX;
+    elegida = mejor;
+    for (c = mejor; c < a->prioridades; c++) {
+        if (anillo_ocupados(a, c) == 0) continue;
+        uint64_t t = anillo_espacio(a, c, a->anillos[c].indice_out)->t_escaneo_ns;
+        if (t + a->envejecimiento_ns <= ahora && t < mas_viejo) { mas_viejo = t; elegida = c; }
+    }
+    if (elegida != mejor) a->total_promovidos++;
+    return elegida;
+}
+
+/**
+ * Extrae el primer producto del anillo 'clase' en 'p'
+ *
+ * Retorna:
+ *   El espacio liberado dentro del anillo
+ */
+static int area_retirar(AreaEmpaque *a, int clase, Producto *p)
+{
+    AnilloPrioridad *r       = &a->anillos[clase];
+    int              espacio = r->indice_out;
+    *p = *anillo_espacio(a, clase, espacio);
+    r->indice_out = (r->indice_out + 1) % a->capacidad;  // Avanza índice circularmente
+    r->retirados++;
+    a->total_consumidos++;
+    return espacio;
+}
+
+/**
+ * Descarta el producto más viejo de la clase menos urgente con productos
+ * (LLENO_DESCARTAR_VIEJO); el área debe tener al menos un producto
+ */
+static void area_sobrescribir(AreaEmpaque *a)
+{
+    int clase = a->prioridades - 1;
+    while (clase > 0 && anillo_ocupados(a, clase) == 0) clase--;
+    AnilloPrioridad *r = &a->anillos[clase];
+    r->indice_out = (r->indice_out + 1) % a->capacidad;
+    r->retirados++;
+    a->total_sobrescritos++;
+}
+
+/* -------------------- NÚMEROS ALEATORIOS -------------------- */
+/**
+ * Generador por hilo (splitmix64)
+ *
+ * rand() comparte un único estado protegido por un lock entre todos los
+ * hilos; con servicios cortos ese lock aparece como contención propia.
+ * Cada hilo siembra su estado al arrancar con rng_sembrar; al reiniciar
+ * desde un snapshot retoma el estado que tenía.
+ */
+static __thread uint64_t  rng_estado;
+static __thread uint64_t *rng_publicado;  // Copia visible para los snapshots (NULL = ninguna)
+
+/**
+ * Siembra el generador del hilo
+ *
+ * Parámetros:
+ *   semilla:   Estado inicial
+ *   publicado: Donde se publica el estado tras cada número (puede ser NULL)
+ */
+static inline void rng_sembrar(uint64_t semilla, uint64_t *publicado)
+{
+    rng_estado    = semilla;
+    rng_publicado = publicado;
+    if (publicado) __atomic_store_n(publicado, semilla, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t rng_siguiente(void)
+{
+    uint64_t z = (rng_estado += 0x9e3779b97f4a7c15ull);
+    if (rng_publicado) __atomic_store_n(rng_publicado, rng_estado, __ATOMIC_RELAXED);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Entero uniforme en [0, n)
+ */
+static inline int rng_entero(int n)
+{
+    return (int)((rng_siguiente() >> 33) % (uint64_t)n);
+}
+
+/**
+ * Sortea la clase de prioridad de un producto nuevo según cfg.pesos_prioridad
+ */
+static int sortear_prioridad(void)
+{
+    int c, total = 0;
+    for (c = 0; c < cfg.prioridades; c++) total += cfg.pesos_prioridad[c];
+    int r = rng_entero(total);
+    for (c = 0; c < cfg.prioridades - 1; c++) {
+        if (r < cfg.pesos_prioridad[c]) break;
+        r -= cfg.pesos_prioridad[c];
+    }
+    return c;
+}
+
+/**
+ * Real uniforme en (0, 1] (nunca 0, para poder tomar su logaritmo)
+ */
+static inline double rng_uniforme(void)
+{
+    return (double)((rng_siguiente() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Muestra exponencial con la media indicada (en nanosegundos)
+ */
+static inline uint64_t rng_exponencial_ns(double media_ns)
+{
+    return (uint64_t)(-log(rng_uniforme()) * media_ns);
+}
+
+/* -------------------- DISTRIBUCIONES DE SERVICIO -------------------- */
+// Puntos de la tabla de cuantiles de la normal estándar usada por lognormal
+#define TABLA_NORMAL 4096
+
+static double cuantiles_normal[TABLA_NORMAL + 1];
+static int    cuantiles_normal_listos = 0;
+
+/**
+ * Cuantil de la normal estándar (aproximación racional de Acklam, error < 1.2e-9)
+ *
+ * Solo se usa para construir la tabla y para las colas extremas que la
+ * tabla no cubre.
+ */
+static double cuantil_normal(double p)
+{
+    static const double a[] = { -3.969683028665376e+01,  2.209460984245205e+02, -2.759285104469687e+02,
+                                 1.383577518672690e+02, -3.066479806614716e+01,  2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01,  1.615858368580409e+02, -1.556989798598866e+02,
+                                 6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00,  4.374664141464968e+00,  2.938163982698783e+00 };
+    static const double d[] = {  7.784695709041462e-03,  3.224671290700398e-01,  2.445134137142996e+00,
+                                 3.754408661907416e+00 };
+    double q, r;
+
+    if (p < 0.02425) {
+        q = sqrt(-2.0 * log(p));
+        return (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+               ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.0);
+    }
+    if (p > 1.0 - 0.02425) return -cuantil_normal(1.0 - p);
+    q = p - 0.5;
+    r = q * q;
+    return (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q /
+           (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1.0);
+}
+
+/**
+ * Muestra de la normal estándar por interpolación lineal en la tabla
+ *
+ * La tabla cubre los cuantiles i/TABLA_NORMAL; en el primer y el último
+ * tramo (las colas, donde la interpolación se aleja de la curva) se
+ * calcula el cuantil exacto, para no recortar la cola pesada.
+ */
+static inline double muestra_normal(void)
+{
+    double u = rng_uniforme();
+    double x = u * TABLA_NORMAL;
+    int    i = (int)x;
+
+    if (i < 1 || i >= TABLA_NORMAL - 1) return cuantil_normal(u < 1.0 ? u : 1.0 - 0x1p-53);
+    return cuantiles_normal[i] + (x - i) * (cuantiles_normal[i + 1] - cuantiles_normal[i]);
+}
+
+static void preparar_cuantiles_normal(void)
+{
+    if (cuantiles_normal_listos) return;
+    for (int i = 1; i < TABLA_NORMAL; i++) cuantiles_normal[i] = cuantil_normal((double)i / TABLA_NORMAL);
+    cuantiles_normal_listos = 1;
+}
+
+static int comparar_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Carga una distribución empírica: un tiempo en ms por línea
+ *
+ * Las líneas que no empiezan con un número (encabezados, comentarios) se
+ * ignoran. Los valores se ordenan para muestrear por cuantiles.
+ *
+ * Retorna:
+ *   0 si leyó al menos un valor, -1 en caso contrario (errno indica la causa)
+ */
+static int cargar_empirica(const char *ruta, Distribucion *d)
+{
+    FILE *f = fopen(ruta, "r");
+    if (!f) return -1;
+
+    size_t cap = 1024, n = 0;
+    double *v = malloc(cap * sizeof(double));
+    char linea[128];
+    while (v && fgets(linea, sizeof(linea), f)) {
+        char *fin;
+        double x = strtod(linea, &fin);
+        if (fin == linea || x < 0.0) continue;
+        if (n == cap) {
+            double *mas = realloc(v, 2 * cap * sizeof(double));
+            if (!mas) { free(v); v = NULL; break; }
+            v = mas;
+            cap *= 2;
+        }
+        v[n++] = x;
+    }
+    fclose(f);
+    if (!v || n == 0) {
+        free(v);
+        errno = v ? EINVAL : ENOMEM;
+        return -1;
+    }
+
+    qsort(v, n, sizeof(double), comparar_double);
+    d->tabla = v;
+    d->n     = (int)n;
+    return 0;
+}
+
+/**
+ * Interpreta una distribución de tiempos de servicio
+ *
+ * Formatos (todos los tiempos en ms):
+ *   MIN-MAX o N               uniforme en [MIN, MAX) (forma original)
+ *   constante:MS
+ *   uniforme:MIN-MAX
+ *   exponencial:MEDIA
+ *   lognormal:MEDIANA,SIGMA   exp(ln(MEDIANA) + SIGMA * Z)
+ *   pareto:MINIMO,ALFA        cola pesada; ALFA <= 2 tiene varianza infinita
+ *   empirica:ARCHIVO          muestras reales, un valor por línea
+ *
+ * Retorna:
+ *   0 si el texto es válido, -1 en caso contrario
+ */
+static int parsear_distribucion(const char *texto, Distribucion *d)
+{
+    Distribucion nueva;
+    char sep;
+    memset(&nueva, 0, sizeof(nueva));
+
+    if (strncmp(texto, "constante:", 10) == 0) {
+        nueva.tipo = DIST_CONSTANTE;
+        if (sscanf(texto + 10, "%lf%c", &nueva.a, &sep) != 1 || nueva.a < 0.0) return -1;
+    } else if (strncmp(texto, "uniforme:", 9) == 0) {
+        nueva.tipo = DIST_UNIFORME;
+        if (sscanf(texto + 9, "%lf-%lf%c", &nueva.a, &nueva.b, &sep) != 2 ||
+            nueva.a < 0.0 || nueva.b < nueva.a) return -1;
+    } else if (strncmp(texto, "exponencial:", 12) == 0) {
+        nueva.tipo = DIST_EXPONENCIAL;
+        if (sscanf(texto + 12, "%lf%c", &nueva.a, &sep) != 1 || nueva.a < 0.0) return -1;
+    } else if (strncmp(texto, "lognormal:", 10) == 0) {
+        nueva.tipo = DIST_LOGNORMAL;
+        if (sscanf(texto + 10, "%lf,%lf%c", &nueva.a, &nueva.b, &sep) != 2 ||
+            nueva.a <= 0.0 || nueva.b < 0.0) return -1;
+        preparar_cuantiles_normal();
+    } else if (strncmp(texto, "pareto:", 7) == 0) {
+        nueva.tipo = DIST_PARETO;
+        if (sscanf(texto + 7, "%lf,%lf%c", &nueva.a, &nueva.b, &sep) != 2 ||
+            nueva.a <= 0.0 || nueva.b <= 0.0) return -1;
+    } else if (strncmp(texto, "empirica:", 9) == 0) {
+        nueva.tipo = DIST_EMPIRICA;
+        if (cargar_empirica(texto + 9, &nueva) != 0) { perror(texto + 9); return -1; }
+    } else {
+        int min, max;
+        nueva.tipo = DIST_UNIFORME;
+        if (sscanf(texto, "%d-%d%c", &min, &max, &sep) == 2) ;
+        else if (sscanf(texto, "%d%c", &min, &sep) == 1) max = min;
+        else return -1;
+        if (min < 0 || max < min) return -1;
+        nueva.a = min;
+        nueva.b = max;
+    }
+
+    free(d->tabla);
+    *d = nueva;
+    return 0;
+}
+
+/**
+ * Describe una distribución para el encabezado de la corrida
+ */
+static void describir_distribucion(const Distribucion *d, char *texto, size_t largo)
+{
+    switch (d->tipo) {
+    case DIST_CONSTANTE:   snprintf(texto, largo, "constante %.1f ms", d->a); break;
+    case DIST_UNIFORME:    snprintf(texto, largo, "uniforme %.0f-%.0f ms", d->a, d->b); break;
+    case DIST_EXPONENCIAL: snprintf(texto, largo, "exponencial, media %.1f ms", d->a); break;
+    case DIST_LOGNORMAL:   snprintf(texto, largo, "lognormal, mediana %.1f ms, sigma %.2f", d->a, d->b); break;
+    case DIST_PARETO:      snprintf(texto, largo, "pareto, mínimo %.1f ms, alfa %.2f", d->a, d->b); break;
+    case DIST_EMPIRICA:    snprintf(texto, largo, "empírica, %d muestras (%.1f-%.1f ms)",
+                                    d->n, d->tabla[0], d->tabla[d->n - 1]); break;
+    }
+}
+
+/**
+ * Toma una muestra de la distribución en milisegundos
+ *
+ * Usa el generador del hilo; los únicos cálculos por muestra son un
+ * logaritmo (exponencial), una interpolación en tabla (lognormal y
+ * empírica) o una potencia (Pareto).
+ */
+static double muestrear_ms(const Distribucion *d)
+{
+    switch (d->tipo) {
+    case DIST_CONSTANTE:   return d->a;
+    case DIST_UNIFORME:    return d->a + (d->b - d->a) * (1.0 - rng_uniforme());
+    case DIST_EXPONENCIAL: return -log(rng_uniforme()) * d->a;
+    case DIST_LOGNORMAL:   return d->a * exp(d->b * muestra_normal());
+    case DIST_PARETO:      return d->a * pow(rng_uniforme(), -1.0 / d->b);
+    case DIST_EMPIRICA: {
+        // Cuantil interpolado entre las muestras ordenadas
+        double x = (1.0 - rng_uniforme()) * (d->n - 1);
+        int    i = (int)x;
+        if (i >= d->n - 1) return d->tabla[d->n - 1];
+        return d->tabla[i] + (x - i) * (d->tabla[i + 1] - d->tabla[i]);
+    }
+    }
+    return 0.0;
+}
+
+/**
+ * Simula un tiempo de trabajo con la distribución indicada
+ *
+ * Con un tiempo 0 no duerme, lo que permite medir solo el costo de la
+ * sincronización. Las esperas largas (colas pesadas) se duermen en
+ * tramos de a lo sumo 100 ms para notar el fin de la simulación.
+ */
+static void simular_trabajo(const Distribucion *d)
+{
+    double ms = muestrear_ms(d);
+    if (ms <= 0.0) return;
+
+    uint64_t fin = ahora_ns() + (uint64_t)(ms * 1e6);
+    for (;;) {
+        uint64_t ahora = ahora_ns();
+        if (ahora >= fin || !area->activa) return;
+        dormir_hasta(fin - ahora > 100000000ull ? ahora + 100000000ull : fin);
+    }
+}
+
+/* -------------------- REPLAY DE TRAZAS -------------------- */
+#define REPLAY_COLA 256  // Filas leídas por adelantado para cada cajero
+
+/**
+ * Una fila de la traza
+ */
+typedef struct {
+    double t_ms;
+    long   caja;
+    long   codigo;
+} FilaReplay;
+
+/**
+ * Filas ya leídas de la traza que esperan a su cajero (cola circular)
+ */
+typedef struct {
+    FilaReplay filas[REPLAY_COLA];
+    int        ini;
+    int        n;
+} ColaReplay;
+
+/**
+ * Traza de llegadas mapeada en memoria (--replay)
+ *
+ * Cada línea es "timestamp_ms,caja,codigo" (por ejemplo, una exportación
+ * del punto de venta, donde 'caja' es el número de caja registradora).
+ * Las líneas que no tienen ese formato, como un encabezado o comentarios,
+ * se ignoran. El archivo se mapea una sola vez y no se copia ni se carga
+ * entero, así que las trazas de varios GB se leen bajo demanda.
+ *
+ * Un solo cursor recorre la traza en orden a medida que los cajeros piden
+ * filas y reparte cada una en la cola de su cajero, así cada fila se lee
+ * una vez y la memoria no depende del largo de la traza.
+ *
+ * datos / largo: Mapeo del archivo completo
+ * t_base_ms:     Timestamp de la primera fila válida (instante 0 del replay)
+ * mtx:           Protege el cursor y las colas
+ * cursor:        Siguiente fila sin repartir
+ * colas:         Una por cajero de la corrida
+ * activos:       Cajeros que aún no terminan su parte de la traza
+ * agotado:       1 cuando todos terminaron (protegido por 'mutex')
+ */
+typedef struct {
+    const char     *datos;
+    size_t          largo;
+    double          t_base_ms;
+    pthread_mutex_t mtx;
+    const char     *cursor;
+    ColaReplay     *colas;
+    int             activos;
+    int             agotado;
+} ArchivoReplay;
+
+ArchivoReplay replay = { NULL, 0, 0.0, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, 0 };
+
+/**
+ * Lee un número decimal sin signo (con fracción opcional) sin salir de [*p, fin)
+ *
+ * Retorna:
+ *   0 si leyó al menos un dígito, -1 en caso contrario
+ */
+static int replay_numero(const char **p, const char *fin, double *valor)
+{
+    const char *s = *p;
+    double v = 0.0, escala = 1.0;
+    int digitos = 0, fraccion = 0;
+
+    while (s < fin && *s == ' ') s++;
+    for (; s < fin; s++) {
+        if (*s >= '0' && *s <= '9') {
+            if (fraccion) { escala /= 10.0; v += (*s - '0') * escala; }
+            else          v = v * 10.0 + (*s - '0');
+            digitos++;
+        } else if (*s == '.' && !fraccion) {
+            fraccion = 1;
+        } else {
+            break;
+        }
+    }
+    while (s < fin && *s == ' ') s++;
+    *p = s;
+    *valor = v;
+    return digitos > 0 ? 0 : -1;
+}
+
+/**
+ * Avanza el cursor hasta la siguiente fila válida de la traza
+ *
+ * Parámetros:
+ *   cursor: Posición actual dentro de replay.datos (se actualiza)
+ *   fila:   Fila leída
+ *
+ * Retorna:
+ *   1 si leyó una fila, 0 al llegar al final del archivo
+ */
+static int replay_siguiente(const char **cursor, FilaReplay *fila)
+{
+    const char *fin = replay.datos + replay.largo;
+    const char *p   = *cursor;
+
+    while (p < fin) {
+        const char *eol = memchr(p, '\n', (size_t)(fin - p));
+        if (!eol) eol = fin;
+
+        double t, caja, codigo;
+        const char *s = p;
+        int ok = replay_numero(&s, eol, &t) == 0 && s < eol && *s++ == ','
+              && replay_numero(&s, eol, &caja) == 0 && s < eol && *s++ == ','
+              && replay_numero(&s, eol, &codigo) == 0
+              && (s == eol || *s == '\r');
+
+        p = eol < fin ? eol + 1 : fin;
+        if (ok) {
+            fila->t_ms   = t;
+            fila->caja   = (long)caja;
+            fila->codigo = (long)codigo;
+            *cursor = p;
+            return 1;
+        }
+    }
+    *cursor = fin;
+    return 0;
+}
+
+/**
+ * Cajero (desde 0) que atiende una fila
+ *
+ * Las cajas se reparten entre los cajeros por módulo: la caja c la
+ * atiende el cajero ((c - 1) mod num_cajeros) + 1.
+ */
+static int replay_cajero(const FilaReplay *fila)
+{
+    long c = (fila->caja - 1) % cfg.num_cajeros;
+    return (int)(c < 0 ? c + cfg.num_cajeros : c);
+}
+
+static void replay_liberar_colas(void)
+{
+    free(replay.colas);
+    replay.colas = NULL;
+}
+
+/**
+ * Reserva las colas de los cfg.num_cajeros de la corrida y vuelve el
+ * cursor al inicio de la traza
+ *
+ * Retorna:
+ *   0 si se pudieron reservar (o no hay --replay), -1 si no hay memoria
+ */
+static int replay_preparar(void)
+{
+    replay_liberar_colas();
+    if (!replay.datos || cfg.num_cajeros <= 0) return 0;
+    replay.colas  = calloc((size_t)cfg.num_cajeros, sizeof(ColaReplay));
+    replay.cursor = replay.datos;
+    return replay.colas ? 0 : -1;
+}
+
+/**
+ * Siguiente fila de la traza que le corresponde a un cajero
+ *
+ * Si su cola está vacía, avanza el cursor compartido repartiendo las
+ * filas hasta dar con una propia. El cursor se detiene ante la cola llena
+ * de un cajero atrasado; entonces se espera a que la vacíe, con esperas
+ * que crecen de 0.1 a 100 ms (un cajero sin filas espera así el final).
+ *
+ * Parámetros:
+ *   id:   Cajero (desde 1)
+ *   fila: Fila leída
+ *
+ * Retorna:
+ *   1 si leyó una fila, 0 si el cajero ya no tiene más o terminó la corrida
+ */
+static int replay_siguiente_cajero(int id, FilaReplay *fila)
+{
+    ColaReplay *propia = &replay.colas[id - 1];
+    const char *fin    = replay.datos + replay.largo;
+    uint64_t    espera = 100000ull;
+    FilaReplay  f;
+
+    for (;;) {
+        pthread_mutex_lock(&replay.mtx);
+        while (propia->n == 0 && replay.cursor < fin) {
+            const char *p = replay.cursor;
+            if (!replay_siguiente(&p, &f)) { replay.cursor = p; break; }
+            ColaReplay *c = &replay.colas[replay_cajero(&f)];
+            if (c->n == REPLAY_COLA) break;  // Cajero atrasado
+            c->filas[(c->ini + c->n++) % REPLAY_COLA] = f;
+            replay.cursor = p;
+        }
+        if (propia->n > 0) {
+            *fila       = propia->filas[propia->ini];
+            propia->ini = (propia->ini + 1) % REPLAY_COLA;
+            propia->n--;
+            pthread_mutex_unlock(&replay.mtx);
+            return 1;
+        }
+        int agotada = replay.cursor >= fin;
+        pthread_mutex_unlock(&replay.mtx);
+
+        if (agotada || !area->activa) return 0;
+        dormir_hasta(ahora_ns() + espera);
+        if (espera < 100000000ull) espera *= 2;
+    }
+}
+
+/**
+ * Mapea la traza de llegadas y toma el timestamp de su primera fila
+ *
+ * Retorna:
+ *   0 si el archivo se pudo mapear y tiene al menos una fila, -1 en caso contrario
+ */
+int replay_abrir(const char *ruta)
+{
+    int fd = open(ruta, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size == 0) {
+        if (info.st_size == 0) errno = EINVAL;
+        close(fd);
+        return -1;
+    }
+
+    void *datos = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // El mapeo se mantiene sin el descriptor
+    if (datos == MAP_FAILED) return -1;
+    madvise(datos, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    replay.datos = datos;
+    replay.largo = (size_t)info.st_size;
+
+    const char *cursor = replay.datos;
+    FilaReplay  primera;
+    if (!replay_siguiente(&cursor, &primera)) {
+        munmap((void *)replay.datos, replay.largo);
+        replay.datos = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+    replay.t_base_ms = primera.t_ms;
+    return 0;
+}
+
+void replay_cerrar(void)
+{
+    replay_liberar_colas();
+    if (replay.datos) munmap((void *)replay.datos, replay.largo);
+    replay.datos = NULL;
+}
+
+/**
+ * Espera hasta el instante de llegada de una fila según cfg.replay_velocidad
+ *
+ * Duerme hasta un instante absoluto del reloj monotónico (no acumula
+ * deriva entre filas) en tramos de a lo sumo 100 ms, para notar
+ * el fin de la simulación aunque la siguiente llegada esté lejos.
+ */
+static void replay_esperar(const FilaReplay *fila)
+{
+    if (cfg.replay_velocidad <= 0.0) return;
+
+    double   ms      = (fila->t_ms - replay.t_base_ms) / cfg.replay_velocidad;
+    uint64_t llegada = t_inicio_ns + (ms > 0.0 ? (uint64_t)(ms * 1e6) : 0);
+
+    while (area->activa) {
+        uint64_t ahora = ahora_ns();
+        if (ahora >= llegada) break;
+        dormir_hasta(llegada - ahora > 100000000ull ? ahora + 100000000ull : llegada);
+    }
+}
+
+/**
+ * Marca que un cajero terminó su parte de la traza
+ *
+ * El último en terminar detiene la simulación si el área ya está vacía;
+ * si no, deja replay.agotado para que lo haga el empacador que la vacíe.
+ */
+static void replay_terminar_cajero(void)
+{
+    if (mutex_bloquear(&area->mutex)) area_reparar();
+    int ultimo = --replay.activos == 0;
+    if (ultimo) replay.agotado = 1;
+    int vacio = buffer_ocupados(area) == 0;
+    pthread_mutex_unlock(&area->mutex);
+    if (ultimo && vacio) detener_simulacion();
+}
+
+/* -------------------- LLEGADAS EN LAZO ABIERTO -------------------- */
+/**
+ * Generador de llegadas y cola de un cajero (--llegadas poisson|mmpp)
+ *
+ * Las llegadas se generan según su propio reloj, sin importar si el cajero
+ * está escaneando o bloqueado en sem_empty: la carga ofrecida no baja
+ * cuando el área se llena. Las que llegan con el cajero ocupado esperan
+ * en una cola de hasta cfg.cola_max productos y las demás se descartan.
+ *
+ * t_siguiente: Instante de la próxima llegada
+ * rafaga:      1 si el MMPP está en el estado de ráfaga
+ * t_cambio:    Instante del próximo cambio de estado del MMPP
+ * cola:        Instantes de llegada de los productos en espera (circular)
+ * ini / n:     Primer elemento y cantidad de elementos de 'cola'
+ */
+typedef struct {
+    uint64_t  t_siguiente;
+    int       rafaga;
+    uint64_t  t_cambio;
+    uint64_t *cola;
+    int       ini;
+    int       n;
+} GeneradorLlegadas;
+
+/**
+ * Media entre llegadas de un cajero en el estado actual (nanosegundos)
+ */
+static double llegadas_media_ns(const GeneradorLlegadas *g)
+{
+    double tasa = cfg.tasa_llegadas / cfg.num_cajeros;
+    if (g->rafaga) tasa *= cfg.mmpp_factor;
+    return 1e9 / tasa;
+}
+
+/**
+ * Calcula la llegada posterior a 'desde'
+ *
+ * En MMPP, si el intervalo cruza un cambio de estado se vuelve a sortear
+ * desde el instante del cambio con la nueva tasa; como la exponencial no
+ * tiene memoria, el resultado sigue siendo exacto.
+ */
+static void llegadas_programar(GeneradorLlegadas *g, uint64_t desde)
+{
+    for (;;) {
+        uint64_t t = desde + rng_exponencial_ns(llegadas_media_ns(g));
+        if (cfg.llegadas != LLEGADAS_MMPP || t < g->t_cambio) {
+            g->t_siguiente = t;
+            return;
+        }
+        desde     = g->t_cambio;
+        g->rafaga = !g->rafaga;
+        g->t_cambio = desde + rng_exponencial_ns((g->rafaga ? cfg.mmpp_rafaga_ms : cfg.mmpp_normal_ms) * 1e6);
+    }
+}
+
+static void llegadas_iniciar(GeneradorLlegadas *g, uint64_t *cola, uint64_t inicio)
+{
+    memset(g, 0, sizeof(*g));
+    g->cola     = cola;
+    g->t_cambio = inicio + rng_exponencial_ns(cfg.mmpp_normal_ms * 1e6);
+    llegadas_programar(g, inicio);
+}
+
+/**
+ * Entrega el siguiente producto a escanear
+ *
+ * Primero encola todas las llegadas ocurridas hasta ahora (descartando
+ * las que no caben) y, si la cola está vacía, duerme hasta la próxima.
+ * Una llegada cuenta como retrasada si ocurrió antes de que el cajero
+ * quedara libre, es decir, mientras escaneaba o esperaba lugar en el área.
+ *
+ * Parámetros:
+ *   g:  Generador del cajero
+ *   a:  Carril del cajero (su bandera 'activa')
+ *   st: Estadísticas del cajero (llegadas, retrasados, descartados)
+ *
+ * Retorna:
+ *   Instante de llegada del producto, o 0 si la simulación terminó
+ */
+static uint64_t llegadas_siguiente(GeneradorLlegadas *g, const AreaEmpaque *a, EstadisticasHilo *st)
+{
+    uint64_t t_libre = ahora_ns();
+
+    for (;;) {
+        uint64_t ahora = ahora_ns();
+        while (g->t_siguiente <= ahora) {
+            contador_sumar(&st->llegadas, 1);
+            if (g->n < cfg.cola_max) {
+                g->cola[(g->ini + g->n++) % cfg.cola_max] = g->t_siguiente;
+            } else {
+                contador_sumar(&st->descartados, 1);
+            }
+            llegadas_programar(g, g->t_siguiente);
+        }
+
+        if (g->n > 0) {
+            uint64_t llegada = g->cola[g->ini];
+            g->ini = (g->ini + 1) % cfg.cola_max;
+            g->n--;
+            if (llegada < t_libre) contador_sumar(&st->retrasados, 1);
+            return llegada;
+        }
+        if (!a->activa) return 0;
+
+        // Duerme hasta la próxima llegada, en tramos de a lo sumo 100 ms
+        dormir_hasta(g->t_siguiente - ahora > 100000000ull ? ahora + 100000000ull : g->t_siguiente);
+        if (!a->activa) return 0;
+    }
+}
+
+/* -------------------- ARENA DE HILOS -------------------- */
+/**
+ * Redondea 'n' bytes a un múltiplo de la línea de caché
+ */
+static inline size_t arena_redondear(size_t n)
+{
+    return (n + TAM_LINEA_CACHE - 1) & ~(size_t)(TAM_LINEA_CACHE - 1);
+}
+
+/**
+ * Reserva la arena con el estado de todos los hilos de la corrida
+ *
+ * Una sola reserva alineada a la línea de caché contiene, en este orden:
+ * los contextos (cajeros y luego empacadores), los buffers de traza y sus
+ * eventos, los buffers de log de texto o binario, las colas de llegadas,
+ * los histogramas por clase de prioridad de los empacadores y los
+ * descriptores de las corrutinas (sus pilas van aparte, ver
+ * planificador_preparar).
+ * Las secciones opcionales solo ocupan espacio si la configuración las usa.
+ * Toda la arena se pone en cero con memset para que sus páginas ya estén
+ * asignadas antes de crear los hilos.
+ *
+ * Retorna:
+ *   0 si se pudo reservar, -1 si no hay memoria
+ */
+static int contextos_reservar(void)
+{
+    int    n          = cfg.num_cajeros + cfg.num_empacadores;
+    int    traza      = cfg.ruta_traza != NULL;
+    int    texto      = cfg.log_nivel >= LOG_RESUMEN && !cfg.ruta_log_binario;
+    int    binario    = cfg.ruta_log_binario != NULL;
+    int    llegadas   = cfg.llegadas != LLEGADAS_CERRADO;
+    int    corrutinas = cfg.modo != MODO_HILOS;
+    size_t eventos    = traza ? (size_t)cfg.eventos_traza * sizeof(RegistroTraza) : 0;
+    size_t cola       = llegadas ? (size_t)cfg.cola_max * sizeof(uint64_t) : 0;
+    size_t clases     = cfg.prioridades > 1 ? (size_t)cfg.prioridades * sizeof(Histograma) : 0;
+    size_t tam        = arena_redondear((size_t)n * sizeof(ContextoHilo));
+    size_t off_traza = tam, off_eventos, off_texto, off_binario, off_colas, off_clases, off_co;
+    int i;
+
+    if (traza) tam += arena_redondear((size_t)n * sizeof(BufferTraza));
+    off_eventos = tam;
+    tam += (size_t)n * arena_redondear(eventos);
+    off_texto = tam;
+    if (texto) tam += arena_redondear((size_t)n * sizeof(BufferLogTexto));
+    off_binario = tam;
+    if (binario) tam += arena_redondear((size_t)n * sizeof(BufferLogBinario));
+    off_colas = tam;
+    tam += (size_t)cfg.num_cajeros * arena_redondear(cola);
+    off_clases = tam;
+    tam += (size_t)cfg.num_empacadores * arena_redondear(clases);
+    off_co = tam;
+    if (corrutinas) tam += arena_redondear((size_t)n * sizeof(Corrutina));
+
+    if (posix_memalign(&arena_hilos, TAM_LINEA_CACHE, tam) != 0) {
+        arena_hilos = NULL;
+        return -1;
+    }
+    memset(arena_hilos, 0, tam);
+
+    char *base = arena_hilos;
+    ctx_cajeros     = (ContextoHilo *)base;
+    ctx_empacadores = ctx_cajeros + cfg.num_cajeros;
+    for (i = 0; i < n; i++) {
+        ContextoHilo *c = &ctx_cajeros[i];
+        c->rol = i < cfg.num_cajeros ? ROL_CAJERO : ROL_EMPACADOR;
+        c->id  = c->rol == ROL_CAJERO ? i + 1 : i - cfg.num_cajeros + 1;
+        if (traza) {
+            c->traza            = (BufferTraza *)(base + off_traza) + i;
+            c->traza->eventos   = (RegistroTraza *)(base + off_eventos + (size_t)i * arena_redondear(eventos));
+            c->traza->capacidad = (uint32_t)cfg.eventos_traza;
+        }
+        if (texto) {
+            c->logtxt = (BufferLogTexto *)(base + off_texto) + i;
+            pthread_mutex_init(&c->logtxt->mutex, NULL);
+        }
+        if (binario) c->logbin = (BufferLogBinario *)(base + off_binario) + i;
+        if (llegadas && c->rol == ROL_CAJERO)
+            c->cola_llegadas = (uint64_t *)(base + off_colas + (size_t)i * arena_redondear(cola));
+        if (clases && c->rol == ROL_EMPACADOR)
+            c->latencia_clase = (Histograma *)(base + off_clases + (size_t)(c->id - 1) * arena_redondear(clases));
+        if (corrutinas) c->co = (Corrutina *)(base + off_co) + i;
+    }
+    return 0;
+}
+
+/**
+ * Libera la arena de la última corrida
+ */
+static void contextos_liberar(void)
+{
+    free(arena_hilos);
+    arena_hilos = NULL;
+    ctx_cajeros = ctx_empacadores = NULL;
+}
+
+/* -------------------- PLANIFICADOR DE CORRUTINAS -------------------- */
+/**
+ * Punto de entrada de toda corrutina
+ *
+ * makecontext solo pasa argumentos int, así que el puntero a la corrutina
+ * llega partido en dos mitades de 32 bits.
+ */
+static void corrutina_entrada(unsigned int alto, unsigned int bajo)
+{
+    Corrutina *co = (Corrutina *)(((uintptr_t)alto << 32) | (uintptr_t)bajo);
+    co->funcion(co->arg);
+    corrutina_suspender(CORRUTINA_TERMINADA, NULL);  // No se reanuda
+}
+
+/**
+ * Crea una corrutina por contexto y las deja en la cola de listas
+ *
+ * Parámetros:
+ *   cuerpo_cajero, cuerpo_empacador: Funciones de cada rol
+ *
+ * Las pilas salen de una sola región mmap con MAP_NORESERVE: solo ocupan
+ * memoria las páginas que cada corrutina toca. La página más baja de cada
+ * pila queda sin permisos para que un desbordamiento falle en lugar de
+ * pisar la pila vecina (si el kernel no admite más mapeos se omite).
+ *
+ * Retorna:
+ *   0 si se crearon, -1 si no hay memoria para las pilas
+ */
+static int planificador_preparar(void *(*cuerpo_cajero)(void *), void *(*cuerpo_empacador)(void *))
+{
+    Planificador *p   = &planificador;
+    int           n   = cfg.num_cajeros + cfg.num_empacadores;
+    long          pag = sysconf(_SC_PAGESIZE);
+    int i;
+
+    p->tam_pilas = (size_t)n * PILA_CORRUTINA;
+    p->pilas = mmap(NULL, p->tam_pilas, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (p->pilas == MAP_FAILED) {
+        p->pilas = NULL;
+        return -1;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    p->listas.ini = p->listas.fin = NULL;
+    p->ociosos  = 0;
+    p->vivas    = n;
+    p->cambios  = 0;
+
+    for (i = 0; i < n; i++) {
+        ContextoHilo *c    = &ctx_cajeros[i];  // Los empacadores siguen a los cajeros
+        Corrutina    *co   = c->co;
+        char         *pila = (char *)p->pilas + (size_t)i * PILA_CORRUTINA;
+        uintptr_t     dir  = (uintptr_t)co;
+
+        mprotect(pila, (size_t)pag, PROT_NONE);
+        co->funcion = c->rol == ROL_CAJERO ? cuerpo_cajero : cuerpo_empacador;
+        co->arg     = c;
+        co->tid     = SONDA_TID(c->rol, c->id);
+        co->evento.vencer = corrutina_vencer;
+        getcontext(&co->uc);
+        co->uc.uc_stack.ss_sp   = pila + pag;
+        co->uc.uc_stack.ss_size = PILA_CORRUTINA - (size_t)pag;
+        co->uc.uc_link          = NULL;
+        makecontext(&co->uc, (void (*)(void))corrutina_entrada, 2,
+                    (unsigned int)(dir >> 32), (unsigned int)(dir & 0xffffffffu));
+        co->estado = CORRUTINA_LISTA;
+        cola_corrutinas_agregar(&p->listas, co);
+    }
+    return 0;
+}
+
+/**
+ * Ejecuta una corrutina hasta que se suspende y completa la suspensión
+ *
+ * Ya en la pila del trabajador programa en el reloj a la que duerme,
+ * cuenta la que terminó y suelta el mutex que dejó tomado una que se
+ * bloqueó en un semáforo.
+ *
+ * Parámetros:
+ *   co:     Corrutina sacada de la cola de listas
+ *   propio: Contexto del trabajador (uc_planificador)
+ *
+ * Retorna:
+ *   1 si era la última corrutina viva y terminó, 0 en caso contrario
+ */
+static int corrutina_ejecutar(Corrutina *co, ucontext_t *propio)
+{
+    Planificador *p = &planificador;
+    int ultima = 0;
+
+    co_actual     = co;
+    sonda_tid     = co->tid;
+    rng_estado    = co->rng;
+    rng_publicado = co->rng_pub;
+    swapcontext(propio, &co->uc);
+    co->rng       = rng_estado;
+    co->rng_pub   = rng_publicado;
+    co_actual     = NULL;
+
+    // Después de programarla en el reloj o soltar 'soltar' otro
+    // trabajador puede reanudarla: se leen sus campos antes
+    EstadoCorrutina  estado = co->estado;
+    pthread_mutex_t *soltar = co->soltar;
+    if (estado == CORRUTINA_DORMIDA) {
+        reloj_programar(&co->evento, co->evento.vence);
+    } else if (estado == CORRUTINA_TERMINADA) {
+        pthread_mutex_lock(&p->mtx);
+        if (--p->vivas == 0) {
+            pthread_cond_broadcast(&p->cond);
+            ultima = 1;
+        }
+        pthread_mutex_unlock(&p->mtx);
+    }
+    if (soltar) pthread_mutex_unlock(soltar);
+    return ultima;
+}
+
+/**
+ * Función ejecutada por cada hilo trabajador del modo corrutinas
+ *
+ * Toma corrutinas de la cola de listas y las ejecuta hasta que se
+ * suspenden. Sin corrutinas listas espera en 'cond'. Termina cuando no
+ * quedan corrutinas vivas.
+ */
+void *trabajador_corrutinas(void *arg)
+{
+    Planificador *p = &planificador;
+    ucontext_t    propio;
+    uint64_t      cambios = 0;
+    (void)arg;
+
+    uc_planificador = &propio;
+    for (;;) {
+        Corrutina *co;
+
+        // ===== SIGUIENTE CORRUTINA LISTA =====
+        pthread_mutex_lock(&p->mtx);
+        while (!(co = cola_corrutinas_sacar(&p->listas)) && p->vivas > 0) {
+            p->ociosos++;
+            pthread_cond_wait(&p->cond, &p->mtx);
+            p->ociosos--;
+        }
+        pthread_mutex_unlock(&p->mtx);
+        if (!co) break;
+
+        // ===== EJECUTA HASTA QUE SE SUSPENDA =====
+        corrutina_ejecutar(co, &propio);
+        cambios++;
+    }
+
+    pthread_mutex_lock(&p->mtx);
+    p->cambios += cambios;
+    pthread_mutex_unlock(&p->mtx);
+    return NULL;
+}
+
+/**
+ * Libera las pilas y las variables de condición del planificador
+ */
+static void planificador_liberar(void)
+{
+    if (!planificador.pilas) return;
+    munmap(planificador.pilas, planificador.tam_pilas);
+    planificador.pilas = NULL;
+    pthread_cond_destroy(&planificador.cond);
+}
+
+/* -------------------- BUCLE DE EVENTOS (EPOLL) -------------------- */
+/**
+ * Descriptor que vigila el bucle epoll
+ *
+ * FUENTE_SEMAFORO: eventfd de un semáforo con corrutinas despiertas
+ * FUENTE_RELOJ:    timerfd de la rueda de tiempos
+ * FUENTE_SENAL:    signalfd de SIGINT y SIGTERM
+ * FUENTE_FIN:      eventfd que se escribe al terminar la última corrutina
+ * FUENTE_JOURNAL:  eventfd del journal con corrutinas cuyo registro ya es durable
+ */
+typedef enum {
+    FUENTE_SEMAFORO = 0,
+    FUENTE_RELOJ,
+    FUENTE_SENAL,
+    FUENTE_FIN,
+    FUENTE_JOURNAL
+} TipoFuente;
+
+typedef struct {
+    TipoFuente tipo;
+    int        fd;
+    Semaforo  *sem;         // Solo FUENTE_SEMAFORO
+} FuenteEvento;
+
+/**
+ * Estado del bucle de eventos (--modo epoll)
+ *
+ * Las corrutinas son las mismas del modo corrutinas; lo que cambia es
+ * cómo espera un trabajador sin nada que ejecutar: en lugar de una
+ * variable de condición, un epoll_wait sobre los eventfd que avisan los
+ * cambios lleno/vacío de cada carril, el timerfd del reloj y un
+ * signalfd. Así el área se puede integrar a un servicio que ya tenga su
+ * propio bucle, registrando estos mismos descriptores.
+ *
+ * fd_epoll:        Instancia epoll compartida por los hilos del bucle
+ * fd_senal:        signalfd de SIGINT y SIGTERM (bloqueadas en el proceso)
+ * fd_fin:          eventfd de fin; nunca se lee, así todos los hilos lo ven
+ * fuentes:         Descriptores registrados (data.ptr de cada evento)
+ * senales, mascara_previa: Señales que atiende el bucle y máscara a restaurar
+ * esperas:         Llamadas a epoll_wait que retornaron
+ * avisos:          Avisos de semáforo atendidos
+ */
+typedef struct {
+    int           fd_epoll;
+    int           fd_senal;
+    int           fd_fin;
+    FuenteEvento *fuentes;
+    int           num_fuentes;
+    int           max_fuentes;
+    sigset_t      senales;
+    sigset_t      mascara_previa;
+    uint64_t      esperas;
+    uint64_t      avisos;
+} Bucle;
+
+Bucle bucle = { .fd_epoll = -1, .fd_senal = -1, .fd_fin = -1 };
+
+/**
+ * Registra un descriptor en el bucle
+ *
+ * Retorna:
+ *   0 si se registró, -1 si falló epoll_ctl o no queda espacio
+ */
+static int bucle_agregar(TipoFuente tipo, int fd, Semaforo *sem)
+{
+    if (fd < 0 || bucle.num_fuentes >= bucle.max_fuentes) return -1;
+    FuenteEvento *f = &bucle.fuentes[bucle.num_fuentes];
+    f->tipo = tipo;
+    f->fd   = fd;
+    f->sem  = sem;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.ptr = f;
+    if (epoll_ctl(bucle.fd_epoll, EPOLL_CTL_ADD, fd, &ev) != 0) return -1;
+    bucle.num_fuentes++;
+    return 0;
+}
+
+/**
+ * Crea la instancia epoll y los eventfd de los semáforos de cada carril
+ *
+ * Bloquea SIGINT y SIGTERM en el hilo que llama (y en los que cree
+ * después) para recibirlas por el signalfd; debe llamarse antes de crear
+ * cualquier hilo de la corrida. El timerfd del reloj se registra aparte
+ * con bucle_agregar() al iniciarlo.
+ *
+ * Retorna:
+ *   0 si todo quedó registrado, -1 en caso contrario
+ */
+static int bucle_preparar(void)
+{
+    int k;
+
+    bucle.esperas     = bucle.avisos = 0;
+    bucle.num_fuentes = 0;
+    bucle.max_fuentes = 2 * num_carriles + 4;
+    bucle.fuentes     = calloc((size_t)bucle.max_fuentes, sizeof(FuenteEvento));
+    bucle.fd_epoll    = epoll_create1(EPOLL_CLOEXEC);
+    bucle.fd_fin      = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!bucle.fuentes || bucle.fd_epoll < 0 || bucle_agregar(FUENTE_FIN, bucle.fd_fin, NULL) != 0) return -1;
+
+    for (k = 0; k < num_carriles; k++) {
+        Semaforo *sems[2] = { &carriles[k]->sem_full, &carriles[k]->sem_empty };
+        for (int j = 0; j < 2; j++) {
+            sems[j]->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (bucle_agregar(FUENTE_SEMAFORO, sems[j]->evfd, sems[j]) != 0) return -1;
+        }
+    }
+
+    sigemptyset(&bucle.senales);
+    sigaddset(&bucle.senales, SIGINT);
+    sigaddset(&bucle.senales, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &bucle.senales, &bucle.mascara_previa);
+    bucle.fd_senal = signalfd(-1, &bucle.senales, SFD_NONBLOCK | SFD_CLOEXEC);
+    return bucle_agregar(FUENTE_SENAL, bucle.fd_senal, NULL);
+}
+
+/**
+ * Cierra los descriptores del bucle y restaura la máscara de señales
+ */
+static void bucle_liberar(void)
+{
+    int i;
+    if (bucle.fd_epoll < 0 && !bucle.fuentes) return;
+    for (i = 0; i < bucle.num_fuentes; i++) {
+        if (bucle.fuentes[i].tipo == FUENTE_SEMAFORO) {
+            close(bucle.fuentes[i].fd);
+            bucle.fuentes[i].sem->evfd = -1;
+        }
+    }
+    if (bucle.fd_senal >= 0) {
+        close(bucle.fd_senal);
+        pthread_sigmask(SIG_SETMASK, &bucle.mascara_previa, NULL);
+    }
+    if (bucle.fd_fin >= 0)   close(bucle.fd_fin);
+    if (bucle.fd_epoll >= 0) close(bucle.fd_epoll);
+    free(bucle.fuentes);
+    bucle.fuentes  = NULL;
+    bucle.fd_epoll = bucle.fd_senal = bucle.fd_fin = -1;
+}
+
+/**
+ * Atiende el eventfd de un semáforo: pasa sus corrutinas despiertas a listas
+ *
+ * Retorna:
+ *   1 si había un aviso, 0 si otro hilo del bucle ya lo atendió
+ */
+static int bucle_semaforo(Semaforo *s)
+{
+    eventfd_t  valor;
+    Corrutina *co;
+
+    if (eventfd_read(s->evfd, &valor) != 0) return 0;
+    mutex_bloquear(&s->mtx);
+    ColaCorrutinas despiertas = s->despiertas;
+    s->despiertas.ini = s->despiertas.fin = NULL;
+    pthread_mutex_unlock(&s->mtx);
+    while ((co = cola_corrutinas_sacar(&despiertas))) corrutina_despertar(co);
+    return 1;
+}
+
+static int bucle_journal(void);
+
+/**
+ * Atiende el signalfd: SIGINT o SIGTERM detienen la corrida
+ */
+static void bucle_senal(void)
+{
+    struct signalfd_siginfo info;
+    if (read(bucle.fd_senal, &info, sizeof(info)) != (ssize_t)sizeof(info)) return;
+    fprintf(stderr, "Aviso: señal %s recibida; se detiene la simulación\n",
+            info.ssi_signo == SIGINT ? "SIGINT" : "SIGTERM");
+    detener_simulacion();
+}
+
+/**
+ * Función ejecutada por cada hilo del bucle de eventos (--modo epoll)
+ *
+ * Ejecuta las corrutinas listas y, cuando no queda ninguna, espera en
+ * epoll_wait; cada descriptor listo puede devolver corrutinas a la cola
+ * (avisos de semáforo y plazos vencidos) o detener la corrida (señales).
+ * Termina cuando no quedan corrutinas vivas.
+ */
+void *trabajador_epoll(void *arg)
+{
+    Planificador      *p = &planificador;
+    ucontext_t         propio;
+    struct epoll_event eventos[BUCLE_EVENTOS];
+    uint64_t           cambios = 0, esperas = 0, avisos = 0;
+    int                fin = 0, i, n;
+    (void)arg;
+
+    uc_planificador = &propio;
+    while (!fin) {
+        Corrutina *co;
+
+        // ===== CORRUTINAS LISTAS =====
+        pthread_mutex_lock(&p->mtx);
+        while ((co = cola_corrutinas_sacar(&p->listas))) {
+            pthread_mutex_unlock(&p->mtx);
+            if (corrutina_ejecutar(co, &propio)) eventfd_write(bucle.fd_fin, 1);
+            cambios++;
+            pthread_mutex_lock(&p->mtx);
+        }
+        fin = p->vivas == 0;
+        pthread_mutex_unlock(&p->mtx);
+        if (fin) break;
+
+        // ===== ESPERA EVENTOS =====
+        n = epoll_wait(bucle.fd_epoll, eventos, BUCLE_EVENTOS, -1);
+        esperas++;
+        for (i = 0; i < n; i++) {
+            FuenteEvento *f = eventos[i].data.ptr;
+            switch (f->tipo) {
+            case FUENTE_SEMAFORO: avisos += (uint64_t)bucle_semaforo(f->sem); break;
+            case FUENTE_RELOJ:    reloj_disparo();                           break;
+            case FUENTE_SENAL:    bucle_senal();                             break;
+            case FUENTE_FIN:      fin = 1;                                   break;
+            case FUENTE_JOURNAL:  avisos += (uint64_t)bucle_journal();       break;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&p->mtx);
+    p->cambios    += cambios;
+    bucle.esperas += esperas;
+    bucle.avisos  += avisos;
+    pthread_mutex_unlock(&p->mtx);
+    return NULL;
+}
+
+/* -------------------- JOURNAL (WAL) -------------------- */
+/**
+ * Formato del journal (--journal)
+ *
+ * Un EncabezadoJournal seguido de registros de tamaño fijo. Cada producto
+ * colocado genera un JOURNAL_PRODUCIDO con un número de secuencia propio,
+ * y cada producto tomado un JOURNAL_CONSUMIDO con esa misma secuencia.
+ * Al reiniciar, los productos con PRODUCIDO y sin CONSUMIDO se recuperan.
+ * 'suma' detecta un último registro escrito a medias por una caída.
+ */
+#define JOURNAL_MAGIA    "SMJOURNL"
+#define JOURNAL_VERSION  1
+
+typedef struct {
+    char     magia[8];
+    uint32_t version;
+    uint32_t tam_registro;
+} EncabezadoJournal;
+
+typedef enum {
+    JOURNAL_PRODUCIDO = 1,
+    JOURNAL_CONSUMIDO
+} TipoJournal;
+
+typedef struct {
+    uint64_t seq;
+    int32_t  codigo;
+    uint16_t catalogo;
+    uint8_t  tipo;
+    uint8_t  relleno;
+    uint32_t suma;
+    uint32_t relleno2;
+} RegistroJournal;
+
+/**
+ * Estado del journal con group commit
+ *
+ * Los registros se anexan a 'pendientes' dentro de la sección crítica del
+ * área (así el journal sigue el orden del buffer) y el hilo del journal
+ * los escribe por lotes: espera a juntar cfg.journal_lote registros o a
+ * que el más viejo cumpla cfg.journal_intervalo_ms, cambia de buffer, y
+ * hace un write y un fdatasync por lote sin tomar 'mtx'. Un cajero no
+ * señala sem_full hasta que su registro es durable.
+ *
+ * mtx:               Protege los buffers y contadores (se toma dentro de 'mutex')
+ * cond_trabajo:      Despierta al hilo del journal
+ * cond_durable:      Despierta a los cajeros cuando avanza 'durables'
+ * esperando:         Corrutinas suspendidas hasta que su registro sea durable
+ * despiertas, evfd:  En modo epoll, corrutinas ya durables y el eventfd con
+ *                    que se avisa al bucle (-1 en los otros modos)
+ * pendientes / n:    Registros aún no escritos
+ * previos:           Registros válidos que ya tenía el archivo al abrirlo
+ * anexados:          Registros anexados desde que se abrió
+ * durables:          Registros ya cubiertos por un fdatasync
+ * siguiente_seq:     Secuencia del próximo producto
+ * t_primero:         Instante en que se anexó el registro pendiente más viejo
+ * fin:               1 cuando los trabajadores terminaron
+ * error:             errno del primer write/fdatasync fallido (0 = ninguno)
+ * fsyncs, bytes, ns_fsync, lote_max: Estadísticas de escritura
+ * esperas, ns_espera: Esperas de durabilidad de los cajeros
+ * registros_cola:    Registros leídos al recuperar (posteriores al snapshot)
+ * ns_recuperacion:   Duración de la recuperación al abrir
+ */
+typedef struct {
+    int              fd;
+    pthread_mutex_t  mtx;
+    pthread_cond_t   cond_trabajo;
+    pthread_cond_t   cond_durable;
+    ColaCorrutinas   esperando;
+    ColaCorrutinas   despiertas;
+    int              evfd;
+    RegistroJournal *pendientes;
+    int              n;
+    int              cap;
+    RegistroJournal *escribiendo;
+    int              cap_escribiendo;
+    uint64_t         previos;
+    uint64_t         anexados;
+    uint64_t         durables;
+    uint64_t         siguiente_seq;
+    uint64_t         t_primero;
+    int              fin;
+    int              error;
+    uint64_t         fsyncs;
+    uint64_t         bytes;
+    uint64_t         ns_fsync;
+    uint64_t         lote_max;
+    uint64_t         esperas;
+    uint64_t         ns_espera;
+    uint64_t         registros_cola;
+    uint64_t         ns_recuperacion;
+} Journal;
+
+Journal journal = { .fd = -1, .evfd = -1 };
+
+// Productos recuperados que no cupieron en el área; los cajeros los colocan primero
+Producto *recuperados          = NULL;
+int       num_recuperados      = 0;
+int       recuperados_tomados  = 0;   // Índice del siguiente (atómico)
+int       recuperados_en_area  = 0;   // Cuántos se colocaron directamente al iniciar
+uint8_t  *colocados            = NULL;  // 1 si el recuperado i ya está en el área (bajo 'mutex')
+
+/**
+ * Punto de partida de la recuperación (un snapshot cargado, ver SNAPSHOTS)
+ *
+ * registros:     Registros del journal que el snapshot ya incluye
+ * siguiente_seq: Secuencia del próximo producto al tomar el snapshot
+ * productos / n: Productos sin empacar que contenía el snapshot
+ */
+typedef struct {
+    uint64_t         registros;
+    uint64_t         siguiente_seq;
+    RegistroJournal *productos;
+    int              n;
+} BaseRecuperacion;
+
+/**
+ * Suma de verificación de un registro (FNV-1a sobre los campos previos a 'suma')
+ */
+static uint32_t journal_suma(const RegistroJournal *r)
+{
+    const unsigned char *b = (const unsigned char *)r;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < offsetof(RegistroJournal, suma); i++) h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+/**
+ * Arma la lista de productos no consumidos a partir de 'base' y la cola del journal
+ *
+ * Parámetros:
+ *   fd:   Journal abierto
+ *   base: Estado del último snapshot; sin snapshot (registros = 0) se lee
+ *         el journal completo
+ *
+ * Solo se leen los registros posteriores a base->registros, por lo que el
+ * tiempo de recuperación depende de lo ocurrido desde el último snapshot
+ * y no de toda la historia. Se detiene en el primer registro inválido (la
+ * cola de una escritura interrumpida) y trunca el archivo ahí, para que
+ * los registros nuevos se anexen después del último válido.
+ *
+ * Retorna:
+ *   0 si el archivo está vacío, 1 si es un journal válido, -1 en caso contrario
+ */
+static int journal_recuperar(int fd, const BaseRecuperacion *base)
+{
+    EncabezadoJournal enc;
+    ssize_t leido = pread(fd, &enc, sizeof(enc), 0);
+    int     vacio = leido == 0;
+    if (!vacio && (leido != (ssize_t)sizeof(enc) || memcmp(enc.magia, JOURNAL_MAGIA, sizeof(enc.magia)) != 0 ||
+                       enc.version != JOURNAL_VERSION || enc.tam_registro != sizeof(RegistroJournal))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Secuencias desde 'primera': el snapshot no guarda las ya empacadas
+    uint64_t primera = base->siguiente_seq, siguiente = base->siguiente_seq;
+    int      i;
+    for (i = 0; i < base->n; i++) {
+        if (base->productos[i].seq < primera) primera = base->productos[i].seq;
+    }
+
+    // Estado por secuencia: 0 = sin registro, 1 = producido, 2 = consumido
+    size_t           cap    = 4096;
+    while (cap < siguiente - primera) cap *= 2;
+    uint8_t         *estado = calloc(cap, 1);
+    RegistroJournal *prod   = malloc(cap * sizeof(RegistroJournal));
+    RegistroJournal  bloque[1024];
+    off_t            pos    = (off_t)sizeof(enc) + (off_t)(base->registros * sizeof(RegistroJournal));
+    off_t            largo  = lseek(fd, 0, SEEK_END);
+
+    if (!estado || !prod) { free(estado); free(prod); errno = ENOMEM; return -1; }
+    for (i = 0; i < base->n; i++) {
+        estado[base->productos[i].seq - primera] = 1;
+        prod[base->productos[i].seq - primera]   = base->productos[i];
+    }
+    // Journal más corto que el snapshot (se perdió su cola): no hay registros que repetir
+    if (!vacio && pos > largo) pos = largo - (largo - (off_t)sizeof(enc)) % (off_t)sizeof(RegistroJournal);
+
+    while (!vacio && (leido = pread(fd, bloque, sizeof(bloque), pos)) > 0) {
+        int n = (int)(leido / (ssize_t)sizeof(RegistroJournal));
+        for (i = 0; i < n; i++) {
+            RegistroJournal *r = &bloque[i];
+            if (r->suma != journal_suma(r) || (r->tipo != JOURNAL_PRODUCIDO && r->tipo != JOURNAL_CONSUMIDO)) break;
+            journal.registros_cola++;
+            if (r->seq < primera) continue;  // Empaque repetido de un producto ya descartado
+            while (r->seq - primera >= cap) {
+                uint8_t         *mas_e = realloc(estado, 2 * cap);
+                RegistroJournal *mas_p = realloc(prod, 2 * cap * sizeof(RegistroJournal));
+                if (mas_e) estado = mas_e;
+                if (mas_p) prod   = mas_p;
+                if (!mas_e || !mas_p) { free(estado); free(prod); errno = ENOMEM; return -1; }
+                memset(estado + cap, 0, cap);
+                cap *= 2;
+            }
+            uint64_t k = r->seq - primera;
+            if (r->tipo == JOURNAL_PRODUCIDO) {
+                if (estado[k] == 0) estado[k] = 1;
+                prod[k] = *r;
+            } else {
+                estado[k] = 2;
+            }
+            if (r->seq >= siguiente) siguiente = r->seq + 1;
+        }
+        pos += (off_t)i * (off_t)sizeof(RegistroJournal);
+        if (i < n || leido % (ssize_t)sizeof(RegistroJournal) != 0) break;  // Cola inválida
+    }
+    if (!vacio && ftruncate(fd, pos) != 0) { free(estado); free(prod); return -1; }
+
+    uint64_t s;
+    int      n = 0;
+    for (s = 0; s < siguiente - primera; s++) n += estado[s] == 1;
+    recuperados = n > 0 ? calloc((size_t)n, sizeof(Producto)) : NULL;
+    colocados   = n > 0 ? calloc((size_t)n, 1) : NULL;
+    if (n > 0 && (!recuperados || !colocados)) {
+        free(estado); free(prod); free(recuperados); free(colocados);
+        recuperados = NULL;
+        colocados   = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+    for (s = 0, n = 0; s < siguiente - primera; s++) {
+        if (estado[s] != 1) continue;
+        Producto *p = &recuperados[n++];
+        p->seq      = prod[s].seq;
+        p->codigo   = prod[s].codigo;
+        p->catalogo = prod[s].catalogo % NUM_PRODUCTOS;
+        snprintf(p->nombre, sizeof(p->nombre), "%s", productos[p->catalogo]);
+    }
+    num_recuperados       = n;
+    journal.siguiente_seq = siguiente;
+    journal.previos       = vacio ? 0 : (uint64_t)(pos - (off_t)sizeof(enc)) / sizeof(RegistroJournal);
+    free(estado);
+    free(prod);
+    return !vacio;
+}
+
+/**
+ * Abre el journal, recupera los productos pendientes y arranca su estado
+ *
+ * Parámetros:
+ *   ruta:      Archivo del journal
+ *   recuperar: 0 para empezar con un journal vacío (cada punto del barrido)
+ *   base:      Último snapshot cargado (registros = 0 si no hay)
+ *
+ * Retorna:
+ *   0 si el journal quedó listo, -1 en caso contrario (errno indica la causa)
+ */
+int journal_abrir(const char *ruta, int recuperar, const BaseRecuperacion *base)
+{
+    int fd = open(ruta, O_RDWR | O_CREAT | (recuperar ? 0 : O_TRUNC), 0644);
+    if (fd < 0) return -1;
+
+    uint64_t t = ahora_ns();
+    num_recuperados = recuperados_tomados = recuperados_en_area = 0;
+    journal.siguiente_seq = journal.previos = journal.registros_cola = 0;
+    int rc = journal_recuperar(fd, base);
+    if (rc < 0) { close(fd); return -1; }
+    if (rc == 0) {
+        EncabezadoJournal enc;
+        memset(&enc, 0, sizeof(enc));
+        memcpy(enc.magia, JOURNAL_MAGIA, sizeof(enc.magia));
+        enc.version      = JOURNAL_VERSION;
+        enc.tam_registro = sizeof(RegistroJournal);
+        if (pwrite(fd, &enc, sizeof(enc), 0) != (ssize_t)sizeof(enc) || fdatasync(fd) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    lseek(fd, 0, SEEK_END);
+
+    uint64_t seq = journal.siguiente_seq, previos = journal.previos, cola = journal.registros_cola;
+    memset(&journal, 0, sizeof(journal));
+    journal.fd             = fd;
+    journal.evfd           = -1;
+    journal.siguiente_seq  = seq;
+    journal.previos        = previos;
+    journal.registros_cola = cola;
+    journal.ns_recuperacion = ahora_ns() - t;
+    journal.cap = journal.cap_escribiendo = 256;
+    journal.pendientes    = malloc((size_t)journal.cap * sizeof(RegistroJournal));
+    journal.escribiendo   = malloc((size_t)journal.cap * sizeof(RegistroJournal));
+    if (!journal.pendientes || !journal.escribiendo) {
+        free(journal.pendientes);
+        free(journal.escribiendo);
+        close(fd);
+        journal.fd = -1;
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_mutex_init(&journal.mtx, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&journal.cond_trabajo, &attr);
+    pthread_cond_init(&journal.cond_durable, &attr);
+    pthread_condattr_destroy(&attr);
+    return 0;
+}
+
+/**
+ * Coloca en el área los productos recuperados que caben
+ *
+ * Se llama con el área recién creada y antes de arrancar los hilos; los
+ * que no caben quedan en 'recuperados' para que los coloquen los cajeros.
+ */
+void journal_llenar_area(void)
+{
+    while (recuperados_tomados < num_recuperados && buffer_ocupados(area) < cfg.capacidad) {
+        colocados[recuperados_tomados] = 1;
+        area_depositar(area, &recuperados[recuperados_tomados++]);
+        sem_wait_manual(&area->sem_empty);   // No bloquea: hay espacio
+        sem_signal_manual(&area->sem_full);
+        recuperados_en_area++;
+    }
+}
+
+/**
+ * Toma el siguiente producto recuperado pendiente de colocar
+ *
+ * El cajero debe marcar colocados[i] = 1 dentro de la sección crítica en
+ * que lo coloca; hasta entonces los snapshots lo siguen incluyendo.
+ *
+ * Retorna:
+ *   Índice del producto en 'recuperados' (copiado en 'p'), -1 si ya no quedan
+ */
+static int journal_tomar_recuperado(Producto *p)
+{
+    if (__atomic_load_n(&recuperados_tomados, __ATOMIC_RELAXED) >= num_recuperados) return -1;
+    int i = __atomic_fetch_add(&recuperados_tomados, 1, __ATOMIC_RELAXED);
+    if (i >= num_recuperados) return -1;
+    *p = recuperados[i];
+    return i;
+}
+
+/**
+ * Anexa un registro al lote pendiente
+ *
+ * Se llama con 'mutex' tomado. Para JOURNAL_PRODUCIDO asigna la secuencia
+ * del producto.
+ *
+ * Retorna:
+ *   Número del registro, para esperar su durabilidad con journal_esperar
+ */
+static uint64_t journal_anexar(TipoJournal tipo, Producto *p)
+{
+    pthread_mutex_lock(&journal.mtx);
+    if (journal.n == journal.cap) {
+        RegistroJournal *mas = realloc(journal.pendientes, 2 * (size_t)journal.cap * sizeof(RegistroJournal));
+        if (mas) { journal.pendientes = mas; journal.cap *= 2; }
+    }
+    if (journal.n < journal.cap) {
+        if (tipo == JOURNAL_PRODUCIDO) p->seq = journal.siguiente_seq++;
+        RegistroJournal *r = &journal.pendientes[journal.n++];
+        memset(r, 0, sizeof(*r));
+        r->seq      = p->seq;
+        r->codigo   = p->codigo;
+        r->catalogo = (uint16_t)p->catalogo;
+        r->tipo     = (uint8_t)tipo;
+        r->suma     = journal_suma(r);
+        if (journal.n == 1) journal.t_primero = ahora_ns();
+        if (journal.n == 1 || journal.n >= cfg.journal_lote) pthread_cond_signal(&journal.cond_trabajo);
+    } else if (!journal.error) {
+        journal.error = ENOMEM;
+    }
+    uint64_t numero = ++journal.anexados;
+    pthread_mutex_unlock(&journal.mtx);
+    return numero;
+}
+
+/**
+ * Espera a que el registro 'numero' esté en disco (fdatasync)
+ *
+ * Una corrutina se suspende en 'esperando' en lugar de bloquear al
+ * trabajador, que sigue ejecutando las demás mientras dura el fdatasync.
+ */
+static void journal_esperar(uint64_t numero)
+{
+    uint64_t t = ahora_ns();
+    pthread_mutex_lock(&journal.mtx);
+    while (journal.durables < numero) {
+        if (!co_actual) {
+            pthread_cond_wait(&journal.cond_durable, &journal.mtx);
+            continue;
+        }
+        co_actual->espera_journal = numero;
+        cola_corrutinas_agregar(&journal.esperando, co_actual);
+        corrutina_suspender(CORRUTINA_BLOQUEADA, &journal.mtx);
+        pthread_mutex_lock(&journal.mtx);
+    }
+    journal.esperas++;
+    journal.ns_espera += ahora_ns() - t;
+    pthread_mutex_unlock(&journal.mtx);
+}
+
+/**
+ * Despierta las corrutinas cuyo registro ya es durable (con 'mtx' tomado)
+ *
+ * En modo epoll los trabajadores esperan en epoll_wait y no en la
+ * condición del planificador: las corrutinas pasan a 'despiertas' y se
+ * avisa al bucle por el eventfd.
+ */
+static void journal_despertar(void)
+{
+    ColaCorrutinas siguen = { NULL, NULL };
+    Corrutina     *co;
+    int            avisar = 0;
+
+    while ((co = cola_corrutinas_sacar(&journal.esperando))) {
+        if (co->espera_journal > journal.durables) {
+            cola_corrutinas_agregar(&siguen, co);
+        } else if (journal.evfd < 0) {
+            corrutina_despertar(co);
+        } else {
+            cola_corrutinas_agregar(&journal.despiertas, co);
+            avisar = 1;
+        }
+    }
+    journal.esperando = siguen;
+    if (avisar) eventfd_write(journal.evfd, 1);
+}
+
+/**
+ * Atiende el eventfd del journal: pasa sus corrutinas despiertas a listas
+ *
+ * Retorna:
+ *   1 si había un aviso, 0 si otro hilo del bucle ya lo atendió
+ */
+static int bucle_journal(void)
+{
+    eventfd_t  valor;
+    Corrutina *co;
+
+    if (eventfd_read(journal.evfd, &valor) != 0) return 0;
+    pthread_mutex_lock(&journal.mtx);
+    ColaCorrutinas despiertas = journal.despiertas;
+    journal.despiertas.ini = journal.despiertas.fin = NULL;
+    pthread_mutex_unlock(&journal.mtx);
+    while ((co = cola_corrutinas_sacar(&despiertas))) corrutina_despertar(co);
+    return 1;
+}
+
+/**
+ * Registra en el bucle el eventfd del journal (--modo epoll)
+ *
+ * Retorna:
+ *   0 si quedó registrado, -1 en caso contrario
+ */
+static int journal_preparar_bucle(void)
+{
+    journal.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return bucle_agregar(FUENTE_JOURNAL, journal.evfd, NULL);
+}
+
+/**
+ * Función del hilo del journal: escribe los lotes con group commit
+ */
+void *hilo_journal(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&journal.mtx);
+    for (;;) {
+        while (journal.n == 0 && !journal.fin) pthread_cond_wait(&journal.cond_trabajo, &journal.mtx);
+        if (journal.n == 0) break;
+
+        // Junta el lote: hasta cfg.journal_lote registros o hasta que el
+        // más viejo cumpla el intervalo
+        uint64_t limite = journal.t_primero + (uint64_t)cfg.journal_intervalo_ms * 1000000ull;
+        while (journal.n < cfg.journal_lote && !journal.fin && ahora_ns() < limite) {
+            struct timespec ts = { (time_t)(limite / 1000000000ull), (long)(limite % 1000000000ull) };
+            pthread_cond_timedwait(&journal.cond_trabajo, &journal.mtx, &ts);
+        }
+
+        // Cambia de buffer y escribe sin bloquear a quienes anexan
+        RegistroJournal *lote = journal.pendientes;
+        int              n    = journal.n;
+        int              cap  = journal.cap;
+        uint64_t         hasta = journal.anexados;
+        journal.pendientes      = journal.escribiendo;
+        journal.cap             = journal.cap_escribiendo;
+        journal.escribiendo     = lote;
+        journal.cap_escribiendo = cap;
+        journal.n               = 0;
+        pthread_mutex_unlock(&journal.mtx);
+
+        size_t   total = (size_t)n * sizeof(RegistroJournal), hecho = 0;
+        int      error = 0;
+        uint64_t t     = ahora_ns();
+        while (hecho < total) {
+            ssize_t w = write(journal.fd, (const char *)lote + hecho, total - hecho);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) { error = errno; break; }
+            hecho += (size_t)w;
+        }
+        if (!error && fdatasync(journal.fd) != 0) error = errno;
+        uint64_t ns = ahora_ns() - t;
+
+        pthread_mutex_lock(&journal.mtx);
+        if (error && !journal.error) journal.error = error;
+        journal.fsyncs++;
+        journal.bytes    += hecho;
+        journal.ns_fsync += ns;
+        if ((uint64_t)n > journal.lote_max) journal.lote_max = (uint64_t)n;
+        journal.durables = hasta;  // También si falló: los cajeros no deben quedar bloqueados
+        pthread_cond_broadcast(&journal.cond_durable);
+        journal_despertar();
+    }
+    pthread_mutex_unlock(&journal.mtx);
+    return NULL;
+}
+
+/**
+ * Pide al hilo del journal que escriba lo pendiente y termine
+ */
+void journal_terminar(void)
+{
+    pthread_mutex_lock(&journal.mtx);
+    journal.fin = 1;
+    pthread_cond_signal(&journal.cond_trabajo);
+    pthread_mutex_unlock(&journal.mtx);
+}
+
+void journal_cerrar(void)
+{
+    if (journal.fd < 0) return;
+    close(journal.fd);
+    journal.fd = -1;
+    free(journal.pendientes);
+    free(journal.escribiendo);
+    journal.pendientes = journal.escribiendo = NULL;
+    pthread_mutex_destroy(&journal.mtx);
+    pthread_cond_destroy(&journal.cond_trabajo);
+    pthread_cond_destroy(&journal.cond_durable);
+    if (journal.evfd >= 0) close(journal.evfd);
+    journal.evfd = -1;
+    free(recuperados);
+    free(colocados);
+    recuperados = NULL;
+    colocados   = NULL;
+}
+
+/* -------------------- SNAPSHOTS -------------------- */
+/**
+ * Formato del snapshot (--snapshot)
+ *
+ * Un EncabezadoSnapshot seguido de 'num_productos' RegistroJournal (los
+ * productos sin empacar, del más viejo al más nuevo) y de las semillas
+ * del generador de cada cajero y cada empacador. Se escribe completo en
+ * ARCHIVO.tmp y se renombra, así que siempre hay un snapshot entero.
+ *
+ * registros:       Registros del journal que el snapshot ya incluye
+ * siguiente_seq:   Productos creados hasta el snapshot (secuencia del próximo)
+ * consumidos:      Productos empacados acumulados entre reinicios
+ * indice_in/out:   Índices del buffer circular al tomarlo
+ * suma:            FNV-1a de todo lo que sigue al encabezado
+ */
+#define SNAPSHOT_MAGIA   "SMSNAPSH"
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+    char     magia[8];
+    uint32_t version;
+    uint32_t capacidad;
+    uint32_t num_productos;
+    uint16_t num_cajeros;
+    uint16_t num_empacadores;
+    int32_t  indice_in;
+    int32_t  indice_out;
+    uint64_t registros;
+    uint64_t siguiente_seq;
+    uint64_t consumidos;
+    uint64_t t_real_ns;
+    uint32_t suma;
+    uint32_t relleno;
+} EncabezadoSnapshot;
+
+/**
+ * Estado de los snapshots de la corrida
+ *
+ * copia:          Buffer preasignado donde se copia el estado bajo 'mutex'
+ * semillas:       Semillas restauradas del snapshot cargado (NULL = no hay
+ *                 o no coincide el número de hilos)
+ * consumidos_base: Empacados acumulados por las corridas anteriores
+ * tomados:        Snapshots escritos en esta corrida
+ * ns_pausa:       Tiempo total con 'mutex' tomado para copiar el estado
+ * ns_pausa_max:   Pausa más larga
+ * bytes:          Bytes escritos sumando todos los snapshots
+ * cargado:        1 si la corrida arrancó desde un snapshot
+ */
+typedef struct {
+    char            *copia;
+    size_t           tam_copia;
+    uint64_t        *semillas;
+    uint64_t         consumidos_base;
+    uint64_t         tomados;
+    uint64_t         ns_pausa;
+    uint64_t         ns_pausa_max;
+    uint64_t         bytes;
+    int              cargado;
+} EstadoSnapshots;
+
+EstadoSnapshots snapshots;
+
+static uint32_t snapshot_suma(const void *datos, size_t largo)
+{
+    const unsigned char *b = datos;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < largo; i++) h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+/**
+ * Carga el último snapshot como base de la recuperación
+ *
+ * Parámetros:
+ *   ruta: Archivo del snapshot
+ *   base: Se llena con los productos y la posición del journal
+ *
+ * Retorna:
+ *   1 si se cargó, 0 si no existe, -1 si existe pero es inválido
+ */
+int snapshot_cargar(const char *ruta, BaseRecuperacion *base)
+{
+    memset(base, 0, sizeof(*base));
+    FILE *f = fopen(ruta, "rb");
+    if (!f) return errno == ENOENT ? 0 : -1;
+
+    EncabezadoSnapshot enc;
+    size_t   n_semillas = 0, largo = 0;
+    char    *datos = NULL;
+    int      ok = fread(&enc, sizeof(enc), 1, f) == 1 &&
+                  memcmp(enc.magia, SNAPSHOT_MAGIA, sizeof(enc.magia)) == 0 && enc.version == SNAPSHOT_VERSION;
+    if (ok) {
+        n_semillas = (size_t)enc.num_cajeros + enc.num_empacadores;
+        largo      = (size_t)enc.num_productos * sizeof(RegistroJournal) + n_semillas * sizeof(uint64_t);
+        datos      = malloc(largo ? largo : 1);
+        ok = datos && fread(datos, 1, largo, f) == largo && snapshot_suma(datos, largo) == enc.suma;
+    }
+    fclose(f);
+    if (!ok) { free(datos); errno = EINVAL; return -1; }
+
+    base->registros     = enc.registros;
+    base->siguiente_seq = enc.siguiente_seq;
+    base->productos     = (RegistroJournal *)datos;
+    base->n             = (int)enc.num_productos;
+    snapshots.consumidos_base = enc.consumidos;
+    snapshots.cargado         = 1;
+
+    // Las semillas solo tienen sentido con los mismos hilos
+    if (enc.num_cajeros == cfg.num_cajeros && enc.num_empacadores == cfg.num_empacadores && n_semillas > 0) {
+        snapshots.semillas = malloc(n_semillas * sizeof(uint64_t));
+        if (snapshots.semillas) {
+            memcpy(snapshots.semillas, datos + (size_t)enc.num_productos * sizeof(RegistroJournal),
+                   n_semillas * sizeof(uint64_t));
+        }
+    }
+    return 1;
+}
+
+/**
+ * Reserva el buffer de copia para los snapshots de la corrida
+ *
+ * Alcanza para el área llena más los recuperados que aún no se colocaron.
+ */
+int snapshot_preparar(void)
+{
+    snapshots.tomados = snapshots.ns_pausa = snapshots.ns_pausa_max = snapshots.bytes = 0;
+    snapshots.tam_copia = sizeof(EncabezadoSnapshot)
+                        + ((size_t)cfg.capacidad + (size_t)num_recuperados) * sizeof(RegistroJournal)
+                        + ((size_t)cfg.num_cajeros + (size_t)cfg.num_empacadores) * sizeof(uint64_t);
+    snapshots.copia = malloc(snapshots.tam_copia);
+    return snapshots.copia ? 0 : -1;
+}
+
+static void snapshot_copiar_producto(RegistroJournal *r, const Producto *p)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq      = p->seq;
+    r->codigo   = p->codigo;
+    r->catalogo = (uint16_t)p->catalogo;
+    r->tipo     = JOURNAL_PRODUCIDO;
+    r->suma     = journal_suma(r);
+}
+
+/**
+ * Toma un snapshot sin detener la simulación
+ *
+ * Con 'mutex' tomado solo se copian los productos, los índices y la
+ * posición del journal (los registros anexados hasta ese instante); las
+ * semillas se leen después sin sincronización, porque solo sirven para
+ * continuar la secuencia y no para la consistencia. Luego, fuera de la
+ * sección crítica, espera a que esos registros sean durables (la cola a
+ * repetir empieza justo después) y escribe el archivo.
+ *
+ * Retorna:
+ *   0 si el snapshot quedó en disco, -1 en caso contrario
+ */
+int snapshot_tomar(const char *ruta)
+{
+    EncabezadoSnapshot *enc = (EncabezadoSnapshot *)snapshots.copia;
+    RegistroJournal    *reg = (RegistroJournal *)(snapshots.copia + sizeof(EncabezadoSnapshot));
+    uint32_t            n   = 0;
+    int                 i;
+
+    // ===== COPIA BAJO 'mutex' =====
+    uint64_t t = ahora_ns();
+    if (mutex_bloquear(&area->mutex)) area_reparar();
+    int ocupados = buffer_ocupados(area);
+    for (i = 0; i < ocupados; i++) {
+        snapshot_copiar_producto(&reg[n++], &area->espacios[(area->anillos[0].indice_out + i) % cfg.capacidad]);
+    }
+    for (i = 0; i < num_recuperados; i++) {
+        if (!colocados[i]) snapshot_copiar_producto(&reg[n++], &recuperados[i]);
+    }
+    memset(enc, 0, sizeof(*enc));
+    enc->indice_in  = area->anillos[0].indice_in;
+    enc->indice_out = area->anillos[0].indice_out;
+    enc->consumidos = snapshots.consumidos_base + (uint64_t)area->total_consumidos;
+    pthread_mutex_lock(&journal.mtx);
+    uint64_t anexados   = journal.anexados;
+    enc->registros      = journal.previos + anexados;
+    enc->siguiente_seq  = journal.siguiente_seq;
+    pthread_mutex_unlock(&journal.mtx);
+    pthread_mutex_unlock(&area->mutex);
+    uint64_t pausa = ahora_ns() - t;
+
+    // ===== SEMILLAS (lectura relajada) =====
+    uint64_t *semillas = (uint64_t *)(reg + n);
+    for (i = 0; i < cfg.num_cajeros; i++)     *semillas++ = contador_leer(&ctx_cajeros[i].estad.rng);
+    for (i = 0; i < cfg.num_empacadores; i++) *semillas++ = contador_leer(&ctx_empacadores[i].estad.rng);
+
+    memcpy(enc->magia, SNAPSHOT_MAGIA, sizeof(enc->magia));
+    enc->version         = SNAPSHOT_VERSION;
+    enc->capacidad       = (uint32_t)cfg.capacidad;
+    enc->num_productos   = n;
+    enc->num_cajeros     = (uint16_t)cfg.num_cajeros;
+    enc->num_empacadores = (uint16_t)cfg.num_empacadores;
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    enc->t_real_ns = (uint64_t)real.tv_sec * 1000000000ull + (uint64_t)real.tv_nsec;
+    size_t largo = (size_t)((char *)semillas - (char *)reg);
+    enc->suma    = snapshot_suma(reg, largo);
+    largo       += sizeof(*enc);
+
+    // ===== DURABILIDAD DEL JOURNAL HASTA LA POSICIÓN DEL SNAPSHOT =====
+    pthread_mutex_lock(&journal.mtx);
+    while (journal.durables < anexados) pthread_cond_wait(&journal.cond_durable, &journal.mtx);
+    pthread_mutex_unlock(&journal.mtx);
+
+    // ===== ESCRITURA: ARCHIVO.tmp, fdatasync y rename =====
+    char temporal[PATH_MAX];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", ruta);
+    int fd = open(temporal, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    ssize_t escrito = write(fd, snapshots.copia, largo);
+    int     ok      = escrito == (ssize_t)largo && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temporal, ruta) != 0) { unlink(temporal); return -1; }
+
+    // El rename es durable cuando se sincroniza el directorio
+    char  directorio[PATH_MAX];
+    snprintf(directorio, sizeof(directorio), "%s", ruta);
+    char *barra = strrchr(directorio, '/');
+    if (!barra)                   strcpy(directorio, ".");
+    else if (barra == directorio) barra[1] = '\0';
+    else                          *barra   = '\0';
+    int fd_dir = open(directorio, O_RDONLY | O_DIRECTORY);
+    if (fd_dir >= 0) { fsync(fd_dir); close(fd_dir); }
+
+    snapshots.tomados++;
+    snapshots.ns_pausa += pausa;
+    if (pausa > snapshots.ns_pausa_max) snapshots.ns_pausa_max = pausa;
+    snapshots.bytes += largo;
+    return 0;
+}
+
+/**
+ * Función del hilo de snapshots: toma uno cada cfg.snapshot_ms
+ */
+void *hilo_snapshot(void *arg)
+{
+    (void)arg;
+    struct timespec limite;
+    clock_gettime(CLOCK_MONOTONIC, &limite);
+
+    pthread_mutex_lock(&mtx_fin);
+    while (area->activa) {
+        limite.tv_nsec += (long)(cfg.snapshot_ms % 1000) * 1000000L;
+        limite.tv_sec  += cfg.snapshot_ms / 1000 + limite.tv_nsec / 1000000000L;
+        limite.tv_nsec %= 1000000000L;
+        while (area->activa &&
+               pthread_cond_timedwait(&cond_fin, &mtx_fin, &limite) != ETIMEDOUT) ;
+        if (!area->activa) break;
+        pthread_mutex_unlock(&mtx_fin);
+
+        if (snapshot_tomar(cfg.ruta_snapshot) != 0) perror(cfg.ruta_snapshot);
+
+        pthread_mutex_lock(&mtx_fin);
+    }
+    pthread_mutex_unlock(&mtx_fin);
+    return NULL;
+}
+
+void snapshot_cerrar(void)
+{
+    free(snapshots.copia);
+    free(snapshots.semillas);
+    snapshots.copia    = NULL;
+    snapshots.semillas = NULL;
+    snapshots.cargado  = 0;
+    snapshots.consumidos_base = 0;
+}
+
+/* -------------------- GRUPOS DE CONSUMIDORES -------------------- */
+/**
+ * Grupos de consumidores sobre el área (--grupo), al estilo Disruptor
+ *
+ * Con grupos, el área deja de ser una cola donde cada producto lo toma un
+ * solo empacador: es un anillo de secuencias que lee completo cada grupo
+ * (los empacadores son el primero, "empacar"). La secuencia s es el
+ * producto número s y vive en el espacio s % capacidad, donde lo dejan
+ * los cajeros con el protocolo de siempre (sem_empty + 'mutex').
+ *
+ * El lado de lectura no usa locks:
+ *   - Un trabajador reclama la siguiente secuencia de su grupo con un CAS
+ *     sobre 'siguiente', anunciándola antes en su 'secuencia'
+ *   - Espera (futex) a que 'publicado' la supere y lee el producto en el
+ *     mismo espacio del área, sin copiarlo
+ *   - Al terminar su trabajo la suelta; el espacio se reusa cuando todos
+ *     los grupos lo pasaron: quien avanza ese mínimo (total_consumidos del
+ *     área, con un CAS) devuelve los espacios con signal en sem_empty
+ */
+#define SECUENCIA_LIBRE UINT64_MAX
+
+/**
+ * Secuencia que procesa un trabajador (SECUENCIA_LIBRE = ninguna), en su
+ * propia línea de caché
+ */
+typedef struct {
+    uint64_t secuencia;
+} __attribute__((aligned(TAM_LINEA_CACHE))) SecuenciaTrabajador;
+
+/**
+ * Grupo de consumidores
+ *
+ * siguiente:   Siguiente secuencia sin reclamar del grupo
+ * procesados:  Productos que el grupo terminó
+ * hilos:       Trabajadores del grupo
+ * secuencias:  Secuencia en proceso de cada trabajador
+ */
+typedef struct {
+    uint64_t             siguiente __attribute__((aligned(TAM_LINEA_CACHE)));
+    uint64_t             procesados __attribute__((aligned(TAM_LINEA_CACHE)));
+    int                  hilos;
+    SecuenciaTrabajador *secuencias;
+} GrupoConsumidor;
+
+/**
+ * Trabajador de un grupo de --grupo (los de "empacar" son los empacadores)
+ *
+ * ns_espera:   Esperando que se publique su secuencia
+ * ns_servicio: En el trabajo simulado
+ * ns_total:    Tiempo de vida del hilo
+ * espera:      Desde el escaneo hasta que el trabajador lo tomó
+ */
+typedef struct {
+    pthread_t   hilo;
+    int         grupo;
+    int         id;
+    uint64_t    procesados;
+    uint64_t    ns_espera;
+    uint64_t    ns_servicio;
+    uint64_t    ns_total;
+    Histograma  espera;
+} __attribute__((aligned(TAM_LINEA_CACHE))) TrabajadorGrupo;
+
+/**
+ * Estado de los grupos de la corrida
+ *
+ * num:             Grupos (empacar + cfg.num_grupos; 0 = sin --grupo)
+ * secuencias:      Secuencias de todos los trabajadores, por grupo
+ * trabajadores:    Trabajadores de los grupos de --grupo
+ * publicado:       Secuencias ya escritas por los cajeros
+ * aviso_datos:     Futex que cambia con cada publicación
+ * esperando_datos: Trabajadores dormidos en 'aviso_datos'
+ */
+typedef struct {
+    int                  num;
+    GrupoConsumidor      grupos[MAX_GRUPOS + 1];
+    SecuenciaTrabajador *secuencias;
+    TrabajadorGrupo     *trabajadores;
+    int                  num_trabajadores;
+    uint64_t             publicado __attribute__((aligned(TAM_LINEA_CACHE)));
+    uint32_t             aviso_datos;
+    uint32_t             esperando_datos;
+} Disruptor;
+
+Disruptor disruptor;
+
+/**
+ * Publica las secuencias anteriores a 'hasta' (cajero, fuera de 'mutex')
+ *
+ * Los cajeros escriben en orden bajo 'mutex' pero publican después de
+ * soltarlo, en cualquier orden: 'publicado' solo avanza (máximo con CAS),
+ * y todo espacio anterior a 'hasta' ya se escribió antes de que el cajero
+ * leyera 'hasta' con el mutex tomado.
+ */
+static void disruptor_publicar(uint64_t hasta)
+{
+    uint64_t actual = __atomic_load_n(&disruptor.publicado, __ATOMIC_RELAXED);
+    while (actual < hasta &&
+           !__atomic_compare_exchange_n(&disruptor.publicado, &actual, hasta, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) ;
+    __atomic_add_fetch(&disruptor.aviso_datos, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&disruptor.esperando_datos, __ATOMIC_SEQ_CST)) futex_despertar(&disruptor.aviso_datos, INT_MAX);
+}
+
+/**
+ * Despierta a los trabajadores que esperan datos al terminar la corrida
+ */
+static void disruptor_despertar(void)
+{
+    if (disruptor.num == 0) return;
+    __atomic_add_fetch(&disruptor.aviso_datos, 1, __ATOMIC_SEQ_CST);
+    futex_despertar(&disruptor.aviso_datos, INT_MAX);
+}
+
+/**
+ * Reclama la siguiente secuencia del grupo y espera a que esté publicada
+ *
+ * Parámetros:
+ *   g:   Grupo del trabajador
+ *   w:   Índice del trabajador dentro del grupo
+ *   seq: Secuencia reclamada
+ *
+ * Retorna:
+ *   0 si la secuencia se puede leer, -1 si la simulación terminó
+ */
+static int grupo_reclamar(GrupoConsumidor *g, int w, uint64_t *seq)
+{
+    uint64_t *mia = &g->secuencias[w].secuencia;
+    uint64_t  s   = __atomic_load_n(&g->siguiente, __ATOMIC_SEQ_CST);
+
+    // Anuncia la secuencia antes de tomarla: quien calcula el mínimo lee
+    // 'siguiente' y luego las anunciadas, así nunca la pasa por alto
+    do {
+        __atomic_store_n(mia, s, __ATOMIC_SEQ_CST);
+    } while (!__atomic_compare_exchange_n(&g->siguiente, &s, s + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    while (__atomic_load_n(&disruptor.publicado, __ATOMIC_ACQUIRE) <= s) {
+        if (!area->activa) {
+            __atomic_store_n(mia, SECUENCIA_LIBRE, __ATOMIC_RELEASE);
+            return -1;
+        }
+        // Se anota como dormido antes de volver a mirar 'publicado': un
+        // cajero que publique después ve la anotación y lo despierta
+        __atomic_add_fetch(&disruptor.esperando_datos, 1, __ATOMIC_SEQ_CST);
+        uint32_t aviso = __atomic_load_n(&disruptor.aviso_datos, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&disruptor.publicado, __ATOMIC_SEQ_CST) <= s && area->activa) {
+            futex_esperar(&disruptor.aviso_datos, aviso);
+        }
+        __atomic_sub_fetch(&disruptor.esperando_datos, 1, __ATOMIC_SEQ_CST);
+    }
+    *seq = s;
+    return 0;
+}
+
+/**
+ * Suelta la secuencia del trabajador y libera los espacios del área que
+ * ya pasaron todos los grupos
+ *
+ * Retorna:
+ *   Productos que ya pasaron todos los grupos según este trabajador
+ */
+static long grupo_soltar(AreaEmpaque *a, GrupoConsumidor *g, int w)
+{
+    int      k, i;
+    uint64_t minimo = SECUENCIA_LIBRE;
+
+    __atomic_add_fetch(&g->procesados, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&g->secuencias[w].secuencia, SECUENCIA_LIBRE, __ATOMIC_SEQ_CST);
+
+    for (k = 0; k < disruptor.num; k++) {
+        GrupoConsumidor *o = &disruptor.grupos[k];
+        uint64_t         m = __atomic_load_n(&o->siguiente, __ATOMIC_SEQ_CST);
+        for (i = 0; i < o->hilos; i++) {
+            uint64_t s = __atomic_load_n(&o->secuencias[i].secuencia, __ATOMIC_SEQ_CST);
+            if (s < m) m = s;
+        }
+        if (m < minimo) minimo = m;
+    }
+
+    // Solo un trabajador gana cada avance y devuelve esos espacios
+    long liberados = __atomic_load_n(&a->total_consumidos, __ATOMIC_RELAXED);
+    while ((long)minimo > liberados) {
+        if (__atomic_compare_exchange_n(&a->total_consumidos, &liberados, (long)minimo, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            for (; liberados < (long)minimo; liberados++) sem_signal_manual(&a->sem_empty);
+            break;
+        }
+    }
+    return (long)minimo;
+}
+
+/**
+ * Función de cada trabajador de un grupo de --grupo
+ *
+ * Recorre todas las secuencias del área en el orden en que se publicaron,
+ * repartidas entre los hilos de su grupo, y lee cada producto en su
+ * espacio sin copiarlo ni tomar 'mutex'. Termina con la simulación.
+ */
+void *trabajador_grupo(void *arg)
+{
+    TrabajadorGrupo *w        = arg;
+    GrupoConsumidor *g        = &disruptor.grupos[w->grupo];
+    const DefGrupo  *def      = &cfg.grupos[w->grupo - 1];
+    AreaEmpaque     *a        = area;
+    uint64_t         t_inicio = ahora_ns();
+    uint64_t         seq;
+
+    rng_sembrar(t_inicio ^ ((uint64_t)(w->grupo + 1) * 6151) ^ ((uint64_t)w->id * 98317), NULL);
+
+    while (a->activa) {
+        uint64_t t = ahora_ns();
+        int      rc    = grupo_reclamar(g, w->id - 1, &seq);
+        uint64_t t_ini = ahora_ns();
+        contador_sumar(&w->ns_espera, t_ini - t);
+        if (rc != 0) break;
+        const Producto *p = &a->espacios[seq % (uint64_t)a->capacidad];
+        hist_registrar(&w->espera, t_ini - p->t_escaneo_ns);
+
+        simular_trabajo(&def->servicio);
+        contador_sumar(&w->ns_servicio, ahora_ns() - t_ini);
+        contador_sumar(&w->procesados, 1);
+
+        long liberados = grupo_soltar(a, g, w->id - 1);
+        if (cfg.max_items > 0 && liberados >= cfg.max_items) detener_simulacion();
+    }
+    w->ns_total = ahora_ns() - t_inicio;
+    return NULL;
+}
+
+/**
+ * Prepara los grupos de la corrida: empacar (cfg.num_empacadores) y los
+ * de --grupo
+ *
+ * Retorna:
+ *   0 si se pudo reservar (o no hay grupos), -1 si no hay memoria
+ */
+static int disruptor_preparar(void)
+{
+    int k, i, n = cfg.num_empacadores, usados = 0;
+    memset(&disruptor, 0, sizeof(disruptor));
+    if (cfg.num_grupos == 0) return 0;
+
+    for (k = 0; k < cfg.num_grupos; k++) n += cfg.grupos[k].hilos;
+    if (posix_memalign((void **)&disruptor.secuencias, TAM_LINEA_CACHE, (size_t)n * sizeof(SecuenciaTrabajador)) != 0) {
+        disruptor.secuencias = NULL;
+    }
+    if (posix_memalign((void **)&disruptor.trabajadores, TAM_LINEA_CACHE,
+                       (size_t)(n - cfg.num_empacadores) * sizeof(TrabajadorGrupo)) != 0) {
+        disruptor.trabajadores = NULL;
+    }
+    if (!disruptor.secuencias || !disruptor.trabajadores) {
+        free(disruptor.secuencias); free(disruptor.trabajadores);
+        memset(&disruptor, 0, sizeof(disruptor));
+        return -1;
+    }
+    memset(disruptor.trabajadores, 0, (size_t)(n - cfg.num_empacadores) * sizeof(TrabajadorGrupo));
+    for (k = 0; k < n; k++) disruptor.secuencias[k].secuencia = SECUENCIA_LIBRE;
+    for (k = 0; k <= cfg.num_grupos; k++) {
+        GrupoConsumidor *g = &disruptor.grupos[k];
+        g->hilos      = k == 0 ? cfg.num_empacadores : cfg.grupos[k - 1].hilos;
+        g->secuencias = disruptor.secuencias + usados;
+        usados       += g->hilos;
+        for (i = 0; k > 0 && i < g->hilos; i++) {
+            TrabajadorGrupo *w = &disruptor.trabajadores[disruptor.num_trabajadores++];
+            w->grupo = k;
+            w->id    = i + 1;
+        }
+    }
+    disruptor.num = cfg.num_grupos + 1;
+    return 0;
+}
+
+static void disruptor_liberar(void)
+{
+    free(disruptor.secuencias);
+    free(disruptor.trabajadores);
+    memset(&disruptor, 0, sizeof(disruptor));
+}
+
+/* -------------------- HILO: CAJERO - PRODUCTOR -------------------- */
+/**
+ * Resultado de pedir un espacio del área para un producto nuevo
+ */
+typedef enum {
+    COLOCAR_ESPACIO = 0,        // Tomó un permiso de sem_empty
+    COLOCAR_SOBRESCRIBIR,       // Sin espacio: reemplaza el producto más viejo
+    COLOCAR_DESCARTADO,         // Sin espacio: el producto se pierde
+    COLOCAR_EXPIRADO,           // Venció la espera máxima: el producto se pierde
+    COLOCAR_RECHAZADO           // Sin espacio: el producto vuelve al cajero
+} ResultadoColocar;
+
+/**
+ * Pide un espacio en el área aplicando su política de área llena
+ *
+ * Parámetros:
+ *   a:        Área del carril
+ *   politica: a->politica, o LLENO_BLOQUEAR para productos que no se
+ *             pueden perder (recuperados del journal)
+ *   st:       Estadísticas del cajero (esperas y contadores de área llena)
+ *
+ * Retorna:
+ *   COLOCAR_ESPACIO si hay que colocar el producto y después señalar
+ *   sem_full; cualquier otro valor indica qué hacer sin espacio
+ */
+static ResultadoColocar area_reservar(AreaEmpaque *a, PoliticaLleno politica, EstadisticasHilo *st)
+{
+    int rc;
+    switch (politica) {
+    case LLENO_TIMEOUT:
+        rc = sem_wait_timeout(&a->sem_empty, ahora_ns() + a->espera_max_ns);
+        contador_sumar(&st->esperas_sem, 1);
+        if (rc != 0) contador_sumar(&st->esperas_bloqueadas, 1);
+        if (rc >= 0) return COLOCAR_ESPACIO;
+        contador_sumar(&st->lleno_expirados, 1);
+        return COLOCAR_EXPIRADO;
+    case LLENO_DESCARTAR_NUEVO:
+    case LLENO_DESCARTAR_VIEJO:
+    case LLENO_RECHAZAR:
+        contador_sumar(&st->esperas_sem, 1);
+        if (sem_trywait_manual(&a->sem_empty) == 0) return COLOCAR_ESPACIO;
+        if (politica == LLENO_DESCARTAR_VIEJO) return COLOCAR_SOBRESCRIBIR;  // Se cuenta al reemplazar
+        contador_sumar(politica == LLENO_RECHAZAR ? &st->lleno_rechazados : &st->lleno_descartados, 1);
+        return politica == LLENO_RECHAZAR ? COLOCAR_RECHAZADO : COLOCAR_DESCARTADO;
+    default:
+        sem_esperar_contado(&a->sem_empty, st);
+        return COLOCAR_ESPACIO;
+    }
 }
 
-/* -------------------- HILO: CAJERO - PRODUCTOR -------------------- */
 /**
  * Función ejecutada por cada hilo cajero (productor)
  * 
  * Parámetros:
- *   arg: Puntero a un entero con el ID del cajero
- * 
- * Comportamiento:
- *   1. Simula el escaneo de productos con un delay aleatorio
- *   2. Coloca productos en el área de empaque (buffer compartido)
- *   3. Utiliza semáforos para coordinar con empacadores
- *   4. Se ejecuta hasta que simulacion_activa = 0
- * 
- * Protocolo de sincronización:
- *   - sem_wait(empty): Espera que haya espacio disponible
- *   - mutex_lock: Entra a sección crítica para modificar el buffer
- *   - mutex_unlock: Sale de sección crítica
- *   - sem_signal(full): Señala que hay un producto disponible
+ *   arg: ContextoHilo del cajero (en la arena de la corrida); indica su
+ *        ID y el carril que atiende
+ * 
+ * Comportamiento:
+ *   1. Simula el escaneo de productos con un delay aleatorio, o con --replay
+ *      espera la llegada de la siguiente fila de su caja en la traza. Con
+ *      --llegadas el producto sale de la cola de llegadas y luego se escanea
+ *   2. Coloca productos en el área de empaque (buffer compartido); con
+ *      --journal coloca primero los recuperados y no señala sem_full hasta
+ *      que el registro del producto está en disco. Con el área llena
+ *      aplica su política (--lleno): esperar, esperar con plazo,
+ *      descartar el nuevo, reemplazar el más viejo o reintentar
+ *   3. Utiliza semáforos para coordinar con empacadores
+ *   4. Se ejecuta hasta que a->activa = 0 (la bandera de su carril)
+ * 
+ * Protocolo de sincronización:
+ *   - sem_wait(empty): Espera que haya espacio disponible
+ *   - mutex_lock: Entra a sección crítica para modificar el buffer
+ *   - mutex_unlock: Sale de sección crítica
+ *   - sem_signal(full): Señala que hay un producto disponible
+ */
+void *cajero(void *arg)
+{
+    ContextoHilo     *ctx      = arg;
+    int               id       = ctx->id;
+    EstadisticasHilo *st       = &ctx->estad;
+    AreaEmpaque      *a        = carriles[ctx->carril];
+    TiemposHilo      *tm       = &st->tiempos;
+    BufferTraza      *tr       = ctx->traza;
+    uint64_t          t_inicio = ahora_ns();
+    uint64_t          t;
+    int               con_replay = replay.datos != NULL;  // --replay
+    FilaReplay        fila;
+    GeneradorLlegadas gen;
+    uint64_t          llegada  = 0;
+
+    sonda_tid = SONDA_TID(ROL_CAJERO, id);
+
+    // Inicializa semilla aleatoria única para este cajero
+    rng_sembrar(snapshots.semillas ? snapshots.semillas[id - 1] : t_inicio ^ ((uint64_t)id * 1234), &st->rng);
+    if (cfg.llegadas != LLEGADAS_CERRADO) {
+        llegadas_iniciar(&gen, ctx->cola_llegadas, t_inicio);
+    }
+
+    while (a->activa) {
+        Producto p;
+
+        // Productos recuperados del journal: ya escaneados y ya registrados
+        int recuperado = journal_tomar_recuperado(&p) + 1;  // 0 = producto nuevo
+        if (recuperado) p.t_escaneo_ns = p.t_llegada_ns = ahora_ns();
+
+        // Lazo abierto: toma el siguiente producto que llegó al cajero
+        if (!recuperado && cfg.llegadas != LLEGADAS_CERRADO) {
+            llegada = llegadas_siguiente(&gen, a, st);
+            if (!llegada) break;
+        }
+
+        // Simula tiempo de escaneo de producto (200-1000 ms por defecto)
+        // o espera la llegada de la siguiente fila de la traza
+        if (!recuperado) {
+            t = ahora_ns();
+            if (cfg.llegadas == LLEGADAS_CERRADO) llegada = t;
+            if (con_replay) {
+                if (!replay_siguiente_cajero(id, &fila)) {
+                    replay_terminar_cajero();
+                    break;
+                }
+                replay_esperar(&fila);
+            } else {
+                simular_trabajo(&cfg.escaneo);
+            }
+
+            // Crea un nuevo producto con datos aleatorios (o los de la traza)
+            p.t_escaneo_ns = ahora_ns();
+            p.t_llegada_ns = con_replay ? p.t_escaneo_ns : llegada;
+            p.seq          = 0;
+            contador_sumar(&tm->ns_servicio, p.t_escaneo_ns - t);
+            traza_registrar(tr, SPAN_SERVICIO, t, p.t_escaneo_ns);
+
+            if (!a->activa) break;
+
+            if (con_replay) {
+                p.codigo   = (int)fila.codigo;
+                p.catalogo = (int)(fila.codigo % NUM_PRODUCTOS);
+            } else {
+                p.codigo   = rng_entero(9000) + 1000;  // Código entre 1000-9999
+                p.catalogo = rng_entero(NUM_PRODUCTOS);
+            }
+            strncpy(p.nombre, productos[p.catalogo],
+                    sizeof(p.nombre) - 1);
+            p.nombre[sizeof(p.nombre) - 1] = '\0';  // Asegura terminación nula
+            p.prioridad = cfg.prioridades > 1 ? sortear_prioridad() : 0;
+        }
+
+        // WAIT en sem_empty: espera que haya espacio en el buffer, según la
+        // política del área llena (los recuperados no se pueden perder)
+        ResultadoColocar res;
+        uint64_t         t_mutex;
+        for (;;) {
+            estado_publicar(st, ESTADO_ESPERA_SEM);
+            t = ahora_ns();
+            res = area_reservar(a, recuperado ? LLENO_BLOQUEAR : a->politica, st);
+            t_mutex = ahora_ns();
+            contador_sumar(&tm->ns_espera_sem, t_mutex - t);
+            traza_registrar(tr, SPAN_ESPERA_SEM, t, t_mutex);
+            if (res != COLOCAR_RECHAZADO || !a->activa) break;
+
+            // Rechazado: el cliente vuelve a presentar el producto después
+            // de otro tiempo de escaneo
+            estado_publicar(st, ESTADO_TRABAJANDO);
+            simular_trabajo(&cfg.escaneo);
+            contador_sumar(&tm->ns_servicio, ahora_ns() - t_mutex);
+        }
+
+        // Verifica si se debe terminar; libera semáforo para no bloquear otros
+        if (!a->activa) {
+            if (res == COLOCAR_ESPACIO) sem_signal_manual(&a->sem_empty);
+            break;
+        }
+        if (res == COLOCAR_DESCARTADO || res == COLOCAR_EXPIRADO) {
+            estado_publicar(st, ESTADO_TRABAJANDO);
+            continue;
+        }
+
+        // ===== INICIA SECCIÓN CRÍTICA =====
+        estado_publicar(st, ESTADO_ESPERA_MUTEX);
+        mutex_adquirir(&a->mutex, st);
+        estado_publicar(st, ESTADO_EN_SC);
+        uint64_t t_sc = ahora_ns();
+        contador_sumar(&tm->ns_espera_mutex, t_sc - t_mutex);
+        traza_registrar(tr, SPAN_ESPERA_MUTEX, t_mutex, t_sc);
+        SONDA(mutex_adquirido, sonda_tid, a->anillos[p.prioridad].indice_in, buffer_ocupados(a));
+        acumular_ocupacion(a, t_sc);
+
+        // Reemplaza el producto más viejo: la ocupación y los semáforos no
+        // cambian. Si todos los espacios están reservados por cajeros que
+        // aún no colocan, no hay producto que reemplazar y se descarta
+        if (res == COLOCAR_SOBRESCRIBIR) {
+            if (buffer_ocupados(a) == 0) {
+                pthread_mutex_unlock(&a->mutex);
+                contador_sumar(&st->lleno_descartados, 1);
+                estado_publicar(st, ESTADO_TRABAJANDO);
+                continue;
+            }
+            area_sobrescribir(a);
+            contador_sumar(&st->lleno_sobrescritos, 1);
+        }
+
+        // Registra el producto en el journal en el mismo orden que el buffer
+        uint64_t registro = 0;
+        if (journal.fd >= 0 && !recuperado) registro = journal_anexar(JOURNAL_PRODUCIDO, &p);
+        if (recuperado) colocados[recuperado - 1] = 1;
+
+        // Coloca el producto en el buffer circular de su clase
+        int  espacio   = area_depositar(a, &p);
+        long secuencia = a->total_producidos;  // Con --grupo se publica hasta aquí
+        contador_sumar(&st->items, 1);
+        int ocupados = buffer_ocupados(a);
+        SONDA(deposito, sonda_tid, espacio, ocupados);
+
+        log_evento(ROL_CAJERO, id, ACCION_COLOCA,
+                   &p, ocupados);
+
+        pthread_mutex_unlock(&a->mutex);
+        // ===== FIN SECCIÓN CRÍTICA =====
+        SONDA(mutex_liberado, sonda_tid, espacio, ocupados);
+        t = ahora_ns();
+        contador_sumar(&tm->ns_sc, t - t_sc);
+        traza_registrar(tr, SPAN_SC, t_sc, t);
+        estado_publicar(st, ESTADO_TRABAJANDO);
+
+        log_evento(ROL_CAJERO, id, ACCION_SALE_SC,
+                   &p, ocupados);
+
+        // Un producto solo se ofrece a los empacadores cuando es durable
+        if (registro) journal_esperar(registro);
+
+        // SIGNAL en sem_full: indica que hay un producto disponible (al
+        // reemplazar uno viejo la cantidad de productos no cambió)
+        // Con --grupo los consumidores esperan 'publicado' en lugar de sem_full
+        if (res == COLOCAR_ESPACIO) {
+            if (disruptor.num > 0) disruptor_publicar((uint64_t)secuencia);
+            else                   sem_signal_manual(&a->sem_full);
+        }
+    }
+
+    tm->ns_total = ahora_ns() - t_inicio;
+    estado_publicar(st, ESTADO_TRABAJANDO);
+    BufferLogTexto *lb = ctx->logtxt;
+    if (lb) {
+        log_texto_agregar(lb, "[FIN] Cajero     #%d termino.\n", id);
+        log_texto_vaciar(lb);
+    } else if (cfg.log_nivel >= LOG_RESUMEN) {
+        printf("[FIN] Cajero     #%d termino.\n", id);
+    }
+    return NULL;
+}
+
+/* -------------------- PIPELINE DE ETAPAS -------------------- */
+/**
+ * Cola acotada de índices de productos entre dos etapas
+ *
+ * Mismo protocolo que el área de empaque (sem_empty, sem_full y un
+ * mutex), pero los espacios guardan el índice del producto en el pool
+ * del pipeline: el producto se copia una sola vez al salir del empacado
+ * y de ahí en adelante solo se mueve su índice.
+ *
+ * indices:            Buffer circular de índices
+ * capacidad:          Espacios de 'indices'
+ * indice_in/out:      Posición de inserción y de extracción
+ * entrados/salidos:   Índices puestos y tomados (ocupados = diferencia)
+ * ocupacion_integral: Suma de (ocupados * ns), para la ocupación media
+ * t_ultimo_cambio_ns: Instante del último cambio de ocupación
+ */
+typedef struct {
+    uint32_t       *indices;
+    int             capacidad;
+    int             indice_in;
+    int             indice_out;
+    long            entrados;
+    long            salidos;
+    uint64_t        ocupacion_integral;
+    uint64_t        t_ultimo_cambio_ns;
+    Semaforo        sem_empty;
+    Semaforo        sem_full;
+    pthread_mutex_t mutex;
+} ColaIndices;
+
+/**
+ * Producto en tránsito por el pipeline
+ *
+ * p:            Producto tal como salió del empacado
+ * t_entrada_ns: Instante en que entró a la cola de su etapa actual
+ */
+typedef struct {
+    Producto p;
+    uint64_t t_entrada_ns;
+} ItemPipeline;
+
+/**
+ * Trabajador de una etapa; solo él escribe sus contadores
+ *
+ * procesados:  Productos que terminó
+ * ns_servicio: Tiempo de trabajo simulado
+ * ns_bloqueo:  Esperando espacio en la cola de la etapa siguiente
+ * ns_total:    Tiempo de vida del hilo
+ * espera:      Desde que el producto entró a la cola de la etapa hasta
+ *              que el trabajador lo tomó
+ * total:       Desde el escaneo hasta la salida del pipeline (solo la
+ *              última etapa)
+ */
+typedef struct {
+    pthread_t   hilo;
+    int         etapa;
+    int         id;
+    uint64_t    procesados;
+    uint64_t    ns_servicio;
+    uint64_t    ns_bloqueo;
+    uint64_t    ns_total;
+    Histograma  espera;
+    Histograma  total;
+} __attribute__((aligned(TAM_LINEA_CACHE))) TrabajadorEtapa;
+
+/**
+ * Pipeline de la corrida: pool de productos, cola de cada etapa y sus
+ * trabajadores
+ *
+ * El pool tiene un producto por cada espacio de las colas y por cada
+ * hilo que puede tener uno en la mano (empacadores y trabajadores), así
+ * que 'libres' nunca obliga a esperar: la contrapresión viene solo de
+ * las colas de las etapas y llega hasta el área de empaque.
+ *
+ * num:          Etapas (cfg.num_etapas; 0 = sin pipeline)
+ * items:        Pool de productos
+ * libres:       Índices del pool sin usar
+ * entradas:     Cola de entrada de cada etapa
+ * trabajadores: Todos los trabajadores, agrupados por etapa
+ */
+typedef struct {
+    int              num;
+    ItemPipeline    *items;
+    uint32_t        *indices;
+    ColaIndices      libres;
+    ColaIndices      entradas[MAX_ETAPAS];
+    TrabajadorEtapa *trabajadores;
+    int              num_trabajadores;
+} Pipeline;
+
+Pipeline pipeline;
+
+/**
+ * Inicializa una cola con los índices 0..llenos-1 ya colocados
+ */
+static void cola_indices_iniciar(ColaIndices *q, uint32_t *indices, int capacidad, int llenos)
+{
+    q->indices   = indices;
+    q->capacidad = capacidad;
+    for (int i = 0; i < llenos; i++) indices[i] = (uint32_t)i;
+    q->indice_in  = llenos % capacidad;
+    q->indice_out = 0;
+    q->entrados   = llenos;
+    q->salidos    = 0;
+    q->ocupacion_integral = 0;
+    q->t_ultimo_cambio_ns = ahora_ns();
+    sem_inicializar(&q->sem_empty, capacidad - llenos, cfg.backend, 0);
+    sem_inicializar(&q->sem_full,  llenos,             cfg.backend, 0);
+    mutex_inicializar(&q->mutex, 0);
+}
+
+static void cola_indices_destruir(ColaIndices *q)
+{
+    sem_destruir(&q->sem_empty);
+    sem_destruir(&q->sem_full);
+    pthread_mutex_destroy(&q->mutex);
+}
+
+/**
+ * Acumula la ocupación de la cola hasta 'ahora' (con 'mutex' tomado)
+ */
+static void cola_indices_acumular(ColaIndices *q, uint64_t ahora)
+{
+    if (ahora > q->t_ultimo_cambio_ns) {
+        q->ocupacion_integral += (uint64_t)(q->entrados - q->salidos) * (ahora - q->t_ultimo_cambio_ns);
+        q->t_ultimo_cambio_ns  = ahora;
+    }
+}
+
+/**
+ * Pone 'indice' en la cola, esperando espacio si está llena
+ *
+ * Retorna:
+ *   0 si lo puso, -1 si la simulación terminó mientras esperaba
+ */
+static int cola_indices_poner(ColaIndices *q, uint32_t indice)
+{
+    sem_wait_manual(&q->sem_empty);
+    if (!area->activa) { sem_signal_manual(&q->sem_empty); return -1; }
+    pthread_mutex_lock(&q->mutex);
+    cola_indices_acumular(q, ahora_ns());
+    q->indices[q->indice_in] = indice;
+    q->indice_in = (q->indice_in + 1) % q->capacidad;
+    q->entrados++;
+    pthread_mutex_unlock(&q->mutex);
+    sem_signal_manual(&q->sem_full);
+    return 0;
+}
+
+/**
+ * Toma el siguiente índice de la cola, esperando si está vacía
+ *
+ * Retorna:
+ *   0 si tomó uno (en *indice), -1 si la simulación terminó
+ */
+static int cola_indices_tomar(ColaIndices *q, uint32_t *indice)
+{
+    sem_wait_manual(&q->sem_full);
+    if (!area->activa) { sem_signal_manual(&q->sem_full); return -1; }
+    pthread_mutex_lock(&q->mutex);
+    cola_indices_acumular(q, ahora_ns());
+    *indice = q->indices[q->indice_out];
+    q->indice_out = (q->indice_out + 1) % q->capacidad;
+    q->salidos++;
+    pthread_mutex_unlock(&q->mutex);
+    sem_signal_manual(&q->sem_empty);
+    return 0;
+}
+
+/**
+ * Entrega un producto empacado a la primera etapa del pipeline
+ *
+ * Parámetros:
+ *   p:  Producto que terminó el empacador
+ *   st: Estadísticas del empacador (tiempo esperando espacio)
+ */
+static void pipeline_entregar(const Producto *p, EstadisticasHilo *st)
+{
+    uint32_t indice;
+    uint64_t t = ahora_ns();
+    if (cola_indices_tomar(&pipeline.libres, &indice) != 0) return;
+    pipeline.items[indice].p            = *p;
+    pipeline.items[indice].t_entrada_ns = t;
+    if (cola_indices_poner(&pipeline.entradas[0], indice) != 0) return;  // Al terminar el pool ya no se usa
+    contador_sumar(&st->ns_entrega, ahora_ns() - t);
+}
+
+/**
+ * Función de cada trabajador de una etapa del pipeline
+ *
+ * Toma el índice de un producto de la cola de su etapa, simula el
+ * trabajo y lo pasa a la cola de la etapa siguiente; la última etapa
+ * lo devuelve al pool. Termina con la simulación, como los cajeros y
+ * empacadores; los productos que quedan en las colas no se procesan.
+ */
+void *trabajador_etapa(void *arg)
+{
+    TrabajadorEtapa *w        = arg;
+    const DefEtapa  *def      = &cfg.etapas[w->etapa];
+    ColaIndices     *entrada  = &pipeline.entradas[w->etapa];
+    int              ultima   = w->etapa == pipeline.num - 1;
+    uint64_t         t_inicio = ahora_ns();
+    uint32_t         indice;
+
+    rng_sembrar(t_inicio ^ ((uint64_t)(w->etapa + 1) * 7919) ^ ((uint64_t)w->id * 104729), NULL);
+
+    while (area->activa && cola_indices_tomar(entrada, &indice) == 0) {
+        ItemPipeline *item = &pipeline.items[indice];
+        uint64_t      t    = ahora_ns();
+        hist_registrar(&w->espera, t - item->t_entrada_ns);
+        simular_trabajo(&def->servicio);
+        uint64_t fin = ahora_ns();
+        contador_sumar(&w->ns_servicio, fin - t);
+        contador_sumar(&w->procesados, 1);
+
+        if (ultima) {
+            hist_registrar(&w->total, fin - item->p.t_escaneo_ns);
+            if (cola_indices_poner(&pipeline.libres, indice) != 0) break;
+        } else {
+            item->t_entrada_ns = fin;
+            if (cola_indices_poner(&pipeline.entradas[w->etapa + 1], indice) != 0) break;
+            contador_sumar(&w->ns_bloqueo, ahora_ns() - fin);
+        }
+    }
+    w->ns_total = ahora_ns() - t_inicio;
+    return NULL;
+}
+
+/**
+ * Reserva el pool y las colas del pipeline para la corrida
+ *
+ * Retorna:
+ *   0 si se pudo reservar (o no hay etapas), -1 si no hay memoria
+ */
+static int pipeline_preparar(void)
+{
+    int k, i, n_items = cfg.num_empacadores, n_trab = 0, n_indices;
+    memset(&pipeline, 0, sizeof(pipeline));
+    if (cfg.num_etapas == 0) return 0;
+
+    for (k = 0; k < cfg.num_etapas; k++) {
+        n_items += cfg.etapas[k].capacidad + cfg.etapas[k].hilos;
+        n_trab  += cfg.etapas[k].hilos;
+    }
+    n_indices = n_items;
+    for (k = 0; k < cfg.num_etapas; k++) n_indices += cfg.etapas[k].capacidad;
+
+    pipeline.items   = calloc((size_t)n_items, sizeof(ItemPipeline));
+    pipeline.indices = calloc((size_t)n_indices, sizeof(uint32_t));
+    if (posix_memalign((void **)&pipeline.trabajadores, TAM_LINEA_CACHE, (size_t)n_trab * sizeof(TrabajadorEtapa)) != 0) {
+        pipeline.trabajadores = NULL;
+    }
+    if (!pipeline.items || !pipeline.indices || !pipeline.trabajadores) {
+        free(pipeline.items); free(pipeline.indices); free(pipeline.trabajadores);
+        memset(&pipeline, 0, sizeof(pipeline));
+        return -1;
+    }
+    memset(pipeline.trabajadores, 0, (size_t)n_trab * sizeof(TrabajadorEtapa));
+
+    uint32_t *v = pipeline.indices;
+    cola_indices_iniciar(&pipeline.libres, v, n_items, n_items);
+    v += n_items;
+    for (k = 0; k < cfg.num_etapas; k++) {
+        cola_indices_iniciar(&pipeline.entradas[k], v, cfg.etapas[k].capacidad, 0);
+        v += cfg.etapas[k].capacidad;
+        for (i = 0; i < cfg.etapas[k].hilos; i++) {
+            TrabajadorEtapa *w = &pipeline.trabajadores[pipeline.num_trabajadores++];
+            w->etapa = k;
+            w->id    = i + 1;
+        }
+    }
+    pipeline.num = cfg.num_etapas;
+    return 0;
+}
+
+static void pipeline_liberar(void)
+{
+    if (pipeline.num == 0) return;
+    cola_indices_destruir(&pipeline.libres);
+    for (int k = 0; k < pipeline.num; k++) cola_indices_destruir(&pipeline.entradas[k]);
+    free(pipeline.items);
+    free(pipeline.indices);
+    free(pipeline.trabajadores);
+    memset(&pipeline, 0, sizeof(pipeline));
+}
+
+/**
+ * Despierta a quien espera en las colas del pipeline al terminar la corrida
+ */
+static void pipeline_despertar(void)
+{
+    int k, i, hilos = cfg.num_empacadores + pipeline.num_trabajadores;
+    for (i = 0; pipeline.num > 0 && i < hilos; i++) {
+        sem_signal_manual(&pipeline.libres.sem_full);
+        for (k = 0; k < pipeline.num; k++) {
+            sem_signal_manual(&pipeline.entradas[k].sem_full);
+            sem_signal_manual(&pipeline.entradas[k].sem_empty);
+        }
+    }
+}
+
+/* -------------------- HILO: EMPACADOR - CONSUMIDOR -------------------- */
+/**
+ * Bucle del empacador con --grupo: es un trabajador del grupo "empacar"
+ *
+ * Lee cada producto en su espacio del área sin 'mutex' (ver grupo_reclamar)
+ * y lo suelta después de empacarlo y entregarlo al pipeline, porque hasta
+ * entonces lo está usando en el lugar.
+ */
+static void *empacador_grupo(ContextoHilo *ctx)
+{
+    int               id       = ctx->id;
+    EstadisticasHilo *st       = &ctx->estad;
+    AreaEmpaque      *a        = carriles[ctx->carril];
+    TiemposHilo      *tm       = &st->tiempos;
+    BufferTraza      *tr       = ctx->traza;
+    GrupoConsumidor  *g        = &disruptor.grupos[0];
+    uint64_t          t_inicio = ahora_ns();
+    uint64_t          t, seq;
+
+    sonda_tid = SONDA_TID(ROL_EMPACADOR, id);
+    rng_sembrar(snapshots.semillas ? snapshots.semillas[cfg.num_cajeros + id - 1] : t_inicio ^ ((uint64_t)id * 5678),
+                &st->rng);
+
+    while (a->activa) {
+
+        // Espera su secuencia en lugar de sem_full
+        estado_publicar(st, ESTADO_ESPERA_SEM);
+        t = ahora_ns();
+        int      rc    = grupo_reclamar(g, id - 1, &seq);
+        uint64_t t_ini = ahora_ns();
+        contador_sumar(&tm->ns_espera_sem, t_ini - t);
+        traza_registrar(tr, SPAN_ESPERA_SEM, t, t_ini);
+        if (rc != 0) break;
+        const Producto *p = &a->espacios[seq % (uint64_t)a->capacidad];
+        estado_publicar(st, ESTADO_TRABAJANDO);
+
+        contador_sumar(&st->items, 1);
+        hist_registrar(&st->latencia, t_ini - p->t_escaneo_ns);
+        hist_registrar(&st->latencia_llegada, t_ini - p->t_llegada_ns);
+        log_evento(ROL_EMPACADOR, id, ACCION_TOMA, p, buffer_ocupados(a));
+
+        // Simula tiempo de empacado (400-1600 ms por defecto)
+        simular_trabajo(&cfg.empaque);
+        uint64_t t_fin_servicio = ahora_ns();
+        contador_sumar(&tm->ns_servicio, t_fin_servicio - t_ini);
+        traza_registrar(tr, SPAN_SERVICIO, t_ini, t_fin_servicio);
+
+        if (pipeline.num > 0) pipeline_entregar(p, st);
+
+        // Suelta la secuencia: el espacio se reusa cuando lo pasen todos
+        long liberados = grupo_soltar(a, g, id - 1);
+        if (cfg.max_items > 0 && liberados >= cfg.max_items) detener_simulacion();
+        if (replay.agotado && buffer_ocupados(a) == 0) detener_simulacion();
+    }
+
+    tm->ns_total = ahora_ns() - t_inicio;
+    estado_publicar(st, ESTADO_TRABAJANDO);
+    BufferLogTexto *lb = ctx->logtxt;
+    if (lb) {
+        log_texto_agregar(lb, "[FIN] Empacador  #%d termino.\n", id);
+        log_texto_vaciar(lb);
+    } else if (cfg.log_nivel >= LOG_RESUMEN) {
+        printf("[FIN] Empacador  #%d termino.\n", id);
+    }
+    return NULL;
+}
+
+/**
+ * Función ejecutada por cada hilo empacador (consumidor)
+ * 
+ * Parámetros:
+ *   arg: ContextoHilo del empacador (en la arena de la corrida); indica
+ *        su ID y el carril que atiende
+ * 
+ * Comportamiento:
+ *   1. Toma productos del área de empaque (buffer compartido), primero
+ *      los de la clase de prioridad más urgente (ver area_elegir_clase)
+ *   2. Simula el empacado con un delay aleatorio y, con --etapa, pasa el
+ *      producto a la primera etapa del pipeline (con --grupo sigue
+ *      empacador_grupo)
+ *   3. Utiliza semáforos para coordinar con cajeros
+ *   4. Se ejecuta hasta que a->activa = 0 o se alcanza cfg.max_items
+ * 
+ * Protocolo de sincronización:
+ *   - sem_wait(full): Espera que haya un producto disponible
+ *   - mutex_lock: Entra a sección crítica para modificar el buffer
+ *   - mutex_unlock: Sale de sección crítica
+ *   - sem_signal(empty): Señala que hay un espacio libre
+ */
+void *empacador(void *arg)
+{
+    ContextoHilo     *ctx      = arg;
+    int               id       = ctx->id;
+    EstadisticasHilo *st       = &ctx->estad;
+    AreaEmpaque      *a        = carriles[ctx->carril];
+    TiemposHilo      *tm       = &st->tiempos;
+    BufferTraza      *tr       = ctx->traza;
+    uint64_t          t_inicio = ahora_ns();
+    uint64_t          t;
+
+    if (disruptor.num > 0) return empacador_grupo(ctx);
+    sonda_tid = SONDA_TID(ROL_EMPACADOR, id);
+
+    // Inicializa semilla aleatoria única para este empacador
+    rng_sembrar(snapshots.semillas ? snapshots.semillas[cfg.num_cajeros + id - 1] : t_inicio ^ ((uint64_t)id * 5678),
+                &st->rng);
+
+    while (a->activa) {
+
+        // WAIT en sem_full: espera que haya un producto en el buffer
+        estado_publicar(st, ESTADO_ESPERA_SEM);
+        t = ahora_ns();
+        sem_esperar_contado(&a->sem_full, st);
+        uint64_t t_mutex = ahora_ns();
+        contador_sumar(&tm->ns_espera_sem, t_mutex - t);
+        traza_registrar(tr, SPAN_ESPERA_SEM, t, t_mutex);
+
+        // Verifica si se debe terminar; libera semáforo para no bloquear otros
+        if (!a->activa) { sem_signal_manual(&a->sem_full); break; }
+
+        // ===== INICIA SECCIÓN CRÍTICA =====
+        estado_publicar(st, ESTADO_ESPERA_MUTEX);
+        mutex_adquirir(&a->mutex, st);
+        estado_publicar(st, ESTADO_EN_SC);
+        uint64_t t_sc = ahora_ns();
+        contador_sumar(&tm->ns_espera_mutex, t_sc - t_mutex);
+        traza_registrar(tr, SPAN_ESPERA_MUTEX, t_mutex, t_sc);
+        acumular_ocupacion(a, t_sc);
+
+        // Toma el producto de la clase más urgente (o de una envejecida)
+        Producto p;
+        int clase    = area_elegir_clase(a, t_sc);
+        SONDA(mutex_adquirido, sonda_tid, a->anillos[clase].indice_out, buffer_ocupados(a));
+        int espacio  = area_retirar(a, clase, &p);
+        if (journal.fd >= 0) journal_anexar(JOURNAL_CONSUMIDO, &p);  // Sin esperar: entrega al menos una vez
+        long consumidos = a->total_consumidos;
+        int  ocupados   = buffer_ocupados(a);
+        int  fin_replay = replay.agotado && ocupados == 0;  // Se empacó lo último de la traza
+        SONDA(retiro, sonda_tid, espacio, ocupados);
+
+        log_evento(ROL_EMPACADOR, id, ACCION_TOMA,
+                   &p, ocupados);
+
+        pthread_mutex_unlock(&a->mutex);
+        // ===== FIN SECCIÓN CRÍTICA =====
+        SONDA(mutex_liberado, sonda_tid, espacio, ocupados);
+        t = ahora_ns();
+        contador_sumar(&tm->ns_sc, t - t_sc);
+        traza_registrar(tr, SPAN_SC, t_sc, t);
+        estado_publicar(st, ESTADO_TRABAJANDO);
+
+        contador_sumar(&st->items, 1);
+        hist_registrar(&st->latencia, t_sc - p.t_escaneo_ns);
+        hist_registrar(&st->latencia_llegada, t_sc - p.t_llegada_ns);
+        if (ctx->latencia_clase) hist_registrar(&ctx->latencia_clase[p.prioridad], t_sc - p.t_escaneo_ns);
+
+        log_evento(ROL_EMPACADOR, id, ACCION_SALE_SC,
+                   &p, ocupados);
+
+        // SIGNAL en sem_empty: indica que hay un espacio libre
+        sem_signal_manual(&a->sem_empty);
+
+        // Corridas por cantidad de productos: el que empaca el último avisa
+        if (cfg.max_items > 0 && consumidos >= cfg.max_items) detener_simulacion();
+        if (fin_replay) detener_simulacion();
+
+        // Simula tiempo de empacado (400-1600 ms por defecto)
+        t = ahora_ns();
+        simular_trabajo(&cfg.empaque);
+        uint64_t t_fin_servicio = ahora_ns();
+        contador_sumar(&tm->ns_servicio, t_fin_servicio - t);
+        traza_registrar(tr, SPAN_SERVICIO, t, t_fin_servicio);
+
+        // Con --etapa el producto empacado sigue a la primera etapa
+        if (pipeline.num > 0) pipeline_entregar(&p, st);
+    }
+
+    tm->ns_total = ahora_ns() - t_inicio;
+    estado_publicar(st, ESTADO_TRABAJANDO);
+    BufferLogTexto *lb = ctx->logtxt;
+    if (lb) {
+        log_texto_agregar(lb, "[FIN] Empacador  #%d termino.\n", id);
+        log_texto_vaciar(lb);
+    } else if (cfg.log_nivel >= LOG_RESUMEN) {
+        printf("[FIN] Empacador  #%d termino.\n", id);
+    }
+    return NULL;
+}
+
+/* -------------------- HILO: REPORTERO EN VIVO -------------------- */
+/**
+ * Suma los contadores de un grupo de hilos sin tomar 'mutex'
+ *
+ * Parámetros:
+ *   c:          Contextos de los hilos del grupo
+ *   n:          Número de hilos
+ *   esperando:  Arreglo indexado por EstadoHilo donde se cuentan los hilos
+ *
+ * Retorna:
+ *   Suma de 'items' del grupo
+ */
+static uint64_t sumar_contadores(const ContextoHilo *c, int n, int *esperando)
+{
+    uint64_t suma = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+        suma += contador_leer(&c[i].estad.items);
+        esperando[__atomic_load_n(&c[i].estad.estado, __ATOMIC_RELAXED)]++;
+    }
+    return suma;
+}
+
+/**
+ * Función ejecutada por el hilo reportero (opcional, --reporte MS)
+ *
+ * Cada cfg.reporte_ms imprime en stderr una línea con el total y la tasa
+ * de productos escaneados y empacados, la ocupación del área y cuántos
+ * hilos están bloqueados en cada primitiva.
+ *
+ * Solo lee los contadores por hilo con cargas relajadas: nunca toma
+ * 'mutex' ni los semáforos, así que no interfiere con los trabajadores.
+ * La ocupación se deriva de los contadores y puede estar desfasada por
+ * uno o dos productos respecto al buffer real.
+ */
+void *reportero(void *arg)
+{
+    (void)arg;
+    uint64_t t_inicio = ahora_ns(), t_previo = t_inicio;
+    uint64_t prod_previo = 0, cons_previo = 0;
+    struct timespec limite;
+    clock_gettime(CLOCK_MONOTONIC, &limite);
+
+    pthread_mutex_lock(&mtx_fin);
+    while (area->activa) {
+        limite.tv_nsec += (long)(cfg.reporte_ms % 1000) * 1000000L;
+        limite.tv_sec  += cfg.reporte_ms / 1000 + limite.tv_nsec / 1000000000L;
+        limite.tv_nsec %= 1000000000L;
+        while (area->activa &&
+               pthread_cond_timedwait(&cond_fin, &mtx_fin, &limite) != ETIMEDOUT) ;
+        if (!area->activa) break;
+        pthread_mutex_unlock(&mtx_fin);
+
+        int esp_caj[ESTADO_EN_SC + 1] = { 0 }, esp_emp[ESTADO_EN_SC + 1] = { 0 };
+        uint64_t prod = sumar_contadores(ctx_cajeros,     cfg.num_cajeros,     esp_caj);
+        uint64_t cons = sumar_contadores(ctx_empacadores, cfg.num_empacadores, esp_emp);
+        uint64_t t    = ahora_ns();
+        double   dt   = (double)(t - t_previo) / 1e9;
+        long     ocupados = (long)prod - (long)cons;
+        if (ocupados < 0)             ocupados = 0;
+        if (ocupados > cfg.capacidad) ocupados = cfg.capacidad;
+
+        fprintf(stderr, "[STATS] t=%6.1fs | escaneados %8lu (%7.1f/s) | empacados %8lu (%7.1f/s) "
+                        "| buffer %ld/%d | esperando: sem_empty %d, sem_full %d, mutex %d\n",
+                (double)(t - t_inicio) / 1e9,
+                (unsigned long)prod, (double)(prod - prod_previo) / dt,
+                (unsigned long)cons, (double)(cons - cons_previo) / dt,
+                ocupados, cfg.capacidad,
+                esp_caj[ESTADO_ESPERA_SEM], esp_emp[ESTADO_ESPERA_SEM],
+                esp_caj[ESTADO_ESPERA_MUTEX] + esp_emp[ESTADO_ESPERA_MUTEX]);
+
+        t_previo = t; prod_previo = prod; cons_previo = cons;
+        pthread_mutex_lock(&mtx_fin);
+    }
+    pthread_mutex_unlock(&mtx_fin);
+    return NULL;
+}
+
+/* -------------------- HILO: SERVIDOR DE MÉTRICAS -------------------- */
+// Límites (segundos) de los buckets del histograma exportado
+static const double limites_metricas[] = {
+    1e-6, 1e-5, 1e-4, 1e-3, 5e-3, 1e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+};
+#define NUM_LIMITES_METRICAS (int)(sizeof(limites_metricas)/sizeof(limites_metricas[0]))
+
+/**
+ * Suma un campo uint64_t de las estadísticas de un grupo de hilos
+ *
+ * Parámetros:
+ *   c:      Contextos de los hilos del grupo
+ *   n:      Número de hilos
+ *   offset: offsetof(EstadisticasHilo, campo)
+ */
+static uint64_t sumar_campo(const ContextoHilo *c, int n, size_t offset)
+{
+    uint64_t suma = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        suma += contador_leer((const uint64_t *)((const char *)&c[i].estad + offset));
+    return suma;
+}
+
+/**
+ * Escribe una métrica con su encabezado HELP/TYPE
+ */
+static void metrica(FILE *f, const char *nombre, const char *tipo, const char *ayuda, double valor)
+{
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", nombre, ayuda, nombre, tipo, nombre, valor);
+}
+
+/**
+ * Escribe una métrica etiquetada por semáforo (empty para cajeros, full para empacadores)
+ */
+static void metrica_semaforos(FILE *f, const char *nombre, const char *ayuda,
+                              size_t offset, double escala)
+{
+    fprintf(f, "# HELP %s %s\n# TYPE %s counter\n", nombre, ayuda, nombre);
+    fprintf(f, "%s{semaforo=\"empty\"} %.9g\n", nombre,
+            (double)sumar_campo(ctx_cajeros, cfg.num_cajeros, offset) * escala);
+    fprintf(f, "%s{semaforo=\"full\"} %.9g\n", nombre,
+            (double)sumar_campo(ctx_empacadores, cfg.num_empacadores, offset) * escala);
+}
+
+/**
+ * Genera la exposición en formato de texto de Prometheus
+ *
+ * Solo lee contadores por hilo con cargas relajadas; los valores de
+ * distintos hilos pueden corresponder a instantes ligeramente distintos.
+ */
+static void escribir_metricas(FILE *f)
+{
+    int i, j;
+    int esp_caj[ESTADO_EN_SC + 1] = { 0 }, esp_emp[ESTADO_EN_SC + 1] = { 0 };
+    uint64_t prod = sumar_contadores(ctx_cajeros,     cfg.num_cajeros,     esp_caj);
+    uint64_t cons = sumar_contadores(ctx_empacadores, cfg.num_empacadores, esp_emp);
+    long ocupados = (long)prod - (long)cons;
+    if (ocupados < 0)             ocupados = 0;
+    if (ocupados > cfg.capacidad) ocupados = cfg.capacidad;
+
+    metrica(f, "supermercado_productos_escaneados_total", "counter",
+            "Productos colocados en el area de empaque por los cajeros.", (double)prod);
+    metrica(f, "supermercado_productos_empacados_total", "counter",
+            "Productos tomados del area de empaque por los empacadores.", (double)cons);
+    metrica(f, "supermercado_area_empaque_ocupacion", "gauge",
+            "Espacios ocupados del area de empaque (derivado de los contadores).", (double)ocupados);
+    metrica(f, "supermercado_area_empaque_capacidad", "gauge",
+            "Espacios totales del area de empaque.", (double)cfg.capacidad);
+
+    metrica_semaforos(f, "supermercado_semaforo_esperas_total",
+                      "Llamadas a sem_wait por semaforo.",
+                      offsetof(EstadisticasHilo, esperas_sem), 1.0);
+    metrica_semaforos(f, "supermercado_semaforo_esperas_bloqueadas_total",
+                      "Llamadas a sem_wait que tuvieron que bloquearse.",
+                      offsetof(EstadisticasHilo, esperas_bloqueadas), 1.0);
+    metrica_semaforos(f, "supermercado_semaforo_espera_segundos_total",
+                      "Tiempo total bloqueado en sem_wait.",
+                      offsetof(EstadisticasHilo, tiempos.ns_espera_sem), 1e-9);
+
+    size_t off_cont = offsetof(EstadisticasHilo, contencion_mutex);
+    size_t off_esp  = offsetof(EstadisticasHilo, tiempos.ns_espera_mutex);
+    size_t off_sc   = offsetof(EstadisticasHilo, tiempos.ns_sc);
+    metrica(f, "supermercado_mutex_adquisiciones_total", "counter",
+            "Adquisiciones del mutex del area de empaque.", (double)(prod + cons));
+    metrica(f, "supermercado_mutex_contencion_total", "counter",
+            "Adquisiciones del mutex que lo encontraron tomado.",
+            (double)(sumar_campo(ctx_cajeros, cfg.num_cajeros, off_cont) +
+                     sumar_campo(ctx_empacadores, cfg.num_empacadores, off_cont)));
+    metrica(f, "supermercado_mutex_espera_segundos_total", "counter",
+            "Tiempo total esperando el mutex.",
+            (double)(sumar_campo(ctx_cajeros, cfg.num_cajeros, off_esp) +
+                     sumar_campo(ctx_empacadores, cfg.num_empacadores, off_esp)) * 1e-9);
+    metrica(f, "supermercado_mutex_retenido_segundos_total", "counter",
+            "Tiempo total dentro de la seccion critica.",
+            (double)(sumar_campo(ctx_cajeros, cfg.num_cajeros, off_sc) +
+                     sumar_campo(ctx_empacadores, cfg.num_empacadores, off_sc)) * 1e-9);
+
+    fprintf(f, "# HELP supermercado_hilos_esperando Hilos bloqueados en cada primitiva.\n"
+               "# TYPE supermercado_hilos_esperando gauge\n");
+    fprintf(f, "supermercado_hilos_esperando{primitiva=\"sem_empty\"} %d\n", esp_caj[ESTADO_ESPERA_SEM]);
+    fprintf(f, "supermercado_hilos_esperando{primitiva=\"sem_full\"} %d\n",  esp_emp[ESTADO_ESPERA_SEM]);
+    fprintf(f, "supermercado_hilos_esperando{primitiva=\"mutex\"} %d\n",
+            esp_caj[ESTADO_ESPERA_MUTEX] + esp_emp[ESTADO_ESPERA_MUTEX]);
+
+    // Histograma: combina los de los empacadores y acumula hasta cada límite
+    Histograma h;
+    memset(&h, 0, sizeof(h));
+    for (i = 0; i < cfg.num_empacadores; i++) {
+        for (j = 0; j < HIST_BUCKETS; j++) h.cuenta[j] += contador_leer(&ctx_empacadores[i].estad.latencia.cuenta[j]);
+        h.suma += contador_leer(&ctx_empacadores[i].estad.latencia.suma);
+    }
+    fprintf(f, "# HELP supermercado_espera_area_segundos Tiempo de cada producto en el area de empaque.\n"
+               "# TYPE supermercado_espera_area_segundos histogram\n");
+    uint64_t acumulado = 0;
+    for (i = 0, j = 0; i < NUM_LIMITES_METRICAS; i++) {
+        for (; j < HIST_BUCKETS && (double)hist_limite(j) <= limites_metricas[i] * 1e9; j++)
+            acumulado += h.cuenta[j];
+        fprintf(f, "supermercado_espera_area_segundos_bucket{le=\"%g\"} %lu\n",
+                limites_metricas[i], (unsigned long)acumulado);
+    }
+    for (; j < HIST_BUCKETS; j++) acumulado += h.cuenta[j];
+    fprintf(f, "supermercado_espera_area_segundos_bucket{le=\"+Inf\"} %lu\n", (unsigned long)acumulado);
+    fprintf(f, "supermercado_espera_area_segundos_sum %.9g\n", (double)h.suma * 1e-9);
+    fprintf(f, "supermercado_espera_area_segundos_count %lu\n", (unsigned long)acumulado);
+}
+
+/**
+ * Atiende una conexión al socket de métricas
+ *
+ * Si el cliente envía una petición HTTP (ej: Prometheus) responde con
+ * encabezados HTTP/1.0; si no envía nada (ej: socat) escribe solo el
+ * texto. En ambos casos cierra la conexión al terminar.
+ */
+static void atender_metricas(int cliente)
+{
+    char   peticion[512];
+    char  *cuerpo = NULL;
+    size_t largo  = 0;
+    ssize_t leidos = 0;
+    struct pollfd pfd = { cliente, POLLIN, 0 };
+
+    if (poll(&pfd, 1, 50) > 0) leidos = recv(cliente, peticion, sizeof(peticion), 0);
+
+    FILE *f = open_memstream(&cuerpo, &largo);
+    if (!f) return;
+    escribir_metricas(f);
+    fclose(f);
+
+    if (leidos >= 4 && memcmp(peticion, "GET ", 4) == 0) {
+        char encabezado[160];
+        int n = snprintf(encabezado, sizeof(encabezado),
+                         "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: %zu\r\n\r\n", largo);
+        send(cliente, encabezado, (size_t)n, MSG_NOSIGNAL);
+    }
+    size_t enviado = 0;
+    while (enviado < largo) {
+        ssize_t w = send(cliente, cuerpo + enviado, largo - enviado, MSG_NOSIGNAL);
+        if (w <= 0) break;
+        enviado += (size_t)w;
+    }
+    free(cuerpo);
+}
+
+/**
+ * Función ejecutada por el hilo servidor de métricas (opcional, --metricas RUTA)
+ *
+ * Escucha en un socket Unix y responde cada conexión con la exposición
+ * de texto de Prometheus. Revisa area->activa cada 200 ms para
+ * cerrar el socket al terminar la corrida. Se puede probar con:
+ *   socat - UNIX-CONNECT:RUTA
+ */
+void *servidor_metricas(void *arg)
+{
+    int servidor = *((int *)arg);
+    while (area->activa) {
+        struct pollfd pfd = { servidor, POLLIN, 0 };
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int cliente = accept(servidor, NULL, NULL);
+        if (cliente < 0) continue;
+        atender_metricas(cliente);
+        close(cliente);
+    }
+    return NULL;
+}
+
+/**
+ * Crea el socket Unix del servidor de métricas
+ *
+ * Retorna:
+ *   Descriptor del socket en escucha, o -1 si no se pudo crear
+ */
+static int abrir_socket_metricas(const char *ruta)
+{
+    struct sockaddr_un dir;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    if (strlen(ruta) >= sizeof(dir.sun_path)) { close(fd); errno = ENAMETOOLONG; return -1; }
+    strcpy(dir.sun_path, ruta);
+    unlink(ruta);  // Elimina un socket de una corrida anterior
+
+    if (bind(fd, (struct sockaddr *)&dir, sizeof(dir)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* -------------------- AFINIDAD Y TOPOLOGÍA -------------------- */
+/**
+ * CPU permitida al proceso y su ubicación según /sys/devices/system
+ */
+typedef struct {
+    int cpu;
+    int nodo;
+    int socket;
+    int nucleo;
+} CpuTopologia;
+
+/**
+ * Ubicación de los hilos y la memoria de un carril
+ *
+ * cajeros / empacadores: CPUs donde pueden correr los hilos del carril
+ * nodo:                  Nodo NUMA donde se reserva su área (-1 = cualquiera)
+ */
+typedef struct {
+    cpu_set_t cajeros;
+    cpu_set_t empacadores;
+    int       nodo;
+} UbicacionCarril;
+
+CpuTopologia    *topologia     = NULL;  // CPUs permitidas, ordenadas por nodo, socket y núcleo
+int              num_cpus      = 0;
+UbicacionCarril *ubicaciones   = NULL;  // Una por carril (NULL = sin afinidad)
+
+/**
+ * Lee un entero de un archivo de /sys (-1 si no existe)
+ */
+static int leer_entero_sys(const char *ruta)
+{
+    FILE *f = fopen(ruta, "r");
+    int   v = -1;
+    if (f) {
+        if (fscanf(f, "%d", &v) != 1) v = -1;
+        fclose(f);
+    }
+    return v;
+}
+
+static int comparar_cpus(const void *a, const void *b)
+{
+    const CpuTopologia *x = a, *y = b;
+    if (x->nodo   != y->nodo)   return x->nodo   - y->nodo;
+    if (x->socket != y->socket) return x->socket - y->socket;
+    if (x->nucleo != y->nucleo) return x->nucleo - y->nucleo;
+    return x->cpu - y->cpu;
+}
+
+/**
+ * Lee la topología de las CPUs que el proceso tiene permitidas
+ *
+ * Ordenarlas por nodo, socket y núcleo deja juntos a los hermanos SMT
+ * y, después, a los núcleos vecinos del mismo socket.
+ *
+ * Retorna:
+ *   0 si se leyó al menos una CPU, -1 en caso contrario
+ */
+int topologia_leer(void)
+{
+    cpu_set_t permitidas;
+    char      ruta[128];
+    int       cpu;
+
+    if (topologia) return 0;
+    if (sched_getaffinity(0, sizeof(permitidas), &permitidas) != 0) return -1;
+    topologia = calloc((size_t)CPU_COUNT(&permitidas), sizeof(CpuTopologia));
+    if (!topologia) return -1;
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &permitidas)) continue;
+        CpuTopologia *t = &topologia[num_cpus++];
+        t->cpu = cpu;
+        snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        t->socket = leer_entero_sys(ruta);
+        snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        t->nucleo = leer_entero_sys(ruta);
+
+        // El nodo aparece como un enlace nodeN dentro del directorio de la CPU
+        t->nodo = 0;
+        snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR *dir = opendir(ruta);
+        struct dirent *e;
+        while (dir && (e = readdir(dir)) != NULL) {
+            if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+                t->nodo = atoi(e->d_name + 4);
+                break;
+            }
+        }
+        if (dir) closedir(dir);
+    }
+    qsort(topologia, (size_t)num_cpus, sizeof(CpuTopologia), comparar_cpus);
+    return num_cpus > 0 ? 0 : -1;
+}
+
+/**
+ * Calcula dónde corre y dónde reserva memoria cada carril
+ *
+ * AFINIDAD_PARES:   Los cajeros del carril k en la CPU 2k y sus empacadores
+ *                   en la 2k+1 del orden de topología (hermanos SMT o
+ *                   núcleos vecinos), así el área solo viaja entre ellos
+ * AFINIDAD_SOCKETS: Carril k en todas las CPUs del socket k mod sockets
+ * AFINIDAD_NODOS:   Carril k en todas las CPUs del nodo k mod nodos
+ *
+ * Retorna:
+ *   0 si hay ubicación (o no se pidió), -1 si no se pudo leer la topología
+ */
+int ubicar_carriles(void)
+{
+    free(ubicaciones);
+    ubicaciones = NULL;
+    if (cfg.afinidad == AFINIDAD_NINGUNA) return 0;
+    if (topologia_leer() != 0) return -1;
+
+    ubicaciones = calloc((size_t)num_carriles, sizeof(UbicacionCarril));
+    if (!ubicaciones) return -1;
+
+    // Distintos sockets o nodos, en el orden en que aparecen
+    int grupos[CPU_SETSIZE], num_grupos = 0, i, k;
+    for (i = 0; i < num_cpus; i++) {
+        int g = cfg.afinidad == AFINIDAD_SOCKETS ? topologia[i].socket : topologia[i].nodo;
+        if (num_grupos == 0 || grupos[num_grupos - 1] != g) grupos[num_grupos++] = g;
+    }
+
+    for (k = 0; k < num_carriles; k++) {
+        UbicacionCarril *u = &ubicaciones[k];
+        CPU_ZERO(&u->cajeros);
+        CPU_ZERO(&u->empacadores);
+        if (cfg.afinidad == AFINIDAD_PARES) {
+            const CpuTopologia *c = &topologia[(2 * k)     % num_cpus];
+            const CpuTopologia *e = &topologia[(2 * k + 1) % num_cpus];
+            CPU_SET(c->cpu, &u->cajeros);
+            CPU_SET(e->cpu, &u->empacadores);
+            u->nodo = c->nodo;
+            continue;
+        }
+        int g = grupos[k % num_grupos];
+        u->nodo = -1;
+        for (i = 0; i < num_cpus; i++) {
+            int de = cfg.afinidad == AFINIDAD_SOCKETS ? topologia[i].socket : topologia[i].nodo;
+            if (de != g) continue;
+            CPU_SET(topologia[i].cpu, &u->cajeros);
+            CPU_SET(topologia[i].cpu, &u->empacadores);
+            if (u->nodo < 0) u->nodo = topologia[i].nodo;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Prefiere el nodo 'nodo' para las páginas de [dir, dir + largo)
+ *
+ * Se llama antes de tocar la memoria, para que la primera escritura ya
+ * reserve las páginas en ese nodo. Sin soporte NUMA el kernel falla y
+ * la memoria queda con la política por defecto.
+ */
+static void memoria_en_nodo(void *dir, size_t largo, int nodo)
+{
+    unsigned long mascara[16] = { 0 };
+    if (nodo < 0 || nodo >= (int)(sizeof(mascara) * 8)) return;
+    mascara[nodo / (8 * sizeof(unsigned long))] |= 1ul << (nodo % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, dir, largo, MPOL_PREFERRED, mascara, sizeof(mascara) * 8 + 1, 0);
+}
+
+/**
+ * Atributos de creación de un hilo del carril 'carril' (con su afinidad)
+ */
+static void atributos_hilo(pthread_attr_t *attr, int carril, RolHilo rol)
+{
+    pthread_attr_init(attr);
+    if (!ubicaciones) return;
+    const UbicacionCarril *u = &ubicaciones[carril];
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), rol == ROL_CAJERO ? &u->cajeros : &u->empacadores);
+}
+
+/* -------------------- ÁREA DE EMPAQUE COMPARTIDA -------------------- */
+/**
+ * Cómo se obtuvo la memoria de las áreas de la corrida (para el reporte)
+ *
+ * paginas:    Tipo de páginas que se consiguió
+ * ns_reserva: Tiempo de reservar, prefaultear y bloquear todas las áreas
+ * bloqueada:  1 si se pidió --mlock y tuvo éxito en todas las áreas
+ */
+typedef struct {
+    const char *paginas;
+    uint64_t    ns_reserva;
+    int         bloqueada;
+} MemoriaAreas;
+
+MemoriaAreas memoria_areas;
+
+/**
+ * Reserva memoria anónima para un área según cfg.paginas
+ *
+ * Parámetros:
+ *   tam: Bytes pedidos; se redondea a 2 MB con páginas enormes
+ *
+ * Con PAGINAS_ENORMES intenta primero MAP_HUGETLB, que necesita páginas
+ * reservadas en /proc/sys/vm/nr_hugepages; si no hay, reserva un bloque
+ * alineado a 2 MB y lo marca con MADV_HUGEPAGE para que el kernel lo
+ * respalde con páginas enormes transparentes.
+ *
+ * Retorna:
+ *   La memoria (en cero), o NULL en caso de error
+ */
+static void *memoria_reservar(size_t *tam)
+{
+    if (cfg.paginas == PAGINAS_NORMALES) {
+        void *dir = mmap(NULL, *tam, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        memoria_areas.paginas = "normales";
+        return dir == MAP_FAILED ? NULL : dir;
+    }
+
+    size_t redondeado = (*tam + TAM_PAGINA_ENORME - 1) & ~(size_t)(TAM_PAGINA_ENORME - 1);
+    void  *dir = mmap(NULL, redondeado, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (dir != MAP_FAILED) {
+        *tam = redondeado;
+        memoria_areas.paginas = "hugetlb 2 MB";
+        return dir;
+    }
+
+    // THP: reserva 2 MB de más y recorta para quedar alineado
+    size_t extra = redondeado + TAM_PAGINA_ENORME;
+    char  *base  = mmap(NULL, extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    char *alineado = (char *)(((uintptr_t)base + TAM_PAGINA_ENORME - 1) & ~(uintptr_t)(TAM_PAGINA_ENORME - 1));
+    if (alineado > base) munmap(base, (size_t)(alineado - base));
+    munmap(alineado + redondeado, (size_t)(base + extra - (alineado + redondeado)));
+    madvise(alineado, redondeado, MADV_HUGEPAGE);
+    *tam = redondeado;
+    memoria_areas.paginas = "THP (madvise)";
+    return alineado;
+}
+
+/**
+ * Prefaultea y, con --mlock, bloquea en RAM la memoria de un área
+ *
+ * Parámetros:
+ *   dir, tam: Memoria del área
+ *   nueva:    1 si aún no tiene datos (se puede escribir para prefaultear);
+ *             0 si es un área compartida que otro proceso ya usa
+ *
+ * Así los fallos de página y de TLB ocurren aquí y no durante la primera
+ * vuelta al buffer circular.
+ */
+static void memoria_preparar(void *dir, size_t tam, int nueva)
+{
+    if (cfg.prefault && madvise(dir, tam, nueva ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) != 0) {
+        // Kernels anteriores a 5.14: toca cada página
+        volatile char *p      = dir;
+        size_t         pagina = (size_t)sysconf(_SC_PAGESIZE);
+        for (size_t i = 0; i < tam; i += pagina) {
+            if (nueva) p[i] = 0;
+            else       (void)p[i];
+        }
+    }
+    if (cfg.mlock && mlock(dir, tam) != 0) {
+        if (memoria_areas.bloqueada) perror("Aviso: mlock");
+        memoria_areas.bloqueada = 0;
+    }
+}
+
+/**
+ * Bytes de un área con 'capacidad' espacios en cada una de sus clases
+ */
+static inline size_t area_tamano(int capacidad, int prioridades)
+{
+    return sizeof(AreaEmpaque) + (size_t)capacidad * (size_t)prioridades * sizeof(Producto);
+}
+
+/**
+ * Inicializa el estado y las primitivas de un área recién reservada
+ *
+ * Parámetros:
+ *   a:          Área con espacio para 'capacidad' productos por clase
+ *   capacidad:  Espacios del área (compartidos por todas las clases)
+ *   compartida: 1 si vive en un segmento compartido entre procesos
+ */
+static void area_inicializar(AreaEmpaque *a, int capacidad, int compartida)
+{
+    a->capacidad          = capacidad;
+    a->procesos           = 1;
+    a->prioridades        = cfg.prioridades;
+    a->envejecimiento_ns  = (uint64_t)cfg.envejecimiento_ms * 1000000ull;
+    memset(a->anillos, 0, sizeof(a->anillos));
+    a->total_producidos   = a->total_consumidos = a->total_sobrescritos = 0;
+    a->total_promovidos   = 0;
+    a->politica           = cfg.lleno;
+    a->espera_max_ns      = (uint64_t)cfg.lleno_timeout_ms * 1000000ull;
+    a->ocupacion_integral = 0;
+    a->t_creacion_ns      = ahora_ns();
+    a->t_ultimo_cambio_ns = a->t_creacion_ns;
+    a->activa             = 1;
+
+    // sem_empty: inicializa con la capacidad (todos los espacios vacíos)
+    sem_inicializar(&a->sem_empty, capacidad, cfg.backend, compartida);
+    // sem_full: inicializa con 0 (ningún producto disponible)
+    sem_inicializar(&a->sem_full,  0, cfg.backend, compartida);
+    // mutex: para proteger acceso al buffer compartido
+    mutex_inicializar(&a->mutex, compartida);
+
+    // Publica el área ya inicializada a los procesos que esperan conectarse
+    __atomic_store_n(&a->magia, AREA_MAGIA, __ATOMIC_RELEASE);
+}
+
+/**
+ * Conecta con el área del segmento compartido 'nombre' o la crea
+ *
+ * El primer proceso la crea (O_EXCL) con cfg.capacidad y cfg.backend;
+ * los siguientes esperan a que el creador publique AREA_MAGIA y adoptan
+ * la capacidad y las clases de prioridad del área. Un área con la simulación ya detenida quedó de
+ * una corrida anterior (por ejemplo, si murió un proceso y el contador
+ * de procesos no llegó a 0): se elimina y se crea una nueva. Quien aún
+ * la tenga mapeada la conserva hasta desmapearla.
+ *
+ * Retorna:
+ *   El área mapeada, o NULL en caso de error (errno indica la causa)
+ */
+static AreaEmpaque *area_conectar(const char *nombre)
+{
+    size_t tam = area_tamano(cfg.capacidad, cfg.prioridades);
+    int    fd  = shm_open(nombre, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    // ===== CREADOR =====
+    if (fd >= 0) {
+        AreaEmpaque *a = MAP_FAILED;
+        if (ftruncate(fd, (off_t)tam) == 0) {
+            a = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (a == MAP_FAILED) { shm_unlink(nombre); return NULL; }
+        if (cfg.paginas == PAGINAS_ENORMES) madvise(a, tam, MADV_HUGEPAGE);  // Según shmem_enabled
+        memoria_preparar(a, tam, 1);
+        area_inicializar(a, cfg.capacidad, 1);
+        tam_area = tam;
+        return a;
+    }
+    if (errno != EEXIST) return NULL;
+
+    // ===== PROCESO QUE SE CONECTA =====
+    fd = shm_open(nombre, O_RDWR, 0);
+    if (fd < 0) return NULL;
+
+    // Espera hasta 5 s a que el creador dimensione e inicialice el área
+    AreaEmpaque *a = MAP_FAILED;
+    struct stat  info;
+    for (int intento = 0; intento < 500; intento++) {
+        if (a == MAP_FAILED && fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(AreaEmpaque)) {
+            a = mmap(NULL, sizeof(AreaEmpaque), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (a == MAP_FAILED) break;
+        }
+        if (a != MAP_FAILED && __atomic_load_n(&a->magia, __ATOMIC_ACQUIRE) == AREA_MAGIA) break;
+        usleep(10000);
+    }
+    if (a == MAP_FAILED || a->magia != AREA_MAGIA || !a->activa) {
+        int error = a != MAP_FAILED && a->magia == AREA_MAGIA ? ESTALE : ETIMEDOUT;
+        if (a != MAP_FAILED) munmap(a, sizeof(AreaEmpaque));
+        close(fd);
+        if (error == ESTALE && shm_unlink(nombre) == 0) return area_conectar(nombre);
+        errno = error;
+        return NULL;
+    }
+
+    // Vuelve a mapear con el tamaño real, que depende de la capacidad del creador
+    if (cfg.capacidad != a->capacidad) {
+        fprintf(stderr, "Aviso: %s ya existe con capacidad %d; se usa esa capacidad\n", nombre, a->capacidad);
+        cfg.capacidad = a->capacidad;
+    }
+    if (cfg.prioridades != a->prioridades) {
+        fprintf(stderr, "Aviso: %s ya existe con %d clases de prioridad; se usan esas clases\n", nombre, a->prioridades);
+        cfg.prioridades = a->prioridades;
+    }
+    munmap(a, sizeof(AreaEmpaque));
+    tam = area_tamano(cfg.capacidad, cfg.prioridades);
+    a   = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (a == MAP_FAILED) return NULL;
+    memoria_preparar(a, tam, 0);
+
+    __atomic_add_fetch(&a->procesos, 1, __ATOMIC_ACQ_REL);
+    tam_area = tam;
+    return a;
+}
+
+/**
+ * Reserva las áreas de la corrida en memoria propia o en --shm
+ *
+ * Sin --shm cada carril tiene su propia área de cfg.capacidad espacios,
+ * reservada con mmap (páginas propias, enormes con --paginas enormes) y,
+ * si hay ubicación, en el nodo NUMA donde corren sus hilos. La
+ * preferencia de nodo se fija antes de prefaultear.
+ *
+ * Retorna:
+ *   0 si hay área, -1 en caso contrario
+ */
+int area_abrir(void)
+{
+    static AreaEmpaque *unica;
+    uint64_t t = ahora_ns();
+    memoria_areas.paginas   = cfg.ruta_shm ? "compartidas" : "normales";
+    memoria_areas.bloqueada = cfg.mlock;
+    if (cfg.ruta_shm) {
+        area = unica = area_conectar(cfg.ruta_shm);
+        carriles     = &unica;
+        num_carriles = 1;
+        memoria_areas.ns_reserva = ahora_ns() - t;
+        return area ? 0 : -1;
+    }
+    carriles = calloc((size_t)num_carriles, sizeof(AreaEmpaque *));
+    if (!carriles) return -1;
+    for (int k = 0; k < num_carriles; k++) {
+        tam_area = area_tamano(cfg.capacidad, cfg.prioridades);
+        void *a  = memoria_reservar(&tam_area);
+        if (!a) {
+            while (k-- > 0) munmap(carriles[k], tam_area);
+            free(carriles);
+            carriles = NULL;
+            return -1;
+        }
+        if (ubicaciones) memoria_en_nodo(a, tam_area, ubicaciones[k].nodo);
+        memoria_preparar(a, tam_area, 1);
+        carriles[k] = a;
+        area_inicializar(carriles[k], cfg.capacidad, 0);
+    }
+    area = carriles[0];
+    memoria_areas.ns_reserva = ahora_ns() - t;
+    return 0;
+}
+
+/**
+ * Libera el área de la corrida
+ *
+ * En memoria compartida solo el último proceso conectado destruye las
+ * primitivas y elimina el segmento; los demás solo lo desmapean.
+ */
+void area_cerrar(void)
+{
+    if (!area) return;
+    int ultimo = !cfg.ruta_shm || __atomic_sub_fetch(&area->procesos, 1, __ATOMIC_ACQ_REL) == 0;
+    for (int k = 0; k < num_carriles; k++) {
+        AreaEmpaque *a = carriles[k];
+        if (ultimo) {
+            // Destruye las primitivas de sincronización para liberar recursos
+            sem_destruir(&a->sem_empty);
+            sem_destruir(&a->sem_full);
+            pthread_mutex_destroy(&a->mutex);
+        }
+        munmap(a, tam_area);
+    }
+    if (cfg.ruta_shm && ultimo) shm_unlink(cfg.ruta_shm);
+    if (!cfg.ruta_shm) free(carriles);
+    carriles = NULL;
+    area     = NULL;
+}
+
+/* -------------------- CORRIDA -------------------- */
+/**
+ * Resultados de una etapa del pipeline (las dos primeras son el escaneo
+ * de los cajeros y el empacado)
+ *
+ * nombre / hilos:  Etapa y trabajadores
+ * procesados:      Productos que terminó la etapa
+ * capacidad:       Espacios de su cola de entrada (0 = no tiene, escaneo)
+ * ocupacion_media: Ocupación promedio de su cola de entrada
+ * espera_p*_ms:    Espera de los productos en su cola de entrada
+ * utilizacion_pct: Porcentaje del tiempo de sus hilos en el trabajo simulado
+ * bloqueo_pct:     Porcentaje esperando espacio en la cola siguiente
+ */
+typedef struct {
+    const char *nombre;
+    int         hilos;
+    uint64_t    procesados;
+    int         capacidad;
+    double      ocupacion_media;
+    double      espera_p50_ms;
+    double      espera_p99_ms;
+    double      utilizacion_pct;
+    double      bloqueo_pct;
+} ResultadoEtapa;
+
+/**
+ * Resultados agregados de una corrida
+ *
+ * segundos:                Duración efectiva (hasta que se detuvo la simulación)
+ * throughput:              Productos empacados por segundo
+ * lat_p50_ms / lat_p99_ms: Percentiles del tiempo de espera en el área de empaque
+ * ocupacion_media:         Ocupación promedio del área ponderada por tiempo
+ * bloqueo_*_pct:           Porcentaje del tiempo de los hilos bloqueados en semáforo/mutex
+ * tiempos_*:               Desglose de tiempos sumado sobre los hilos de cada rol
+ * eventos_*:               Eventos escritos y omitidos en el log de texto
+ * llegada_p*_ms:           Percentiles desde la llegada al cajero hasta que se toma
+ * llegadas / retrasados / descartados: Lazo abierto, sumado sobre los cajeros
+ * lleno_*:                 Productos perdidos, reemplazados, vencidos o
+ *                          rechazados con el área llena (ver --lleno)
+ * prioridades:             Clases de prioridad del área
+ * promovidos:              Productos tomados antes por envejecimiento
+ * clase_*:                 Productos empacados y percentiles de la espera
+ *                          en el área de cada clase (con --prioridades)
+ * num_etapas / etapas:     Escaneo, empacado y cada --etapa (0 sin --etapa)
+ * cuello_botella:          Índice en 'etapas' de la de mayor utilización
+ * pipeline_p*_ms:          Desde el escaneo hasta salir de la última etapa
+ * num_grupos / grupos:     Empacado y cada --grupo (0 sin --grupo); la
+ *                          espera va del escaneo a que el grupo lo toma
+ * grupo_lento:             Índice en 'grupos' del que menos procesó
+ * journal_*:               Registros escritos, fdatasync hechos, lote medio,
+ *                          espera media de durabilidad de los cajeros y
+ *                          productos recuperados al iniciar
+ * journal_cola:            Registros del journal repetidos al recuperar
+ * recuperacion_ms:         Duración de la recuperación (snapshot + cola)
+ * snapshot*:               Snapshots escritos, pausa media/máxima con 'mutex'
+ *                          tomado y bytes escritos en total
+ * carriles:                Carriles usados (cfg.carriles limitado por los hilos)
+ * consumidos_carril:       Productos empacados en cada carril
+ * paginas / reserva_ms / bloqueada: Memoria de las áreas (ver MemoriaAreas)
+ * fallos_pagina:           Fallos de página menores del proceso mientras
+ *                          corrían los hilos
+ * trabajadores:            Hilos que ejecutaron las corrutinas (0 = modo hilos)
+ * cambios_contexto:        Veces que un trabajador cambió a una corrutina
+ * bucle_esperas:           Llamadas a epoll_wait del bucle (modo epoll)
+ * bucle_avisos:            Avisos de eventfd de los semáforos atendidos
+ * rueda_eventos:           Plazos programados en la rueda de tiempos
+ * rueda_cascadas:          Plazos que bajaron de nivel en la rueda
+ * despertares_reloj:       Veces que despertó el hilo del reloj
+ */
+typedef struct {
+    double segundos;
+    long   producidos;
+    long   consumidos;
+    double throughput;
+    double lat_p50_ms;
+    double lat_p99_ms;
+    double ocupacion_media;
+    double      bloqueo_cajeros_pct;
+    double      bloqueo_empacadores_pct;
+    TiemposHilo tiempos_cajeros;
+    TiemposHilo tiempos_empacadores;
+    uint64_t    eventos_escritos;
+    uint64_t    eventos_descartados;
+    double      llegada_p50_ms;
+    double      llegada_p99_ms;
+    double      llegada_p999_ms;
+    uint64_t    llegadas;
+    uint64_t    retrasados;
+    uint64_t    descartados;
+    uint64_t    lleno_descartados;
+    uint64_t    lleno_sobrescritos;
+    uint64_t    lleno_expirados;
+    uint64_t    lleno_rechazados;
+    int         prioridades;
+    long        promovidos;
+    uint64_t    clase_empacados[MAX_PRIORIDADES];
+    double      clase_p50_ms[MAX_PRIORIDADES];
+    double      clase_p99_ms[MAX_PRIORIDADES];
+    int         num_etapas;
+    ResultadoEtapa etapas[MAX_ETAPAS + 2];
+    int         cuello_botella;
+    double      pipeline_p50_ms;
+    double      pipeline_p99_ms;
+    int         num_grupos;
+    ResultadoEtapa grupos[MAX_GRUPOS + 1];
+    int         grupo_lento;
+    uint64_t    journal_registros;
+    uint64_t    journal_fsyncs;
+    double      journal_lote_medio;
+    double      journal_fsync_ms;
+    double      journal_espera_ms;
+    int         journal_recuperados;
+    int         journal_error;
+    uint64_t    journal_cola;
+    double      recuperacion_ms;
+    int         snapshot_cargado;
+    uint64_t    snapshots;
+    double      snapshot_pausa_ms;
+    double      snapshot_pausa_max_ms;
+    uint64_t    snapshot_bytes;
+    int         carriles;
+    long        consumidos_carril[MAX_CARRILES];
+    const char *paginas;
+    double      reserva_ms;
+    int         bloqueada;
+    long        fallos_pagina;
+    int         trabajadores;
+    uint64_t    cambios_contexto;
+    uint64_t    bucle_esperas;
+    uint64_t    bucle_avisos;
+    uint64_t    rueda_eventos;
+    uint64_t    rueda_cascadas;
+    uint64_t    despertares_reloj;
+} ResultadoCorrida;
+
+/**
+ * Suma el desglose de tiempos de un grupo de hilos
+ */
+static TiemposHilo sumar_tiempos(const ContextoHilo *c, int n)
+{
+    TiemposHilo s;
+    int i;
+    memset(&s, 0, sizeof(s));
+    for (i = 0; i < n; i++) {
+        const TiemposHilo *t = &c[i].estad.tiempos;
+        s.ns_servicio     += t->ns_servicio;
+        s.ns_espera_sem   += t->ns_espera_sem;
+        s.ns_espera_mutex += t->ns_espera_mutex;
+        s.ns_sc           += t->ns_sc;
+        s.ns_total        += t->ns_total;
+    }
+    return s;
+}
+
+/**
+ * Porcentaje del tiempo de vida que pasaron bloqueados (semáforo + mutex)
+ */
+static double porcentaje_bloqueo(const TiemposHilo *t)
+{
+    return t->ns_total ? 100.0 * (double)(t->ns_espera_sem + t->ns_espera_mutex)
+                               / (double)t->ns_total : 0.0;
+}
+
+/**
+ * Imprime una fila de la tabla de utilización
+ *
+ * Parámetros:
+ *   etiqueta: Nombre del hilo o del rol
+ *   t:        Desglose de tiempos (de un hilo o sumado por rol)
+ *
+ * Cada columna es un porcentaje de ns_total; "Otro" es el resto.
+ */
+static void imprimir_fila_utilizacion(const char *etiqueta, const TiemposHilo *t)
+{
+    double total = t->ns_total ? (double)t->ns_total : 1.0;
+    uint64_t medido = t->ns_servicio + t->ns_espera_sem + t->ns_espera_mutex + t->ns_sc;
+    double otro = t->ns_total > medido ? (double)(t->ns_total - medido) : 0.0;
+    printf("  %-20s %8.1f%% %10.1f%% %12.1f%% %8.1f%% %7.1f%%\n", etiqueta,
+           100.0 * (double)t->ns_servicio     / total,
+           100.0 * (double)t->ns_espera_sem   / total,
+           100.0 * (double)t->ns_espera_mutex / total,
+           100.0 * (double)t->ns_sc           / total,
+           100.0 * otro / total);
+}
+
+/**
+ * Imprime la utilización de cada hilo y el total por rol
+ *
+ * "Espera Sem" es sem_empty para cajeros y sem_full para empacadores:
+ * cajeros esperando mucho en sem_empty indican que faltan empacadores,
+ * empacadores esperando en sem_full indican que faltan cajeros, y una
+ * espera de mutex alta indica contención en la sección crítica.
+ */
+void imprimir_utilizacion(const ResultadoCorrida *r)
+{
+    char etiqueta[32];
+    int i;
+    printf("  Utilización por Hilo (%% del tiempo de vida)\n");
+    printf("  %-20s %9s %11s %13s %9s %8s\n", "Hilo", "Servicio", "Espera Sem", "Espera Mutex", "En SC", "Otro");
+    if (cfg.num_cajeros + cfg.num_empacadores > MAX_FILAS_UTILIZACION) {
+        // Miles de corrutinas: el detalle por hilo no cabe en pantalla
+        printf("  (%d hilos: solo los totales por rol)\n", cfg.num_cajeros + cfg.num_empacadores);
+    } else {
+        for (i = 0; i < cfg.num_cajeros; i++) {
+            snprintf(etiqueta, sizeof(etiqueta), "CAJERO     #%d", i + 1);
+            imprimir_fila_utilizacion(etiqueta, &ctx_cajeros[i].estad.tiempos);
+        }
+        for (i = 0; i < cfg.num_empacadores; i++) {
+            snprintf(etiqueta, sizeof(etiqueta), "EMPACADOR  #%d", i + 1);
+            imprimir_fila_utilizacion(etiqueta, &ctx_empacadores[i].estad.tiempos);
+        }
+    }
+    imprimir_fila_utilizacion("Cajeros (total)",     &r->tiempos_cajeros);
+    imprimir_fila_utilizacion("Empacadores (total)", &r->tiempos_empacadores);
+}
+
+/**
+ * Libera las estadísticas por hilo de la última corrida
+ *
+ * ejecutar_simulacion() conserva la arena de contextos para que main pueda
+ * imprimir el detalle por hilo; la siguiente corrida la libera automáticamente.
+ */
+void liberar_estadisticas(void)
+{
+    contextos_liberar();
+}
+
+/**
+ * Llena las etapas del pipeline en 'res' y elige el cuello de botella
+ *
+ * Se llama después de calcular los resultados del área (producidos,
+ * consumidos, ocupación, espera y tiempos de los hilos).
+ */
+static void pipeline_resultados(ResultadoCorrida *res, uint64_t t_inicio, uint64_t t_fin)
+{
+    ResultadoEtapa *e;
+    Histograma      espera, total;
+    uint64_t        empacadores_entrega = 0;
+    int             i, k;
+
+    e = &res->etapas[0];
+    e->nombre          = "escanear";
+    e->hilos           = cfg.num_cajeros;
+    e->procesados      = (uint64_t)res->producidos;
+    e->utilizacion_pct = res->tiempos_cajeros.ns_total ?
+                         100.0 * (double)res->tiempos_cajeros.ns_servicio / (double)res->tiempos_cajeros.ns_total : 0.0;
+    e->bloqueo_pct     = res->tiempos_cajeros.ns_total ?
+                         100.0 * (double)res->tiempos_cajeros.ns_espera_sem / (double)res->tiempos_cajeros.ns_total : 0.0;
+
+    for (i = 0; i < cfg.num_empacadores; i++) empacadores_entrega += ctx_empacadores[i].estad.ns_entrega;
+    e = &res->etapas[1];
+    e->nombre          = "empacar";
+    e->hilos           = cfg.num_empacadores;
+    e->procesados      = (uint64_t)res->consumidos;
+    e->capacidad       = cfg.capacidad * res->carriles;
+    e->ocupacion_media = res->ocupacion_media;
+    e->espera_p50_ms   = res->lat_p50_ms;
+    e->espera_p99_ms   = res->lat_p99_ms;
+    e->utilizacion_pct = res->tiempos_empacadores.ns_total ?
+                         100.0 * (double)res->tiempos_empacadores.ns_servicio / (double)res->tiempos_empacadores.ns_total : 0.0;
+    e->bloqueo_pct     = res->tiempos_empacadores.ns_total ?
+                         100.0 * (double)empacadores_entrega / (double)res->tiempos_empacadores.ns_total : 0.0;
+
+    memset(&total, 0, sizeof(total));
+    for (k = 0; k < pipeline.num; k++) {
+        ColaIndices *q = &pipeline.entradas[k];
+        uint64_t     servicio = 0, bloqueo = 0, vida = 0;
+        memset(&espera, 0, sizeof(espera));
+        e = &res->etapas[k + 2];
+        e->nombre    = cfg.etapas[k].nombre;
+        e->hilos     = cfg.etapas[k].hilos;
+        e->capacidad = q->capacidad;
+        for (i = 0; i < pipeline.num_trabajadores; i++) {
+            TrabajadorEtapa *w = &pipeline.trabajadores[i];
+            if (w->etapa != k) continue;
+            e->procesados += w->procesados;
+            servicio      += w->ns_servicio;
+            bloqueo       += w->ns_bloqueo;
+            vida          += w->ns_total;
+            hist_combinar(&espera, &w->espera);
+            hist_combinar(&total,  &w->total);
+        }
+        pthread_mutex_lock(&q->mutex);
+        cola_indices_acumular(q, t_fin);
+        pthread_mutex_unlock(&q->mutex);
+        e->ocupacion_media = t_fin > t_inicio ? (double)q->ocupacion_integral / (double)(t_fin - t_inicio) : 0.0;
+        e->espera_p50_ms   = (double)hist_percentil(&espera, 50.0) / 1e6;
+        e->espera_p99_ms   = (double)hist_percentil(&espera, 99.0) / 1e6;
+        e->utilizacion_pct = vida ? 100.0 * (double)servicio / (double)vida : 0.0;
+        e->bloqueo_pct     = vida ? 100.0 * (double)bloqueo  / (double)vida : 0.0;
+    }
+    res->num_etapas      = pipeline.num + 2;
+    res->pipeline_p50_ms = (double)hist_percentil(&total, 50.0) / 1e6;
+    res->pipeline_p99_ms = (double)hist_percentil(&total, 99.0) / 1e6;
+
+    // La etapa con los hilos más ocupados limita al resto: las anteriores
+    // se bloquean esperando espacio y las siguientes esperan productos
+    res->cuello_botella = 0;
+    for (k = 1; k < res->num_etapas; k++) {
+        if (res->etapas[k].utilizacion_pct > res->etapas[res->cuello_botella].utilizacion_pct) res->cuello_botella = k;
+    }
+}
+
+/**
+ * Completa en 'res' el resumen de cada grupo de consumidores (--grupo);
+ * el bloqueo es el tiempo esperando que los cajeros publiquen
+ */
+static void grupos_resultados(ResultadoCorrida *res)
+{
+    ResultadoEtapa *e;
+    Histograma      espera;
+    int             i, k;
+
+    e = &res->grupos[0];
+    e->nombre          = "empacar";
+    e->hilos           = cfg.num_empacadores;
+    e->espera_p50_ms   = res->lat_p50_ms;
+    e->espera_p99_ms   = res->lat_p99_ms;
+    e->utilizacion_pct = res->tiempos_empacadores.ns_total ?
+                         100.0 * (double)res->tiempos_empacadores.ns_servicio / (double)res->tiempos_empacadores.ns_total : 0.0;
+    e->bloqueo_pct     = res->bloqueo_empacadores_pct;
+    for (i = 0; i < cfg.num_empacadores; i++) e->procesados += ctx_empacadores[i].estad.items;
+
+    for (k = 1; k < disruptor.num; k++) {
+        uint64_t servicio = 0, bloqueo = 0, vida = 0;
+        memset(&espera, 0, sizeof(espera));
+        e = &res->grupos[k];
+        e->nombre = cfg.grupos[k - 1].nombre;
+        e->hilos  = cfg.grupos[k - 1].hilos;
+        for (i = 0; i < disruptor.num_trabajadores; i++) {
+            TrabajadorGrupo *w = &disruptor.trabajadores[i];
+            if (w->grupo != k) continue;
+            e->procesados += w->procesados;
+            servicio      += w->ns_servicio;
+            bloqueo       += w->ns_espera;
+            vida          += w->ns_total;
+            hist_combinar(&espera, &w->espera);
+        }
+        e->espera_p50_ms   = (double)hist_percentil(&espera, 50.0) / 1e6;
+        e->espera_p99_ms   = (double)hist_percentil(&espera, 99.0) / 1e6;
+        e->utilizacion_pct = vida ? 100.0 * (double)servicio / (double)vida : 0.0;
+        e->bloqueo_pct     = vida ? 100.0 * (double)bloqueo  / (double)vida : 0.0;
+    }
+    res->num_grupos = disruptor.num;
+
+    // El grupo más atrasado es el que retiene los espacios del área
+    res->grupo_lento = 0;
+    for (k = 1; k < res->num_grupos; k++) {
+        if (res->grupos[k].procesados < res->grupos[res->grupo_lento].procesados) res->grupo_lento = k;
+    }
+}
+
+/**
+ * Ejecuta una corrida completa de la simulación con la configuración 'cfg'
+ *
+ * Parámetros:
+ *   res: Estructura donde se escriben los resultados agregados
+ *
+ * Retorna:
+ *   0 si la corrida se completó, -1 si no se pudo reservar memoria
+ *
+ * Reinicia todo el estado global, por lo que puede llamarse varias
+ * veces seguidas (modo barrido). Las estadísticas por hilo quedan
+ * disponibles hasta la siguiente corrida o liberar_estadisticas().
  */
-void *cajero(void *arg)
+int ejecutar_simulacion(ResultadoCorrida *res)
 {
-    int id = *((int *)arg);
-    free(arg);
+    int i, resultado = -1;
+    pthread_t  hilo_reporte;                    // Hilo reportero (opcional)
+    pthread_t  hilo_metricas;                   // Hilo servidor de métricas (opcional)
+    pthread_t  hilo_vaciador;                   // Vacía el log de texto cada --log-intervalo
+    int        fd_metricas = -1;
+    pthread_t *trabajadores = NULL;             // Hilos del modo corrutinas o epoll
+    int        num_trabajadores = 0;
+    // Todo el estado por hilo sale de una sola arena (ver contextos_reservar)
+    liberar_estadisticas();
+    if (contextos_reservar() != 0) return -1;
 
-    // Inicializa semilla aleatoria única para este cajero
-    srand((unsigned int)(time(NULL)) ^ (unsigned int)(id * 1234));
+    // Modos corrutinas y epoll: pilas y cola de listas antes de arrancar nada
+    if (cfg.modo != MODO_HILOS) {
+        num_trabajadores = cfg.trabajadores > 0    ? cfg.trabajadores
+                         : cfg.modo == MODO_EPOLL ? 1 : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (num_trabajadores < 1) num_trabajadores = 1;
+        trabajadores = calloc((size_t)num_trabajadores, sizeof(pthread_t));
+        if (!trabajadores || planificador_preparar(cajero, empacador) != 0) goto liberar;
+    }
 
-    while (simulacion_activa) {
+    // ===== CARRILES Y UBICACIÓN =====
+    // Cada carril necesita al menos un cajero y un empacador
+    num_carriles = cfg.carriles;
+    if (num_carriles > cfg.num_cajeros && cfg.num_cajeros > 0)         num_carriles = cfg.num_cajeros;
+    if (num_carriles > cfg.num_empacadores && cfg.num_empacadores > 0) num_carriles = cfg.num_empacadores;
+    if (ubicar_carriles() != 0) fprintf(stderr, "Aviso: no se pudo leer la topología; se corre sin afinidad\n");
 
-        // Simula tiempo de escaneo de producto (200-1000 ms)
-        usleep((rand() % 800 + 200) * 1000);
+    // ===== ÁREA DE EMPAQUE Y PRIMITIVAS DE SINCRONIZACIÓN =====
+    if (area_abrir() != 0) {
+        if (cfg.ruta_shm) perror(cfg.ruta_shm);
+        goto liberar;
+    }
+    if (pipeline_preparar() != 0 || disruptor_preparar() != 0) goto liberar;
+    // Modo epoll: eventfd de los semáforos y señales antes de crear hilos
+    if (cfg.modo == MODO_EPOLL && bucle_preparar() != 0) goto liberar;
+    if (replay_preparar() != 0) goto liberar;
+    replay.activos = cfg.num_cajeros;
+    replay.agotado = 0;
 
-        if (!simulacion_activa) break;
+    // Journal: recupera los productos no empacados antes de crear los hilos,
+    // a partir del último snapshot si lo hay
+    pthread_t hilo_wal, hilo_snap;
+    if (cfg.ruta_journal) {
+        BaseRecuperacion base;
+        memset(&base, 0, sizeof(base));
+        if (cfg.ruta_snapshot && !cfg.journal_recuperar) unlink(cfg.ruta_snapshot);
+        if (cfg.ruta_snapshot && cfg.journal_recuperar && snapshot_cargar(cfg.ruta_snapshot, &base) < 0) {
+            fprintf(stderr, "Aviso: %s: snapshot inválido; se recupera solo del journal\n", cfg.ruta_snapshot);
+        }
+        int rc = journal_abrir(cfg.ruta_journal, cfg.journal_recuperar, &base);
+        free(base.productos);
+        if (rc == 0 && cfg.ruta_snapshot && snapshot_preparar() != 0) {
+            journal_cerrar();
+            errno = ENOMEM;
+            rc = -1;
+        }
+        if (rc == 0 && cfg.modo == MODO_EPOLL && journal_preparar_bucle() != 0) {
+            journal_cerrar();
+            rc = -1;
+        }
+        if (rc != 0) {
+            perror(cfg.ruta_journal);
+            snapshot_cerrar();
+            goto liberar;
+        }
+        journal_llenar_area();
+        pthread_create(&hilo_wal, NULL, hilo_journal, NULL);
+        if (cfg.ruta_snapshot) pthread_create(&hilo_snap, NULL, hilo_snapshot, NULL);
+    }
 
-        // Crea un nuevo producto con datos aleatorios
-        Producto p;
-        p.codigo = rand() % 9000 + 1000;  // Código entre 1000-9999
-        strncpy(p.nombre, productos[rand() % NUM_PRODUCTOS],
-                sizeof(p.nombre) - 1);
-        p.nombre[sizeof(p.nombre) - 1] = '\0';  // Asegura terminación nula
+    // cond_fin: usa el reloj monotónico para el límite de tiempo
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_fin, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&mtx_fin, NULL);
 
-        // WAIT en sem_empty: espera que haya espacio en el buffer
-        sem_wait_manual(&sem_empty);
+    uint64_t t_inicio = ahora_ns();
+    t_inicio_ns       = t_inicio;
 
-        // Verifica si se debe terminar; libera semáforo para no bloquear otros
-        if (!simulacion_activa) { sem_signal_manual(&sem_empty); break; }
+    // Log de texto: buffers por hilo en la arena y, opcionalmente, un archivo destino
+    if (cfg.log_nivel >= LOG_RESUMEN && !cfg.ruta_log_binario) {
+        fd_log_texto = STDOUT_FILENO;
+        if (cfg.ruta_log) {
+            fd_log_texto = open(cfg.ruta_log, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            if (fd_log_texto < 0) { perror(cfg.ruta_log); fd_log_texto = STDOUT_FILENO; }
+        }
+    }
 
-        // ===== INICIA SECCIÓN CRÍTICA =====
-        pthread_mutex_lock(&mutex);
+    // Log binario: los buffers por hilo ya están en la arena
+    if (cfg.ruta_log_binario && log_binario_abrir(cfg.ruta_log_binario) != 0) {
+        perror(cfg.ruta_log_binario);
+    }
 
-        // Coloca el producto en el buffer circular
-        area_empaque[indice_in] = p;
-        indice_in = (indice_in + 1) % BUFFER_SIZE;  // Avanza índice circularmente
-        total_producidos++;
-        int ocupados = buffer_ocupados();
+    // ===== CREA HILOS =====
+    struct rusage uso_inicio, uso_fin;
+    getrusage(RUSAGE_SELF, &uso_inicio);
 
-        log_evento("CAJERO", id, "ENTRA SC - coloca producto",
-                   p.nombre, ocupados);
+    // Crea el hilo del reloj y programa el fin de la corrida (y, con --shm,
+    // la revisión periódica de si otro proceso la detuvo)
+    simulacion_finalizada = 0;
+    memset(&evento_fin,        0, sizeof(evento_fin));
+    memset(&evento_vigilancia, 0, sizeof(evento_vigilancia));
+    evento_fin.vencer        = finalizar_simulacion;
+    evento_vigilancia.vencer = vigilar_area;
+    reloj_iniciar(cfg.modo == MODO_EPOLL);
+    if (cfg.modo == MODO_EPOLL) bucle_agregar(FUENTE_RELOJ, reloj.fd_timer, NULL);
+    reloj_programar(&evento_fin, t_inicio + (uint64_t)cfg.duracion_seg * 1000000000ull);
+    if (cfg.ruta_shm) reloj_programar(&evento_vigilancia, ahora_ns() + 200000000ull);
 
-        pthread_mutex_unlock(&mutex);
-        // ===== FIN SECCIÓN CRÍTICA =====
+    // Cajero y empacador i atienden el carril i % num_carriles
+    for (i = 0; i < cfg.num_cajeros;     i++) ctx_cajeros[i].carril     = i % num_carriles;
+    for (i = 0; i < cfg.num_empacadores; i++) ctx_empacadores[i].carril = i % num_carriles;
 
-        log_evento("CAJERO", id, "SALE  SC",
-                   p.nombre, ocupados);
+    pthread_attr_t attr_hilo;
+    if (cfg.modo != MODO_HILOS) {
+        // Las corrutinas ya están en la cola de listas; los trabajadores las reparten
+        for (i = 0; i < num_trabajadores; i++) {
+            pthread_create(&trabajadores[i], NULL,
+                           cfg.modo == MODO_EPOLL ? trabajador_epoll : trabajador_corrutinas, NULL);
+        }
+    } else {
+        // Crea hilos cajeros (productores), con la afinidad de su carril
+        for (i = 0; i < cfg.num_cajeros; i++) {
+            ContextoHilo *c = &ctx_cajeros[i];
+            atributos_hilo(&attr_hilo, c->carril, ROL_CAJERO);
+            pthread_create(&c->hilo, &attr_hilo, cajero, c);
+            pthread_attr_destroy(&attr_hilo);
+        }
 
-        // SIGNAL en sem_full: indica que hay un producto disponible
-        sem_signal_manual(&sem_full);
+        // Crea hilos empacadores (consumidores)
+        for (i = 0; i < cfg.num_empacadores; i++) {
+            ContextoHilo *c = &ctx_empacadores[i];
+            atributos_hilo(&attr_hilo, c->carril, ROL_EMPACADOR);
+            pthread_create(&c->hilo, &attr_hilo, empacador, c);
+            pthread_attr_destroy(&attr_hilo);
+        }
     }
 
-    printf("[FIN] Cajero     #%d termino.\n", id);
-    return NULL;
+    // Crea los trabajadores de las etapas del pipeline (--etapa)
+    for (i = 0; i < pipeline.num_trabajadores; i++) {
+        pthread_create(&pipeline.trabajadores[i].hilo, NULL, trabajador_etapa, &pipeline.trabajadores[i]);
+    }
+    // Y los de los grupos de consumidores (--grupo)
+    for (i = 0; i < disruptor.num_trabajadores; i++) {
+        pthread_create(&disruptor.trabajadores[i].hilo, NULL, trabajador_grupo, &disruptor.trabajadores[i]);
+    }
+
+    // Crea el reportero en vivo si se pidió un intervalo
+    if (cfg.reporte_ms > 0) pthread_create(&hilo_reporte, NULL, reportero, NULL);
+
+    // Vacía periódicamente los buffers del log de texto
+    int vaciar_log = cfg.num_cajeros + cfg.num_empacadores > 0 && ctx_cajeros[0].logtxt && cfg.log_intervalo_ms > 0;
+    if (vaciar_log) pthread_create(&hilo_vaciador, NULL, vaciador_log, NULL);
+
+    // Crea el servidor de métricas si se pidió un socket
+    if (cfg.ruta_metricas) {
+        fd_metricas = abrir_socket_metricas(cfg.ruta_metricas);
+        if (fd_metricas < 0) perror(cfg.ruta_metricas);
+        else pthread_create(&hilo_metricas, NULL, servidor_metricas, &fd_metricas);
+    }
+
+    // ===== ESPERA A QUE TODOS LOS HILOS TERMINEN =====
+    // El reloj vence evento_fin y libera a los que esperan en los semáforos
+    if (cfg.modo != MODO_HILOS) {
+        // Los trabajadores terminan cuando ya no quedan corrutinas vivas
+        for (i = 0; i < num_trabajadores; i++) pthread_join(trabajadores[i], NULL);
+    } else {
+        // Luego espera a que todos los cajeros terminen
+        for (i = 0; i < cfg.num_cajeros;     i++) pthread_join(ctx_cajeros[i].hilo,     NULL);
+        // Finalmente espera a que todos los empacadores terminen
+        for (i = 0; i < cfg.num_empacadores; i++) pthread_join(ctx_empacadores[i].hilo, NULL);
+    }
+    for (i = 0; i < pipeline.num_trabajadores; i++) pthread_join(pipeline.trabajadores[i].hilo, NULL);
+    for (i = 0; i < disruptor.num_trabajadores; i++) pthread_join(disruptor.trabajadores[i].hilo, NULL);
+    // Con --shm los hilos pueden terminar al ver 'activa' = 0 antes de que
+    // la vigilancia lo note; el fin se registra aquí en ese caso
+    finalizar_simulacion(&evento_fin);
+    reloj_terminar();
+    if (cfg.reporte_ms > 0) pthread_join(hilo_reporte, NULL);
+    if (vaciar_log) pthread_join(hilo_vaciador, NULL);
+    if (fd_metricas >= 0) {
+        pthread_join(hilo_metricas, NULL);
+        close(fd_metricas);
+        unlink(cfg.ruta_metricas);
+    }
+    // El journal escribe lo que quedó pendiente (empaques del final) y un
+    // último snapshot deja el reinicio sin cola que repetir
+    if (cfg.ruta_journal) {
+        if (cfg.ruta_snapshot) pthread_join(hilo_snap, NULL);
+        journal_terminar();
+        pthread_join(hilo_wal, NULL);
+        if (cfg.ruta_snapshot && snapshot_tomar(cfg.ruta_snapshot) != 0) perror(cfg.ruta_snapshot);
+    }
+
+    // ===== CALCULA RESULTADOS =====
+    getrusage(RUSAGE_SELF, &uso_fin);
+    uint64_t t_fin = ahora_ns();
+    long     producidos = 0, consumidos = 0;
+    double   ocupacion  = 0.0;
+    memset(res, 0, sizeof(*res));
+    for (i = 0; i < num_carriles; i++) {
+        AreaEmpaque *a = carriles[i];
+        if (mutex_bloquear(&a->mutex)) area_reparar();  // Con --shm otro proceso puede seguir activo
+        acumular_ocupacion(a, t_fin);
+        pthread_mutex_unlock(&a->mutex);
+        producidos += a->total_producidos;
+        consumidos += a->total_consumidos;
+        res->promovidos += a->total_promovidos;
+        ocupacion  += (double)a->ocupacion_integral / (double)(t_fin - a->t_creacion_ns);
+        if (i < MAX_CARRILES) res->consumidos_carril[i] = a->total_consumidos;
+    }
+
+    Histograma latencia, latencia_llegada;
+    memset(&latencia, 0, sizeof(latencia));
+    memset(&latencia_llegada, 0, sizeof(latencia_llegada));
+    for (i = 0; i < cfg.num_empacadores; i++) {
+        hist_combinar(&latencia,         &ctx_empacadores[i].estad.latencia);
+        hist_combinar(&latencia_llegada, &ctx_empacadores[i].estad.latencia_llegada);
+    }
+
+    res->segundos                = (double)(t_fin_ns - t_inicio) / 1e9;
+    res->producidos              = producidos;
+    res->consumidos              = consumidos;
+    res->throughput              = res->segundos > 0 ? (double)consumidos / res->segundos : 0.0;
+    res->lat_p50_ms              = (double)hist_percentil(&latencia, 50.0) / 1e6;
+    res->lat_p99_ms              = (double)hist_percentil(&latencia, 99.0) / 1e6;
+    res->ocupacion_media         = ocupacion;
+    res->carriles                = num_carriles;
+    res->paginas                 = memoria_areas.paginas;
+    res->reserva_ms              = (double)memoria_areas.ns_reserva / 1e6;
+    res->bloqueada               = memoria_areas.bloqueada;
+    res->fallos_pagina           = uso_fin.ru_minflt - uso_inicio.ru_minflt;
+    res->trabajadores            = num_trabajadores;
+    res->cambios_contexto        = planificador.cambios;
+    res->bucle_esperas           = bucle.esperas;
+    res->bucle_avisos            = bucle.avisos;
+    res->rueda_eventos           = reloj.rueda.eventos;
+    res->rueda_cascadas          = reloj.rueda.cascadas;
+    res->despertares_reloj       = reloj.despertares;
+    res->tiempos_cajeros         = sumar_tiempos(ctx_cajeros,     cfg.num_cajeros);
+    res->tiempos_empacadores     = sumar_tiempos(ctx_empacadores, cfg.num_empacadores);
+    res->bloqueo_cajeros_pct     = porcentaje_bloqueo(&res->tiempos_cajeros);
+    res->bloqueo_empacadores_pct = porcentaje_bloqueo(&res->tiempos_empacadores);
+    res->llegada_p50_ms          = (double)hist_percentil(&latencia_llegada, 50.0) / 1e6;
+    res->llegada_p99_ms          = (double)hist_percentil(&latencia_llegada, 99.0) / 1e6;
+    res->llegada_p999_ms         = (double)hist_percentil(&latencia_llegada, 99.9) / 1e6;
+    res->prioridades             = area->prioridades;
+    for (int c = 0; cfg.num_empacadores > 0 && ctx_empacadores[0].latencia_clase && c < cfg.prioridades; c++) {
+        memset(&latencia, 0, sizeof(latencia));  // Ya se usó para los percentiles globales
+        for (i = 0; i < cfg.num_empacadores; i++) hist_combinar(&latencia, &ctx_empacadores[i].latencia_clase[c]);
+        res->clase_empacados[c] = latencia.total;
+        res->clase_p50_ms[c]    = (double)hist_percentil(&latencia, 50.0) / 1e6;
+        res->clase_p99_ms[c]    = (double)hist_percentil(&latencia, 99.0) / 1e6;
+    }
+    for (i = 0; i < cfg.num_cajeros; i++) {
+        res->llegadas    += ctx_cajeros[i].estad.llegadas;
+        res->retrasados  += ctx_cajeros[i].estad.retrasados;
+        res->descartados += ctx_cajeros[i].estad.descartados;
+        res->lleno_descartados  += ctx_cajeros[i].estad.lleno_descartados;
+        res->lleno_sobrescritos += ctx_cajeros[i].estad.lleno_sobrescritos;
+        res->lleno_expirados    += ctx_cajeros[i].estad.lleno_expirados;
+        res->lleno_rechazados   += ctx_cajeros[i].estad.lleno_rechazados;
+    }
+    if (pipeline.num > 0) pipeline_resultados(res, t_inicio, t_fin);
+    if (disruptor.num > 0) grupos_resultados(res);
+    if (cfg.ruta_journal) {
+        res->journal_registros   = journal.anexados;
+        res->journal_fsyncs      = journal.fsyncs;
+        res->journal_lote_medio  = journal.fsyncs ? (double)journal.anexados / (double)journal.fsyncs : 0.0;
+        res->journal_fsync_ms    = journal.fsyncs ? (double)journal.ns_fsync / (double)journal.fsyncs / 1e6 : 0.0;
+        res->journal_espera_ms   = journal.esperas ? (double)journal.ns_espera / (double)journal.esperas / 1e6 : 0.0;
+        res->journal_recuperados = num_recuperados;
+        res->journal_error       = journal.error;
+        res->journal_cola        = journal.registros_cola;
+        res->recuperacion_ms     = (double)journal.ns_recuperacion / 1e6;
+        res->snapshot_cargado    = snapshots.cargado;
+        res->snapshots           = snapshots.tomados;
+        res->snapshot_pausa_ms   = snapshots.tomados ? (double)snapshots.ns_pausa / (double)snapshots.tomados / 1e6 : 0.0;
+        res->snapshot_pausa_max_ms = (double)snapshots.ns_pausa_max / 1e6;
+        res->snapshot_bytes      = snapshots.bytes;
+        journal_cerrar();
+        snapshot_cerrar();
+    }
+
+    log_binario_cerrar();
+
+    // Los hilos ya vaciaron sus buffers de texto al terminar
+    for (i = 0; i < cfg.num_cajeros + cfg.num_empacadores; i++) {
+        const BufferLogTexto *b = ctx_cajeros[i].logtxt;  // Los empacadores siguen a los cajeros
+        if (!b) continue;
+        res->eventos_escritos    += b->escritos;
+        res->eventos_descartados += b->descartados;
+    }
+    if (fd_log_texto != STDOUT_FILENO) {
+        close(fd_log_texto);
+        fd_log_texto = STDOUT_FILENO;
+    }
+
+    // ===== VUELCA LA TRAZA =====
+    if (cfg.ruta_traza) {
+        if (traza_volcar(cfg.ruta_traza) != 0) perror(cfg.ruta_traza);
+    }
+
+    pthread_cond_destroy(&cond_fin);
+    pthread_mutex_destroy(&mtx_fin);
+    resultado = 0;
+
+    // ===== LIMPIA RECURSOS =====
+    // Cada función ignora lo que no llegó a prepararse, así los errores de
+    // la preparación saltan aquí con lo que tengan reservado
+liberar:
+    replay_liberar_colas();
+    bucle_liberar();
+    pipeline_liberar();
+    disruptor_liberar();
+    area_cerrar();
+    planificador_liberar();
+    free(trabajadores);
+    if (resultado != 0) liberar_estadisticas();  // Con éxito quedan para el reporte
+    return resultado;
 }
 
-/* -------------------- HILO: EMPACADOR - CONSUMIDOR -------------------- */
+/* -------------------- BARRIDO DE PARÁMETROS -------------------- */
 /**
- * Función ejecutada por cada hilo empacador (consumidor)
- * 
+ * Lista de valores de un parámetro del barrido
+ */
+typedef struct {
+    int n;
+    int v[MAX_VALORES_BARRIDO];
+} ListaValores;
+
+/**
+ * Interpreta una lista de enteros positivos separada por comas
+ *
  * Parámetros:
- *   arg: Puntero a un entero con el ID del empacador
- * 
- * Comportamiento:
- *   1. Toma productos del área de empaque (buffer compartido)
- *   2. Simula el empacado con un delay aleatorio
- *   3. Utiliza semáforos para coordinar con cajeros
- *   4. Se ejecuta hasta que simulacion_activa = 0
- * 
- * Protocolo de sincronización:
- *   - sem_wait(full): Espera que haya un producto disponible
- *   - mutex_lock: Entra a sección crítica para modificar el buffer
- *   - mutex_unlock: Sale de sección crítica
- *   - sem_signal(empty): Señala que hay un espacio libre
+ *   texto: Lista con elementos de la forma "N", "A-B" (paso 1),
+ *          "A-B:P" (paso aritmético P) o "A-B:xF" (multiplica por F)
+ *   l:     Lista donde se agregan los valores
+ *
+ * Retorna:
+ *   0 si la lista es válida, -1 en caso contrario
+ *
+ * Ejemplo: "1,2,4-8:2,16-128:x2" -> 1 2 4 6 8 16 32 64 128
  */
-void *empacador(void *arg)
+int parsear_lista(const char *texto, ListaValores *l)
 {
-    int id = *((int *)arg);
-    free(arg);
+    char  copia[256];
+    char *guardado = NULL, *tok;
+    l->n = 0;
+    if (strlen(texto) >= sizeof(copia)) return -1;
+    strcpy(copia, texto);
 
-    // Inicializa semilla aleatoria única para este empacador
-    srand((unsigned int)(time(NULL)) ^ (unsigned int)(id * 5678));
+    for (tok = strtok_r(copia, ",", &guardado); tok; tok = strtok_r(NULL, ",", &guardado)) {
+        int  a, b, paso = 1, geometrico = 0;
+        char sep;
+        if (sscanf(tok, "%d-%d:x%d", &a, &b, &paso) == 3)      geometrico = 1;
+        else if (sscanf(tok, "%d-%d:%d", &a, &b, &paso) == 3)  ;
+        else if (sscanf(tok, "%d-%d%c", &a, &b, &sep) == 2)    paso = 1;
+        else if (sscanf(tok, "%d%c", &a, &sep) == 1)           b = a;
+        else return -1;
 
-    while (simulacion_activa) {
+        if (a < 0 || b < a || paso < 1 || (geometrico && (paso < 2 || a == 0))) return -1;
+        for (; a <= b; a = geometrico ? a * paso : a + paso) {
+            if (l->n == MAX_VALORES_BARRIDO) return -1;
+            l->v[l->n++] = a;
+        }
+    }
+    return l->n > 0 ? 0 : -1;
+}
 
-        // WAIT en sem_full: espera que haya un producto en el buffer
-        sem_wait_manual(&sem_full);
+/**
+ * Interpreta una lista de backends separada por comas (ej: "manual,posix")
+ */
+int parsear_backends(const char *texto, ListaValores *l)
+{
+    char  copia[256];
+    char *guardado = NULL, *tok;
+    l->n = 0;
+    if (strlen(texto) >= sizeof(copia)) return -1;
+    strcpy(copia, texto);
 
-        // Verifica si se debe terminar; libera semáforo para no bloquear otros
-        if (!simulacion_activa) { sem_signal_manual(&sem_full); break; }
+    for (tok = strtok_r(copia, ",", &guardado); tok; tok = strtok_r(NULL, ",", &guardado)) {
+        int b;
+        for (b = 0; b < NUM_BACKENDS && strcmp(tok, nombres_backend[b]) != 0; b++) ;
+        if (b == NUM_BACKENDS || l->n == MAX_VALORES_BARRIDO) return -1;
+        l->v[l->n++] = b;
+    }
+    return l->n > 0 ? 0 : -1;
+}
 
-        // ===== INICIA SECCIÓN CRÍTICA =====
-        pthread_mutex_lock(&mutex);
+/**
+ * Interpreta una lista de políticas de afinidad (ej: "ninguna,pares,nodos")
+ */
+int parsear_afinidades(const char *texto, ListaValores *l)
+{
+    char  copia[256];
+    char *guardado = NULL, *tok;
+    l->n = 0;
+    if (strlen(texto) >= sizeof(copia)) return -1;
+    strcpy(copia, texto);
+
+    for (tok = strtok_r(copia, ",", &guardado); tok; tok = strtok_r(NULL, ",", &guardado)) {
+        int a;
+        for (a = 0; a < NUM_AFINIDADES && strcmp(tok, nombres_afinidad[a]) != 0; a++) ;
+        if (a == NUM_AFINIDADES || l->n == MAX_VALORES_BARRIDO) return -1;
+        l->v[l->n++] = a;
+    }
+    return l->n > 0 ? 0 : -1;
+}
 
-        // Toma el producto del buffer circular
-        Producto p   = area_empaque[indice_out];
-        indice_out   = (indice_out + 1) % BUFFER_SIZE;  // Avanza índice circularmente
-        total_consumidos++;
-        int ocupados = buffer_ocupados();
+/**
+ * Ejecuta una corrida por cada combinación de parámetros y escribe una
+ * fila CSV por punto
+ *
+ * Parámetros:
+ *   csv:                          Archivo de salida (encabezado + una fila por punto)
+ *   capacidades, cajeros,
+ *   empacadores, backends,
+ *   intervalos, carriles,
+ *   afinidades:                   Valores a combinar (producto cartesiano);
+ *                                 'intervalos' es el group commit del journal
+ *
+ * El resto de parámetros (duración, límite de productos, tiempos de
+ * servicio) se toman de 'cfg' y son iguales para todos los puntos.
+ * Con --journal cada punto empieza con el journal vacío.
+ * El progreso se reporta por stderr para no mezclarse con el CSV.
+ */
+int ejecutar_barrido(FILE *csv, const ListaValores *capacidades, const ListaValores *cajeros,
+                     const ListaValores *empacadores, const ListaValores *backends,
+                     const ListaValores *intervalos, const ListaValores *carriles,
+                     const ListaValores *afinidades)
+{
+    int ib, ic, ie, is, ij, il, ia;
+    int punto = 0;
+    int total = capacidades->n * cajeros->n * empacadores->n * backends->n * intervalos->n *
+                carriles->n * afinidades->n;
 
-        log_evento("EMPACADOR", id, "ENTRA SC - toma producto",
-                   p.nombre, ocupados);
+    cfg.journal_recuperar = 0;
 
-        pthread_mutex_unlock(&mutex);
-        // ===== FIN SECCIÓN CRÍTICA =====
+    fprintf(csv, "capacidad,cajeros,empacadores,backend,segundos,producidos,consumidos,"
+                 "throughput_items_s,latencia_p50_ms,latencia_p99_ms,ocupacion_media,"
+                 "bloqueo_cajeros_pct,bloqueo_empacadores_pct,"
+                 "llegada_p50_ms,llegada_p99_ms,llegada_p999_ms,llegadas,retrasados,descartados,"
+                 "journal_intervalo_ms,fsyncs,carriles,afinidad,fallos_pagina\n");
 
-        log_evento("EMPACADOR", id, "SALE  SC",
-                   p.nombre, ocupados);
+    for (ib = 0; ib < capacidades->n; ib++)
+    for (ic = 0; ic < cajeros->n;     ic++)
+    for (ie = 0; ie < empacadores->n; ie++)
+    for (is = 0; is < backends->n;    is++)
+    for (ij = 0; ij < intervalos->n;  ij++)
+    for (il = 0; il < carriles->n;    il++)
+    for (ia = 0; ia < afinidades->n;  ia++) {
+        ResultadoCorrida r;
+        cfg.capacidad            = capacidades->v[ib];
+        cfg.num_cajeros          = cajeros->v[ic];
+        cfg.num_empacadores      = empacadores->v[ie];
+        cfg.backend              = (Backend)backends->v[is];
+        cfg.journal_intervalo_ms = intervalos->v[ij];
+        cfg.carriles             = carriles->v[il];
+        cfg.afinidad             = (Afinidad)afinidades->v[ia];
 
-        // SIGNAL en sem_empty: indica que hay un espacio libre
-        sem_signal_manual(&sem_empty);
+        fprintf(stderr, "[BARRIDO] Punto %d/%d: capacidad=%d cajeros=%d empacadores=%d backend=%s",
+                ++punto, total, cfg.capacidad, cfg.num_cajeros, cfg.num_empacadores,
+                nombres_backend[cfg.backend]);
+        if (cfg.ruta_journal) fprintf(stderr, " journal=%dms", cfg.journal_intervalo_ms);
+        if (carriles->n > 1 || afinidades->n > 1 || cfg.carriles > 1) {
+            fprintf(stderr, " carriles=%d afinidad=%s", cfg.carriles, nombres_afinidad[cfg.afinidad]);
+        }
+        fprintf(stderr, "\n");
+        if (ejecutar_simulacion(&r) != 0) {
+            fprintf(stderr, "Error: no se pudo reservar memoria para el punto %d\n", punto);
+            return -1;
+        }
 
-        // Simula tiempo de empacado (400-1600 ms)
-        usleep((rand() % 1200 + 400) * 1000);
+        fprintf(csv, "%d,%d,%d,%s,%.3f,%ld,%ld,%.2f,%.3f,%.3f,%.3f,%.2f,%.2f,",
+                cfg.capacidad, cfg.num_cajeros, cfg.num_empacadores, nombres_backend[cfg.backend],
+                r.segundos, r.producidos, r.consumidos, r.throughput,
+                r.lat_p50_ms, r.lat_p99_ms, r.ocupacion_media,
+                r.bloqueo_cajeros_pct, r.bloqueo_empacadores_pct);
+        // En lazo cerrado sin traza la llegada es el inicio del escaneo: sin percentiles de llegada
+        if (cfg.llegadas != LLEGADAS_CERRADO || cfg.ruta_replay) {
+            fprintf(csv, "%.3f,%.3f,%.3f,", r.llegada_p50_ms, r.llegada_p99_ms, r.llegada_p999_ms);
+        } else {
+            fprintf(csv, ",,,");
+        }
+        fprintf(csv, "%llu,%llu,%llu,%d,%llu,%d,%s,%ld\n",
+                (unsigned long long)r.llegadas, (unsigned long long)r.retrasados,
+                (unsigned long long)r.descartados,
+                cfg.ruta_journal ? cfg.journal_intervalo_ms : 0, (unsigned long long)r.journal_fsyncs,
+                r.carriles, nombres_afinidad[cfg.afinidad], r.fallos_pagina);
+        fflush(csv);
     }
+    return 0;
+}
 
-    printf("[FIN] Empacador  #%d termino.\n", id);
-    return NULL;
+/* -------------------- LÍNEA DE COMANDOS -------------------- */
+/**
+ * Imprime la ayuda de la línea de comandos
+ */
+void uso(const char *programa)
+{
+    printf("Uso: %s [opciones]\n\n", programa);
+    printf("  -b, --capacidad LISTA     Espacios del área de empaque (defecto %d)\n", BUFFER_SIZE);
+    printf("  -c, --cajeros LISTA       Hilos cajeros (defecto %d)\n", NUM_CAJEROS);
+    printf("  -e, --empacadores LISTA   Hilos empacadores (defecto %d)\n", NUM_EMPACADORES);
+    printf("  -k, --backend LISTA       Semáforos: manual | posix (defecto manual)\n");
+    printf("  -d, --duracion SEG        Duración máxima de cada corrida (defecto %d)\n", DURACION_SEG);
+    printf("  -n, --items N             Termina al empacar N productos (defecto sin límite)\n");
+    printf("      --escaneo DIST        Tiempo de escaneo en ms (defecto uniforme %d-%d)\n", ESCANEO_MIN_MS, ESCANEO_MAX_MS);
+    printf("      --empaque DIST        Tiempo de empacado en ms (defecto uniforme %d-%d)\n", EMPAQUE_MIN_MS, EMPAQUE_MAX_MS);
+    printf("      --llegadas MODO       cerrado | poisson | mmpp (defecto cerrado)\n");
+    printf("      --tasa R              Llegadas/s entre todos los cajeros en lazo abierto (defecto %.0f)\n", TASA_LLEGADAS);
+    printf("      --mmpp F,NORMAL,RAFAGA Ráfagas de F veces la tasa; duración media de cada estado en ms\n");
+    printf("                            (defecto %.0f,%.0f,%.0f)\n", MMPP_FACTOR, MMPP_NORMAL_MS, MMPP_RAFAGA_MS);
+    printf("      --cola-max N          Llegadas que esperan a cada cajero antes de descartar (defecto %d)\n", COLA_MAX_LLEGADAS);
+    printf("      --replay ARCHIVO      Llegadas de los cajeros desde una traza CSV timestamp_ms,caja,codigo\n");
+    printf("      --replay-velocidad X  Aceleración del replay (defecto 1; 0 = sin esperas)\n");
+    printf("      --carriles LISTA      Áreas independientes, cada una con sus cajeros y empacadores (defecto 1)\n");
+    printf("      --afinidad LISTA      ninguna | pares | sockets | nodos (defecto ninguna)\n");
+    printf("      --paginas TIPO        Páginas del área: normales | enormes (2 MB o THP) (defecto normales)\n");
+    printf("      --prefault            Toca toda el área antes de arrancar los hilos\n");
+    printf("      --mlock               Bloquea el área en RAM\n");
+    printf("      --lleno POLITICA      Cajero con el área llena: bloquear | timeout:MS | descartar-nuevo |\n");
+    printf("                            descartar-viejo | rechazar (defecto bloquear)\n");
+    printf("      --prioridades PESOS   Clases de prioridad del área con su peso al escanear, la más\n");
+    printf("                            urgente primero (ej. 20,80; máx. %d clases)\n", MAX_PRIORIDADES);
+    printf("      --envejecimiento MS   Espera tras la cual una clase menor pasa primero (defecto %d; 0 = nunca)\n",
+           ENVEJECIMIENTO_MS);
+    printf("      --etapa NOMBRE:HILOS:CAPACIDAD:DIST Agrega una etapa después del empacado, con su\n");
+    printf("                            cola de entrada; se repite para encadenar hasta %d etapas\n", MAX_ETAPAS);
+    printf("      --grupo NOMBRE:HILOS:DIST Agrega un grupo de consumidores que ve todos los productos\n");
+    printf("                            del área junto con los empacadores (máx. %d grupos)\n", MAX_GRUPOS);
+    printf("      --modo MODO           hilos | corrutinas | epoll (defecto hilos)\n");
+    printf("      --trabajadores N      Con --modo corrutinas o epoll: hilos que las ejecutan\n");
+    printf("                            (defecto uno por CPU; epoll: uno)\n");
+    printf("      --shm NOMBRE          Área de empaque en el segmento shm_open NOMBRE (ej. /super)\n");
+    printf("      --proceso ROL         Con --shm: ambos | productor | consumidor (defecto ambos)\n");
+    printf("      --journal ARCHIVO     Registra productos y empaques; al iniciar recupera los no empacados\n");
+    printf("      --journal-intervalo LISTA Espera máxima en ms antes de cada fdatasync (defecto %d)\n", JOURNAL_INTERVALO_MS);
+    printf("      --journal-lote N      Registros que disparan el fdatasync antes del intervalo (defecto %d)\n", JOURNAL_LOTE);
+    printf("      --snapshot ARCHIVO    Con --journal: snapshot periódico del estado; al iniciar se carga\n");
+    printf("                            y solo se repite la cola del journal\n");
+    printf("      --snapshot-intervalo MS Intervalo entre snapshots (defecto %d)\n", SNAPSHOT_INTERVALO_MS);
+    printf("  -q, --silencioso          No imprime cada evento (igual a --log-nivel resumen)\n");
+    printf("  -r, --reporte MS          Imprime tasas y ocupación en stderr cada MS ms\n");
+    printf("  -m, --metricas RUTA       Sirve métricas Prometheus en el socket Unix RUTA\n");
+    printf("  -t, --traza ARCHIVO       Escribe una traza JSON para Perfetto/chrome://tracing\n");
+    printf("      --traza-eventos N     Intervalos preasignados por hilo (defecto %d)\n", EVENTOS_TRAZA);
+    printf("  -l, --log-binario ARCHIVO Registra los eventos en binario (ver DecodificadorLog)\n");
+    printf("  -L, --log-archivo ARCHIVO Escribe el log de eventos en ARCHIVO en lugar de stdout\n");
+    printf("      --log-intervalo MS    Espera máxima de una línea en el buffer del hilo (defecto %d)\n", LOG_INTERVALO_MS);
+    printf("      --log-nivel NIVEL     off | resumen | muestreo | completo (defecto completo)\n");
+    printf("      --log-muestreo N      En nivel muestreo, 1 de cada N productos (defecto %d)\n", LOG_MUESTREO_DEFECTO);
+    printf("      --log-limite EPS      Pasa a muestreo si el log supera EPS eventos/s (defecto sin límite)\n");
+    printf("  -S, --barrido             Corre todas las combinaciones de las listas y escribe CSV\n");
+    printf("  -o, --csv ARCHIVO         Destino del CSV del barrido (defecto stdout)\n");
+    printf("  -h, --help                Muestra esta ayuda\n\n");
+    printf("  LISTA: valores separados por comas; admite rangos A-B, A-B:PASO y A-B:xFACTOR.\n");
+    printf("  Sin --barrido cada lista debe tener un solo valor.\n");
+    printf("  DIST: MIN-MAX | constante:MS | uniforme:MIN-MAX | exponencial:MEDIA |\n");
+    printf("        lognormal:MEDIANA,SIGMA | pareto:MINIMO,ALFA | empirica:ARCHIVO\n");
 }
 
-/* -------------------- HILO: TEMPORIZADOR -------------------- */
 /**
- * Función ejecutada por el hilo temporizador
- * 
+ * Interpreta el nombre de un proceso de llegadas (ver ModoLlegadas)
+ */
+static int parsear_llegadas(const char *texto, ModoLlegadas *modo)
+{
+    for (int i = 0; i < NUM_MODOS_LLEGADAS; i++) {
+        if (strcmp(texto, nombres_llegadas[i]) == 0) { *modo = (ModoLlegadas)i; return 0; }
+    }
+    return -1;
+}
 
- * 
- * Comportamiento:
- *   1. Espera por DURACION_SEG segundos
- *   2. Establece simulacion_activa = 0 para detener todos los hilos
- *   3. Envía señales a los semáforos para despertar hilos bloqueados
- *      y permitirles terminar correctamente
- *
- * Propósito:
- *   Controla la duración de la simulación y asegura una terminación
- *   limpia de todos los hilos sin deadlock.
+/**
+ * Interpreta el modo de ejecución de los cajeros y empacadores (ver ModoEjecucion)
  */
-void *temporizador(void *arg)
+static int parsear_modo(const char *texto, ModoEjecucion *modo)
 {
-    (void)arg;  // Suprime warning de parámetro no usado
-    sleep(DURACION_SEG);  // Espera el tiempo de simulación
-    simulacion_activa = 0;  // Señala a todos los hilos que deben terminar
+    for (int i = 0; i < NUM_MODOS; i++) {
+        if (strcmp(texto, nombres_modo[i]) == 0) { *modo = (ModoEjecucion)i; return 0; }
+    }
+    return -1;
+}
 
-    // Despierta todos los hilos que puedan estar bloqueados en semáforos
-    // para que puedan verificar simulacion_activa y terminar
-    int i;
-    for (i = 0; i < NUM_CAJEROS + NUM_EMPACADORES; i++) {
-        sem_signal_manual(&sem_full);   // Despierta empacadores
-        sem_signal_manual(&sem_empty);  // Despierta cajeros
+/**
+ * Interpreta la política de área llena (ver PoliticaLleno); la espera
+ * máxima va después del nombre: timeout:MS
+ */
+static int parsear_lleno(const char *texto, PoliticaLleno *politica, int *timeout_ms)
+{
+    if (strncmp(texto, "timeout:", 8) == 0) {
+        *timeout_ms = atoi(texto + 8);
+        *politica   = LLENO_TIMEOUT;
+        return *timeout_ms > 0 ? 0 : -1;
     }
-    return NULL;
+    for (int i = 0; i < NUM_POLITICAS_LLENO; i++) {
+        if (i != LLENO_TIMEOUT && strcmp(texto, nombres_lleno[i]) == 0) { *politica = (PoliticaLleno)i; return 0; }
+    }
+    return -1;
 }
 
+/**
+ * Interpreta los pesos de las clases de prioridad: P0,P1,... (máximo
+ * MAX_PRIORIDADES, cada uno > 0)
+ */
+static int parsear_prioridades(const char *texto, int *prioridades, int *pesos)
+{
+    int   n = 0;
+    char *fin;
+    for (;;) {
+        long v = strtol(texto, &fin, 10);
+        if (fin == texto || v <= 0 || n == MAX_PRIORIDADES) return -1;
+        pesos[n++] = (int)v;
+        if (*fin == '\0') break;
+        if (*fin != ',') return -1;
+        texto = fin + 1;
+    }
+    *prioridades = n;
+    return 0;
+}
 
-int main(void)
+/**
+ * Interpreta una etapa del pipeline: NOMBRE:HILOS:CAPACIDAD:DIST, con DIST
+ * como en --escaneo (puede contener ':' y ',')
+ */
+static int parsear_etapa(const char *texto, DefEtapa *e)
 {
-    int i;
-    pthread_t hilos_cajero[NUM_CAJEROS];       // Array de hilos cajeros
-    pthread_t hilos_empacador[NUM_EMPACADORES]; // Array de hilos empacadores
-    pthread_t hilo_timer;                       // Hilo temporizador
+    const char *sep = strchr(texto, ':');
+    int         n   = 0;
+    if (!sep || sep == texto || (size_t)(sep - texto) >= sizeof(e->nombre)) return -1;
+    if (sscanf(sep + 1, "%d:%d:%n", &e->hilos, &e->capacidad, &n) != 2 || n == 0 ||
+        e->hilos < 1 || e->capacidad < 1) return -1;
+    if (parsear_distribucion(sep + 1 + n, &e->servicio) != 0) return -1;
+    memcpy(e->nombre, texto, (size_t)(sep - texto));
+    e->nombre[sep - texto] = '\0';
+    return 0;
+}
+
+/**
+ * Interpreta un grupo de consumidores: NOMBRE:HILOS:DIST, con DIST como
+ * en --escaneo
+ */
+static int parsear_grupo(const char *texto, DefGrupo *g)
+{
+    const char *sep = strchr(texto, ':');
+    int         n   = 0;
+    if (!sep || sep == texto || (size_t)(sep - texto) >= sizeof(g->nombre)) return -1;
+    if (sscanf(sep + 1, "%d:%n", &g->hilos, &n) != 1 || n == 0 || g->hilos < 1) return -1;
+    if (parsear_distribucion(sep + 1 + n, &g->servicio) != 0) return -1;
+    memcpy(g->nombre, texto, (size_t)(sep - texto));
+    g->nombre[sep - texto] = '\0';
+    return 0;
+}
+
+/**
+ * Interpreta el tipo de páginas del área (ver TipoPaginas)
+ */
+static int parsear_paginas(const char *texto, TipoPaginas *paginas)
+{
+    for (int i = 0; i < NUM_TIPOS_PAGINAS; i++) {
+        if (strcmp(texto, nombres_paginas[i]) == 0) { *paginas = (TipoPaginas)i; return 0; }
+    }
+    return -1;
+}
+
+/**
+ * Interpreta el rol de un proceso (ver RolProceso)
+ */
+static int parsear_proceso(const char *texto, RolProceso *rol)
+{
+    for (int i = 0; i < NUM_ROLES_PROCESO; i++) {
+        if (strcmp(texto, nombres_proceso[i]) == 0) { *rol = (RolProceso)i; return 0; }
+    }
+    return -1;
+}
+
+/**
+ * Interpreta el nombre de un nivel de log (ver NivelLog)
+ */
+static int parsear_nivel_log(const char *texto, NivelLog *nivel)
+{
+    for (int i = 0; i < NUM_NIVELES_LOG; i++) {
+        if (strcmp(texto, nombres_nivel_log[i]) == 0) { *nivel = (NivelLog)i; return 0; }
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    ListaValores capacidades = { 1, { BUFFER_SIZE } };
+    ListaValores cajeros     = { 1, { NUM_CAJEROS } };
+    ListaValores empacadores = { 1, { NUM_EMPACADORES } };
+    ListaValores backends    = { 1, { BACKEND_MANUAL } };
+    ListaValores intervalos  = { 1, { JOURNAL_INTERVALO_MS } };
+    ListaValores carriles_l  = { 1, { 1 } };
+    ListaValores afinidades  = { 1, { AFINIDAD_NINGUNA } };
+    const char  *ruta_csv    = NULL;
+    int          barrido     = 0;
+    int          opt;
+
+    enum { OPT_ESCANEO = 256, OPT_EMPAQUE, OPT_EVENTOS_TRAZA, OPT_LOG_INTERVALO,
+           OPT_LOG_NIVEL, OPT_LOG_MUESTREO, OPT_LOG_LIMITE, OPT_REPLAY, OPT_REPLAY_VELOCIDAD,
+           OPT_LLEGADAS, OPT_TASA, OPT_MMPP, OPT_COLA_MAX, OPT_SHM, OPT_PROCESO,
+           OPT_JOURNAL, OPT_JOURNAL_INTERVALO, OPT_JOURNAL_LOTE, OPT_SNAPSHOT, OPT_SNAPSHOT_INTERVALO,
+           OPT_CARRILES, OPT_AFINIDAD, OPT_PAGINAS, OPT_PREFAULT, OPT_MLOCK, OPT_MODO, OPT_TRABAJADORES,
+           OPT_LLENO, OPT_PRIORIDADES, OPT_ENVEJECIMIENTO, OPT_ETAPA,
+           OPT_GRUPO };
+    static const struct option opciones[] = {
+        { "capacidad",   required_argument, NULL, 'b' },
+        { "cajeros",     required_argument, NULL, 'c' },
+        { "empacadores", required_argument, NULL, 'e' },
+        { "backend",     required_argument, NULL, 'k' },
+        { "duracion",    required_argument, NULL, 'd' },
+        { "items",       required_argument, NULL, 'n' },
+        { "escaneo",     required_argument, NULL, OPT_ESCANEO },
+        { "empaque",     required_argument, NULL, OPT_EMPAQUE },
+        { "llegadas",    required_argument, NULL, OPT_LLEGADAS },
+        { "tasa",        required_argument, NULL, OPT_TASA },
+        { "mmpp",        required_argument, NULL, OPT_MMPP },
+        { "cola-max",    required_argument, NULL, OPT_COLA_MAX },
+        { "replay",      required_argument, NULL, OPT_REPLAY },
+        { "carriles",    required_argument, NULL, OPT_CARRILES },
+        { "afinidad",    required_argument, NULL, OPT_AFINIDAD },
+        { "paginas",     required_argument, NULL, OPT_PAGINAS },
+        { "prefault",    no_argument,       NULL, OPT_PREFAULT },
+        { "mlock",       no_argument,       NULL, OPT_MLOCK },
+        { "lleno",       required_argument, NULL, OPT_LLENO },
+        { "prioridades", required_argument, NULL, OPT_PRIORIDADES },
+        { "envejecimiento", required_argument, NULL, OPT_ENVEJECIMIENTO },
+        { "etapa",       required_argument, NULL, OPT_ETAPA },
+        { "grupo",       required_argument, NULL, OPT_GRUPO },
+        { "modo",        required_argument, NULL, OPT_MODO },
+        { "trabajadores", required_argument, NULL, OPT_TRABAJADORES },
+        { "shm",         required_argument, NULL, OPT_SHM },
+        { "proceso",     required_argument, NULL, OPT_PROCESO },
+        { "journal",     required_argument, NULL, OPT_JOURNAL },
+        { "journal-intervalo", required_argument, NULL, OPT_JOURNAL_INTERVALO },
+        { "journal-lote",      required_argument, NULL, OPT_JOURNAL_LOTE },
+        { "snapshot",          required_argument, NULL, OPT_SNAPSHOT },
+        { "snapshot-intervalo", required_argument, NULL, OPT_SNAPSHOT_INTERVALO },
+        { "replay-velocidad", required_argument, NULL, OPT_REPLAY_VELOCIDAD },
+        { "silencioso",  no_argument,       NULL, 'q' },
+        { "reporte",     required_argument, NULL, 'r' },
+        { "metricas",    required_argument, NULL, 'm' },
+        { "traza",       required_argument, NULL, 't' },
+        { "traza-eventos", required_argument, NULL, OPT_EVENTOS_TRAZA },
+        { "log-binario", required_argument, NULL, 'l' },
+        { "log-archivo", required_argument, NULL, 'L' },
+        { "log-intervalo", required_argument, NULL, OPT_LOG_INTERVALO },
+        { "log-nivel",     required_argument, NULL, OPT_LOG_NIVEL },
+        { "log-muestreo",  required_argument, NULL, OPT_LOG_MUESTREO },
+        { "log-limite",    required_argument, NULL, OPT_LOG_LIMITE },
+        { "barrido",     no_argument,       NULL, 'S' },
+        { "csv",         required_argument, NULL, 'o' },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ((opt = getopt_long(argc, argv, "b:c:e:k:d:n:qr:m:t:l:L:So:h", opciones, NULL)) != -1) {
+        int ok = 0;
+        switch (opt) {
+        case 'b': ok = parsear_lista(optarg, &capacidades);  break;
+        case 'c': ok = parsear_lista(optarg, &cajeros);      break;
+        case 'e': ok = parsear_lista(optarg, &empacadores);  break;
+        case 'k': ok = parsear_backends(optarg, &backends);  break;
+        case 'd': cfg.duracion_seg = atoi(optarg); ok = cfg.duracion_seg > 0 ? 0 : -1; break;
+        case 'n': cfg.max_items    = atol(optarg); ok = cfg.max_items    > 0 ? 0 : -1; break;
+        case OPT_ESCANEO: ok = parsear_distribucion(optarg, &cfg.escaneo); break;
+        case OPT_EMPAQUE: ok = parsear_distribucion(optarg, &cfg.empaque); break;
+        case OPT_LLEGADAS: ok = parsear_llegadas(optarg, &cfg.llegadas); break;
+        case OPT_TASA:     cfg.tasa_llegadas = atof(optarg); ok = cfg.tasa_llegadas > 0.0 ? 0 : -1; break;
+        case OPT_MMPP:     ok = sscanf(optarg, "%lf,%lf,%lf", &cfg.mmpp_factor, &cfg.mmpp_normal_ms, &cfg.mmpp_rafaga_ms) == 3 &&
+                                cfg.mmpp_factor > 0.0 && cfg.mmpp_normal_ms > 0.0 && cfg.mmpp_rafaga_ms > 0.0 ? 0 : -1; break;
+        case OPT_COLA_MAX: cfg.cola_max = atoi(optarg); ok = cfg.cola_max > 0 ? 0 : -1; break;
+        case OPT_REPLAY:  cfg.ruta_replay = optarg; break;
+        case OPT_CARRILES: ok = parsear_lista(optarg, &carriles_l);   break;
+        case OPT_AFINIDAD: ok = parsear_afinidades(optarg, &afinidades); break;
+        case OPT_PAGINAS:  ok = parsear_paginas(optarg, &cfg.paginas); break;
+        case OPT_PREFAULT: cfg.prefault = 1; break;
+        case OPT_MLOCK:    cfg.mlock    = 1; break;
+        case OPT_LLENO:    ok = parsear_lleno(optarg, &cfg.lleno, &cfg.lleno_timeout_ms); break;
+        case OPT_PRIORIDADES: ok = parsear_prioridades(optarg, &cfg.prioridades, cfg.pesos_prioridad); break;
+        case OPT_ENVEJECIMIENTO: cfg.envejecimiento_ms = atoi(optarg); ok = cfg.envejecimiento_ms >= 0 ? 0 : -1; break;
+        case OPT_ETAPA:
+            ok = cfg.num_etapas < MAX_ETAPAS ? parsear_etapa(optarg, &cfg.etapas[cfg.num_etapas]) : -1;
+            if (ok == 0) cfg.num_etapas++;
+            break;
+        case OPT_GRUPO:
+            ok = cfg.num_grupos < MAX_GRUPOS ? parsear_grupo(optarg, &cfg.grupos[cfg.num_grupos]) : -1;
+            if (ok == 0) cfg.num_grupos++;
+            break;
+        case OPT_MODO:     ok = parsear_modo(optarg, &cfg.modo); break;
+        case OPT_TRABAJADORES: cfg.trabajadores = atoi(optarg); ok = cfg.trabajadores > 0 ? 0 : -1; break;
+        case OPT_SHM:     cfg.ruta_shm    = optarg; ok = optarg[0] == '/' ? 0 : -1; break;
+        case OPT_PROCESO: ok = parsear_proceso(optarg, &cfg.proceso); break;
+        case OPT_JOURNAL: cfg.ruta_journal = optarg; break;
+        case OPT_JOURNAL_INTERVALO: ok = parsear_lista(optarg, &intervalos); break;
+        case OPT_JOURNAL_LOTE: cfg.journal_lote = atoi(optarg); ok = cfg.journal_lote > 0 ? 0 : -1; break;
+        case OPT_SNAPSHOT: cfg.ruta_snapshot = optarg; break;
+        case OPT_SNAPSHOT_INTERVALO: cfg.snapshot_ms = atoi(optarg); ok = cfg.snapshot_ms > 0 ? 0 : -1; break;
+        case OPT_REPLAY_VELOCIDAD: cfg.replay_velocidad = atof(optarg); ok = cfg.replay_velocidad >= 0.0 ? 0 : -1; break;
+        case 'q': cfg.log_nivel = LOG_RESUMEN; break;
+        case 'r': cfg.reporte_ms = atoi(optarg); ok = cfg.reporte_ms > 0 ? 0 : -1; break;
+        case 'm': cfg.ruta_metricas = optarg; break;
+        case 't': cfg.ruta_traza    = optarg; break;
+        case 'l': cfg.ruta_log_binario = optarg; break;
+        case 'L': cfg.ruta_log         = optarg; break;
+        case OPT_LOG_INTERVALO: cfg.log_intervalo_ms = atoi(optarg); ok = cfg.log_intervalo_ms >= 0 ? 0 : -1; break;
+        case OPT_LOG_NIVEL:     ok = parsear_nivel_log(optarg, &cfg.log_nivel); break;
+        case OPT_LOG_MUESTREO:  cfg.log_muestreo   = atoi(optarg); ok = cfg.log_muestreo   > 0  ? 0 : -1; break;
+        case OPT_LOG_LIMITE:    cfg.log_limite_eps = atol(optarg); ok = cfg.log_limite_eps >= 0 ? 0 : -1; break;
+        case OPT_EVENTOS_TRAZA: cfg.eventos_traza = atoi(optarg); ok = cfg.eventos_traza > 0 ? 0 : -1; break;
+        case 'S': barrido = 1;         break;
+        case 'o': ruta_csv = optarg;   break;
+        case 'h': uso(argv[0]); return 0;
+        default:  uso(argv[0]); return 1;
+        }
+        if (ok != 0) {
+            fprintf(stderr, "Error: valor inválido para la opción -%c: '%s'\n",
+                    opt < 256 ? opt : '-', optarg);
+            return 1;
+        }
+    }
+
+    // Capacidades y números de hilos deben ser al menos 1
+    if (capacidades.v[0] < 1 || cajeros.v[0] < 1 || empacadores.v[0] < 1) {
+        fprintf(stderr, "Error: capacidad, cajeros y empacadores deben ser >= 1\n");
+        return 1;
+    }
+
+    if (cfg.ruta_shm && barrido) {
+        fprintf(stderr, "Error: --shm no admite --barrido\n");
+        return 1;
+    }
+    if (cfg.proceso != PROCESO_AMBOS && !cfg.ruta_shm) {
+        fprintf(stderr, "Error: --proceso requiere --shm\n");
+        return 1;
+    }
+    if (cfg.ruta_replay && cfg.llegadas != LLEGADAS_CERRADO) {
+        fprintf(stderr, "Error: --replay y --llegadas son excluyentes\n");
+        return 1;
+    }
+    if (cfg.ruta_journal && cfg.ruta_shm) {
+        fprintf(stderr, "Error: --journal no admite --shm\n");
+        return 1;
+    }
+    int k, varios_carriles = 0;
+    for (k = 0; k < carriles_l.n; k++) {
+        if (carriles_l.v[k] < 1 || carriles_l.v[k] > MAX_CARRILES) {
+            fprintf(stderr, "Error: --carriles debe estar entre 1 y %d\n", MAX_CARRILES);
+            return 1;
+        }
+        varios_carriles |= carriles_l.v[k] > 1;
+    }
+    if (varios_carriles && (cfg.ruta_shm || cfg.ruta_journal || cfg.ruta_replay)) {
+        fprintf(stderr, "Error: --carriles > 1 no admite --shm, --journal ni --replay\n");
+        return 1;
+    }
+    if (cfg.lleno == LLENO_DESCARTAR_VIEJO && cfg.ruta_journal) {
+        // El journal no registra los productos reemplazados sin empacar
+        fprintf(stderr, "Error: --lleno descartar-viejo no admite --journal\n");
+        return 1;
+    }
+    if (cfg.prioridades > 1 && cfg.ruta_journal) {
+        // El journal y los snapshots guardan un solo buffer circular
+        fprintf(stderr, "Error: --prioridades no admite --journal\n");
+        return 1;
+    }
+    if (cfg.num_etapas > 0 && (cfg.modo != MODO_HILOS || cfg.ruta_shm || cfg.ruta_journal)) {
+        // Los trabajadores de las etapas son hilos del proceso y los
+        // productos dejan de estar en el journal al empacarse
+        fprintf(stderr, "Error: --etapa requiere --modo hilos y no admite --shm ni --journal\n");
+        return 1;
+    }
+    if (cfg.num_grupos > 0 && (cfg.modo != MODO_HILOS || cfg.ruta_shm || cfg.ruta_journal || varios_carriles ||
+                               cfg.prioridades > 1 || cfg.lleno != LLENO_BLOQUEAR)) {
+        // Los grupos leen un solo anillo en orden de secuencia y cada
+        // espacio se libera cuando lo pasaron todos
+        fprintf(stderr, "Error: --grupo requiere --modo hilos y no admite --shm, --journal, --carriles > 1, "
+                        "--prioridades ni --lleno distinto de bloquear\n");
+        return 1;
+    }
+    if (cfg.ruta_snapshot && !cfg.ruta_journal) {
+        fprintf(stderr, "Error: --snapshot requiere --journal\n");
+        return 1;
+    }
+    if (cfg.modo != MODO_HILOS) {
+        // Las corrutinas se suspenden solo en el semáforo manual y en un solo proceso
+        for (k = 0; k < backends.n; k++) {
+            if (backends.v[k] != BACKEND_MANUAL) {
+                fprintf(stderr, "Error: --modo %s requiere --backend manual\n", nombres_modo[cfg.modo]);
+                return 1;
+            }
+        }
+        for (k = 0; k < afinidades.n; k++) {
+            if (afinidades.v[k] != AFINIDAD_NINGUNA) {
+                fprintf(stderr, "Error: --modo %s no admite --afinidad\n", nombres_modo[cfg.modo]);
+                return 1;
+            }
+        }
+        if (cfg.ruta_shm) {
+            fprintf(stderr, "Error: --modo %s no admite --shm\n", nombres_modo[cfg.modo]);
+            return 1;
+        }
+    } else if (cfg.trabajadores > 0) {
+        fprintf(stderr, "Error: --trabajadores requiere --modo corrutinas o epoll\n");
+        return 1;
+    }
+
+    // La traza se mapea una sola vez y se comparte entre corridas del barrido
+    if (cfg.ruta_replay && replay_abrir(cfg.ruta_replay) != 0) {
+        perror(cfg.ruta_replay);
+        return 1;
+    }
+
+    // ===== MODO BARRIDO =====
+    if (barrido) {
+        FILE *csv = ruta_csv ? fopen(ruta_csv, "w") : stdout;
+        if (!csv) { perror(ruta_csv); replay_cerrar(); return 1; }
+        cfg.log_nivel = LOG_OFF;  // Los eventos individuales no se imprimen en un barrido
+        int rc = ejecutar_barrido(csv, &capacidades, &cajeros, &empacadores, &backends, &intervalos,
+                                  &carriles_l, &afinidades);
+        liberar_estadisticas();
+        replay_cerrar();
+        if (csv != stdout) fclose(csv);
+        return rc == 0 ? 0 : 1;
+    }
+
+    if (capacidades.n > 1 || cajeros.n > 1 || empacadores.n > 1 || backends.n > 1 || intervalos.n > 1 ||
+        carriles_l.n > 1 || afinidades.n > 1) {
+        fprintf(stderr, "Error: las listas con varios valores requieren --barrido\n");
+        return 1;
+    }
+    cfg.capacidad       = capacidades.v[0];
+    cfg.num_cajeros     = cajeros.v[0];
+    cfg.num_empacadores = empacadores.v[0];
+    cfg.backend         = (Backend)backends.v[0];
+    cfg.journal_intervalo_ms = intervalos.v[0];
+    cfg.carriles             = carriles_l.v[0];
+    cfg.afinidad             = (Afinidad)afinidades.v[0];
+
+    // Cada proceso corre solo los hilos de su rol sobre el área compartida
+    if (cfg.proceso == PROCESO_PRODUCTOR)  cfg.num_empacadores = 0;
+    if (cfg.proceso == PROCESO_CONSUMIDOR) cfg.num_cajeros     = 0;
 
     // ===== IMPRIME ENCABEZADO DE LA SIMULACIÓN =====
     printf("--------------------------------------------------------------------------------\n");
@@ -390,60 +7657,181 @@ int main(void)
     printf("--------------------------------------------------------------------------------\n");
     printf("    Bounded Buffer - Semáforos + Mutex\n");
     printf("    Simulación Supermercado\n\n");
-    printf("    Buffer - Área Empaque: %d Productos\n", BUFFER_SIZE);
-    printf("    Cajeros - Productores: %d\n", NUM_CAJEROS);
-    printf("    Empacadores - Consumidores: %d\n\n", NUM_EMPACADORES);
-    printf("    Duración Simulación: %d Segundos\n", DURACION_SEG);
-    printf("--------------------------------------------------------------------------------\n");
-
-    // ===== INICIALIZA PRIMITIVAS DE SINCRONIZACIÓN =====
-    // sem_empty: inicializa con BUFFER_SIZE (todos los espacios vacíos)
-    sem_inicializar(&sem_empty, BUFFER_SIZE);
-    // sem_full: inicializa con 0 (ningún producto disponible)
-    sem_inicializar(&sem_full,  0);
-    // mutex: para proteger acceso al buffer compartido
-    pthread_mutex_init(&mutex, NULL);
-
-    // ===== CREA HILOS =====
-    // Crea hilo temporizador que controlará la duración
-    pthread_create(&hilo_timer, NULL, temporizador, NULL);
-
-    // Crea hilos cajeros (productores)
-    for (i = 0; i < NUM_CAJEROS; i++) {
-        int *id = malloc(sizeof(int));  // Asigna memoria para ID único
-        *id = i + 1;                    // ID comienza en 1
-        pthread_create(&hilos_cajero[i], NULL, cajero, id);
+    printf("    Buffer - Área Empaque: %d Productos\n", cfg.capacidad);
+    printf("    Cajeros - Productores: %d\n", cfg.num_cajeros);
+    printf("    Empacadores - Consumidores: %d\n\n", cfg.num_empacadores);
+    printf("    Duración Simulación: %d Segundos\n", cfg.duracion_seg);
+    char dist[96];
+    describir_distribucion(&cfg.escaneo, dist, sizeof(dist));
+    printf("    Tiempo de Escaneo: %s\n", dist);
+    describir_distribucion(&cfg.empaque, dist, sizeof(dist));
+    printf("    Tiempo de Empacado: %s\n", dist);
+    if (cfg.carriles > 1 || cfg.afinidad != AFINIDAD_NINGUNA) {
+        printf("    Carriles: %d (afinidad %s)\n", cfg.carriles, nombres_afinidad[cfg.afinidad]);
     }
-
-    // Crea hilos empacadores (consumidores)
-    for (i = 0; i < NUM_EMPACADORES; i++) {
-        int *id = malloc(sizeof(int));  // Asigna memoria para ID único
-        *id = i + 1;                    // ID comienza en 1
-        pthread_create(&hilos_empacador[i], NULL, empacador, id);
+    if (cfg.modo == MODO_CORRUTINAS) {
+        if (cfg.trabajadores > 0) printf("    Ejecución: corrutinas sobre %d hilos\n", cfg.trabajadores);
+        else                      printf("    Ejecución: corrutinas sobre un hilo por CPU\n");
+    } else if (cfg.modo == MODO_EPOLL) {
+        printf("    Ejecución: corrutinas sobre un bucle epoll en %d hilo(s)\n", cfg.trabajadores > 0 ? cfg.trabajadores : 1);
     }
+    if (cfg.num_etapas > 0) {
+        printf("    Pipeline: escanear -> empacar");
+        for (int k = 0; k < cfg.num_etapas; k++) {
+            describir_distribucion(&cfg.etapas[k].servicio, dist, sizeof(dist));
+            printf(" -> %s (%d hilos, cola %d, %s)", cfg.etapas[k].nombre, cfg.etapas[k].hilos,
+                   cfg.etapas[k].capacidad, dist);
+        }
+        printf("\n");
+    }
+    if (cfg.num_grupos > 0) {
+        printf("    Grupos: empacar (%d hilos)", cfg.num_empacadores);
+        for (int k = 0; k < cfg.num_grupos; k++) {
+            describir_distribucion(&cfg.grupos[k].servicio, dist, sizeof(dist));
+            printf(" | %s (%d hilos, %s)", cfg.grupos[k].nombre, cfg.grupos[k].hilos, dist);
+        }
+        printf("\n");
+    }
+    if (cfg.prioridades > 1) {
+        printf("    Prioridades: %d clases, pesos", cfg.prioridades);
+        for (int c = 0; c < cfg.prioridades; c++) printf("%s%d", c ? "/" : " ", cfg.pesos_prioridad[c]);
+        if (cfg.envejecimiento_ms > 0) printf(" (envejecimiento %d ms)\n", cfg.envejecimiento_ms);
+        else                           printf(" (sin envejecimiento)\n");
+    }
+    if (cfg.lleno == LLENO_TIMEOUT) {
+        printf("    Área Llena: timeout de %d ms, después se descarta\n", cfg.lleno_timeout_ms);
+    } else if (cfg.lleno != LLENO_BLOQUEAR) {
+        printf("    Área Llena: %s\n", nombres_lleno[cfg.lleno]);
+    }
+    if (cfg.ruta_shm) printf("    Memoria Compartida: %s (proceso %s)\n", cfg.ruta_shm, nombres_proceso[cfg.proceso]);
+    if (cfg.ruta_replay) printf("    Llegadas: replay de %s (x%.2f)\n", cfg.ruta_replay, cfg.replay_velocidad);
+    if (cfg.llegadas != LLEGADAS_CERRADO) {
+        printf("    Llegadas: %s a %.1f productos/s (cola máx. %d por cajero)\n",
+               nombres_llegadas[cfg.llegadas], cfg.tasa_llegadas, cfg.cola_max);
+    }
+    if (cfg.ruta_journal) {
+        printf("    Journal: %s (fdatasync cada %d ms o %d registros)\n",
+               cfg.ruta_journal, cfg.journal_intervalo_ms, cfg.journal_lote);
+    }
+    if (cfg.ruta_snapshot) printf("    Snapshot: %s (cada %d ms)\n", cfg.ruta_snapshot, cfg.snapshot_ms);
+    printf("--------------------------------------------------------------------------------\n");
 
-    // ===== ESPERA A QUE TODOS LOS HILOS TERMINEN =====
-    // Primero espera al temporizador (controla la duración)
-    pthread_join(hilo_timer, NULL);
-    // Luego espera a que todos los cajeros terminen
-    for (i = 0; i < NUM_CAJEROS;     i++) pthread_join(hilos_cajero[i],    NULL);
-    // Finalmente espera a que todos los empacadores terminen
-    for (i = 0; i < NUM_EMPACADORES; i++) pthread_join(hilos_empacador[i], NULL);
+    ResultadoCorrida r;
+    if (ejecutar_simulacion(&r) != 0) {
+        fprintf(stderr, "Error: no se pudo reservar memoria para la simulación\n");
+        return 1;
+    }
 
     // ===== IMPRIME ESTADÍSTICAS FINALES =====
     printf("--------------------------------------------------------------------------------\n");
     printf("                                FIN SIMULACIÓN \n");
     printf("--------------------------------------------------------------------------------\n");
-    printf("  Productos Escaneados - Producidos: %d\n", total_producidos);
-    printf("  Productos Empacados - consumidos: %d\n", total_consumidos);
-    printf("  Productos en el Área de Empaque en el Fin: %d\n", total_producidos - total_consumidos);
+    printf("  Productos Escaneados - Producidos: %ld\n", r.producidos);
+    printf("  Productos Empacados - consumidos: %ld\n", r.consumidos);
+    printf("  Productos en el Área de Empaque en el Fin: %ld\n",
+           r.producidos - r.consumidos - (long)r.lleno_sobrescritos);
+    printf("  Throughput: %.2f productos/s\n", r.throughput);
+    printf("  Espera en Área de Empaque: p50 %.3f ms | p99 %.3f ms\n", r.lat_p50_ms, r.lat_p99_ms);
+    printf("  Ocupación Media del Área: %.2f/%d\n", r.ocupacion_media, cfg.capacidad * r.carriles);
+    if (cfg.paginas != PAGINAS_NORMALES || cfg.prefault || cfg.mlock) {
+        printf("  Memoria del Área: páginas %s | reserva %.3f ms%s%s\n", r.paginas, r.reserva_ms,
+               cfg.prefault ? " | prefault" : "", cfg.mlock ? (r.bloqueada ? " | mlock" : " | mlock falló") : "");
+    }
+    printf("  Fallos de Página Durante la Corrida: %ld\n", r.fallos_pagina);
+    if (r.trabajadores > 0) {
+        printf("  Corrutinas: %d sobre %d hilos | %llu cambios de contexto\n",
+               cfg.num_cajeros + cfg.num_empacadores, r.trabajadores, (unsigned long long)r.cambios_contexto);
+    }
+    if (cfg.modo == MODO_EPOLL) {
+        printf("  Bucle epoll: %llu epoll_wait | %llu avisos eventfd de semáforos\n",
+               (unsigned long long)r.bucle_esperas, (unsigned long long)r.bucle_avisos);
+    }
+    printf("  Rueda de Tiempos: %llu plazos | %llu cascadas | %llu despertares del reloj\n",
+           (unsigned long long)r.rueda_eventos, (unsigned long long)r.rueda_cascadas,
+           (unsigned long long)r.despertares_reloj);
+    if (r.carriles > 1) {
+        printf("  Throughput por Carril:");
+        for (int c = 0; c < r.carriles && c < MAX_CARRILES; c++) {
+            printf(" %s#%d %.2f/s", c ? "| " : "", c + 1,
+                   r.segundos > 0 ? (double)r.consumidos_carril[c] / r.segundos : 0.0);
+        }
+        printf("\n");
+    }
+    printf("  Tiempo Bloqueado: cajeros %.1f%% | empacadores %.1f%%\n",
+           r.bloqueo_cajeros_pct, r.bloqueo_empacadores_pct);
+    if (cfg.lleno != LLENO_BLOQUEAR) {
+        printf("  Área Llena (%s): %llu descartados | %llu sobrescritos | %llu expirados | %llu rechazados\n",
+               nombres_lleno[cfg.lleno], (unsigned long long)r.lleno_descartados,
+               (unsigned long long)r.lleno_sobrescritos, (unsigned long long)r.lleno_expirados,
+               (unsigned long long)r.lleno_rechazados);
+    }
+    if (r.prioridades > 1) {
+        printf("  Espera por Prioridad:");
+        for (int c = 0; c < r.prioridades; c++) {
+            printf(" %sP%d %llu prod. p50 %.3f ms p99 %.3f ms", c ? "| " : "", c,
+                   (unsigned long long)r.clase_empacados[c], r.clase_p50_ms[c], r.clase_p99_ms[c]);
+        }
+        printf("\n  Promovidos por Envejecimiento: %ld\n", r.promovidos);
+    }
+    if (r.num_etapas > 0) {
+        printf("  Pipeline:\n");
+        for (int k = 0; k < r.num_etapas; k++) {
+            const ResultadoEtapa *e = &r.etapas[k];
+            char cola[32] = "-";
+            if (e->capacidad > 0) snprintf(cola, sizeof(cola), "%.2f/%d", e->ocupacion_media, e->capacidad);
+            printf("    %-12s %3d hilos | %9.2f/s | cola %-10s | espera p50 %.3f ms p99 %.3f ms | "
+                   "utilización %5.1f%% | bloqueo %5.1f%%\n",
+                   e->nombre, e->hilos, r.segundos > 0 ? (double)e->procesados / r.segundos : 0.0, cola,
+                   e->espera_p50_ms, e->espera_p99_ms, e->utilizacion_pct, e->bloqueo_pct);
+        }
+        printf("  Cuello de Botella: %s (utilización %.1f%%)\n",
+               r.etapas[r.cuello_botella].nombre, r.etapas[r.cuello_botella].utilizacion_pct);
+        printf("  Tiempo en el Pipeline: p50 %.3f ms | p99 %.3f ms\n", r.pipeline_p50_ms, r.pipeline_p99_ms);
+    }
+    if (r.num_grupos > 0) {
+        printf("  Grupos de Consumidores (cada uno ve todos los productos):\n");
+        for (int k = 0; k < r.num_grupos; k++) {
+            const ResultadoEtapa *e = &r.grupos[k];
+            printf("    %-12s %3d hilos | %8llu prod. | %9.2f/s | espera p50 %.3f ms p99 %.3f ms | "
+                   "utilización %5.1f%% | bloqueo %5.1f%%\n",
+                   e->nombre, e->hilos, (unsigned long long)e->procesados,
+                   r.segundos > 0 ? (double)e->procesados / r.segundos : 0.0,
+                   e->espera_p50_ms, e->espera_p99_ms, e->utilizacion_pct, e->bloqueo_pct);
+        }
+        printf("  Grupo más Atrasado: %s (retiene los espacios del área)\n", r.grupos[r.grupo_lento].nombre);
+    }
+    if (cfg.llegadas != LLEGADAS_CERRADO) {
+        double n = r.llegadas > 0 ? (double)r.llegadas : 1.0;
+        printf("  Llegadas: %llu | retrasadas %llu (%.1f%%) | descartadas %llu (%.1f%%)\n",
+               (unsigned long long)r.llegadas,
+               (unsigned long long)r.retrasados,  100.0 * (double)r.retrasados  / n,
+               (unsigned long long)r.descartados, 100.0 * (double)r.descartados / n);
+        printf("  Latencia desde la Llegada: p50 %.3f ms | p99 %.3f ms | p99.9 %.3f ms\n",
+               r.llegada_p50_ms, r.llegada_p99_ms, r.llegada_p999_ms);
+    }
+    if (cfg.ruta_journal) {
+        printf("  Journal: %llu registros | %llu fdatasync (lote medio %.1f, %.3f ms c/u) | recuperados %d\n",
+               (unsigned long long)r.journal_registros, (unsigned long long)r.journal_fsyncs,
+               r.journal_lote_medio, r.journal_fsync_ms, r.journal_recuperados);
+        printf("  Espera de Durabilidad por Producto: %.3f ms\n", r.journal_espera_ms);
+        printf("  Recuperación: %.3f ms (%s + %llu registros del journal)\n", r.recuperacion_ms,
+               r.snapshot_cargado ? "snapshot" : "sin snapshot", (unsigned long long)r.journal_cola);
+        if (cfg.ruta_snapshot) {
+            printf("  Snapshots: %llu | pausa media %.3f ms, máx. %.3f ms | %llu bytes escritos\n",
+                   (unsigned long long)r.snapshots, r.snapshot_pausa_ms, r.snapshot_pausa_max_ms,
+                   (unsigned long long)r.snapshot_bytes);
+        }
+        if (r.journal_error) printf("  Journal: error de escritura (%s)\n", strerror(r.journal_error));
+    }
+    if (r.eventos_descartados > 0) {
+        printf("  Log de Eventos (%s): %llu escritos | %llu omitidos\n", nombres_nivel_log[cfg.log_nivel],
+               (unsigned long long)r.eventos_escritos, (unsigned long long)r.eventos_descartados);
+    }
+    printf("--------------------------------------------------------------------------------\n");
+    imprimir_utilizacion(&r);
     printf("--------------------------------------------------------------------------------\n");
 
-    // ===== LIMPIA RECURSOS =====
-    // Destruye las primitivas de sincronización para liberar recursos
-    sem_destruir(&sem_empty);
-    sem_destruir(&sem_full);
-    pthread_mutex_destroy(&mutex);
-
+    liberar_estadisticas();
+    replay_cerrar();
     return 0;
-}
\ No newline at end of file
+}
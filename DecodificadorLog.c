@@ -0,0 +1,150 @@
+/*
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ * DecodificadorLog.c
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ * UNIVERSIDAD DEL VALLE DE GUATEMALA
+ * Sistemas Operativos
+ *
+ * Descripción: Convierte el log binario que genera BoundedBuffer --log-binario al formato de texto de log_evento o a CSV.
+ *
+ *              Por defecto procesa los registros en el orden del archivo (por bloques de cada hilo) leyendo de forma secuencial, por lo que
+ *              funciona con archivos de cualquier tamaño. Con --ordenar carga el archivo en memoria y ordena los eventos por tiempo.
+ *
+ * Compilación: gcc -O2 -Wall DecodificadorLog.c -o DecodificadorLog
+ * Uso:         ./DecodificadorLog [--csv] [--ordenar] ARCHIVO
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "LogBinario.h"
+
+#define REGISTROS_POR_LECTURA 4096
+
+/**
+ * Imprime un registro en el formato elegido
+ *
+ * Parámetros:
+ *   enc: Encabezado del archivo (catálogo, capacidad, tiempo base)
+ *   r:   Registro a imprimir
+ *   csv: 1 = fila CSV, 0 = línea igual a log_evento
+ */
+static void imprimir_registro(const EncabezadoLog *enc, const RegistroLog *r, int csv)
+{
+    unsigned    rol      = LOG_ROL(r);
+    unsigned    accion   = LOG_ACCION(r);
+    const char *producto = r->catalogo < enc->num_productos ? enc->catalogo[r->catalogo] : "?";
+    const char *txt_rol  = rol    < 2 ? nombres_rol[rol]       : "?";
+    const char *txt_acc  = accion < 3 ? nombres_accion[accion] : "?";
+
+    if (csv) {
+        printf("%llu,%s,%u,%s,%s,%u,%u\n", (unsigned long long)(enc->t_base_real_ns + r->ts_ns),
+               txt_rol, r->id, txt_acc, producto, r->ocupados, enc->capacidad);
+        return;
+    }
+
+    time_t    t = (time_t)((enc->t_base_real_ns + r->ts_ns) / 1000000000ull);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    printf("[%02d:%02d:%02d] %-10s #%d | %-35s | Producto: %-10s | Buffer: %u/%u\n",
+           tm.tm_hour, tm.tm_min, tm.tm_sec,
+           txt_rol, r->id, txt_acc, producto, r->ocupados, enc->capacidad);
+}
+
+static int comparar_ts(const void *a, const void *b)
+{
+    uint64_t x = ((const RegistroLog *)a)->ts_ns, y = ((const RegistroLog *)b)->ts_ns;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Valida el encabezado del archivo
+ *
+ * Retorna:
+ *   0 si el archivo es un log binario compatible, -1 en caso contrario
+ */
+static int validar_encabezado(EncabezadoLog *enc)
+{
+    if (memcmp(enc->magia, LOG_MAGIA, sizeof(enc->magia)) != 0) {
+        fprintf(stderr, "Error: el archivo no es un log binario de BoundedBuffer\n");
+        return -1;
+    }
+    if (enc->version != LOG_VERSION || enc->tam_registro != sizeof(RegistroLog)) {
+        fprintf(stderr, "Error: versión %u / registro de %u bytes no soportados\n",
+                enc->version, enc->tam_registro);
+        return -1;
+    }
+    if (enc->num_productos > LOG_MAX_CATALOGO) enc->num_productos = LOG_MAX_CATALOGO;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int csv = 0, ordenar = 0, opt;
+    static const struct option opciones[] = {
+        { "csv",     no_argument, NULL, 'c' },
+        { "ordenar", no_argument, NULL, 's' },
+        { "help",    no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ((opt = getopt_long(argc, argv, "csh", opciones, NULL)) != -1) {
+        switch (opt) {
+        case 'c': csv = 1;     break;
+        case 's': ordenar = 1; break;
+        default:
+            printf("Uso: %s [--csv] [--ordenar] ARCHIVO\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Uso: %s [--csv] [--ordenar] ARCHIVO\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (!f) { perror(argv[optind]); return 1; }
+
+    EncabezadoLog enc;
+    if (fread(&enc, sizeof(enc), 1, f) != 1 || validar_encabezado(&enc) != 0) {
+        if (!ferror(f) && feof(f)) fprintf(stderr, "Error: archivo truncado\n");
+        fclose(f);
+        return 1;
+    }
+
+    if (csv) printf("ts_real_ns,rol,id,accion,producto,ocupados,capacidad\n");
+
+    // ===== ORDENADO: carga todos los registros y los ordena por tiempo =====
+    if (ordenar) {
+        size_t cap = REGISTROS_POR_LECTURA, n = 0, leidos;
+        RegistroLog *todos = malloc(cap * sizeof(RegistroLog));
+        while (todos && (leidos = fread(todos + n, sizeof(RegistroLog), cap - n, f)) > 0) {
+            n += leidos;
+            if (n == cap) {
+                RegistroLog *mas = realloc(todos, 2 * cap * sizeof(RegistroLog));
+                if (!mas) { free(todos); todos = NULL; break; }
+                todos = mas;
+                cap  *= 2;
+            }
+        }
+        if (!todos) { fprintf(stderr, "Error: memoria insuficiente para --ordenar\n"); fclose(f); return 1; }
+        qsort(todos, n, sizeof(RegistroLog), comparar_ts);
+        for (size_t i = 0; i < n; i++) imprimir_registro(&enc, &todos[i], csv);
+        free(todos);
+        fclose(f);
+        return 0;
+    }
+
+    // ===== SECUENCIAL: orden del archivo, memoria constante =====
+    RegistroLog bloque[REGISTROS_POR_LECTURA];
+    size_t leidos;
+    while ((leidos = fread(bloque, sizeof(RegistroLog), REGISTROS_POR_LECTURA, f)) > 0) {
+        for (size_t i = 0; i < leidos; i++) imprimir_registro(&enc, &bloque[i], csv);
+    }
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ * LogBinario.h
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ * Formato del log binario de eventos compartido por BoundedBuffer.c (escritor) y DecodificadorLog.c (lector).
+ *
+ * Descripción: El archivo empieza con un EncabezadoLog seguido de registros RegistroLog de tamaño fijo. Cada hilo acumula registros en un buffer
+ *              propio y los escribe en bloques, por lo que el archivo está ordenado por hilo y por bloque, no globalmente por tiempo; el
+ *              decodificador puede reordenarlos por 'ts_ns'. Todos los campos se escriben en el orden de bytes de la máquina.
+ * ----------------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef LOG_BINARIO_H
+#define LOG_BINARIO_H
+
+#include <stdint.h>
+
+#define LOG_MAGIA          "SMLOGBIN"
+#define LOG_VERSION        2      // 2: id de 32 bits
+#define LOG_MAX_CATALOGO   32     // Productos que caben en el encabezado
+#define LOG_LARGO_NOMBRE   16     // Bytes por nombre de producto (incluye '\0')
+
+/**
+ * Rol del hilo que genera el evento
+ */
+typedef enum {
+    ROL_CAJERO = 0,
+    ROL_EMPACADOR
+} RolHilo;
+
+/**
+ * Acción registrada (el texto coincide con el log legible)
+ */
+typedef enum {
+    ACCION_COLOCA = 0,          // Cajero dentro de la sección crítica
+    ACCION_TOMA,                // Empacador dentro de la sección crítica
+    ACCION_SALE_SC              // Cualquiera de los dos al salir
+} AccionLog;
+
+static const char *const nombres_rol[]    = { "CAJERO", "EMPACADOR" };
+static const char *const nombres_accion[] = {
+    "ENTRA SC - coloca producto", "ENTRA SC - toma producto", "SALE  SC"
+};
+
+/**
+ * Encabezado del archivo (se escribe una sola vez al inicio)
+ *
+ * magia:           LOG_MAGIA sin terminador
+ * version:         LOG_VERSION
+ * tam_registro:    sizeof(RegistroLog), para validar el archivo
+ * capacidad:       Espacios del área de empaque en la corrida
+ * num_productos:   Entradas válidas de 'catalogo'
+ * t_base_real_ns:  CLOCK_REALTIME en el instante en que ts_ns = 0
+ * catalogo:        Nombres de productos indexados por RegistroLog.catalogo
+ */
+typedef struct {
+    char     magia[8];
+    uint32_t version;
+    uint32_t tam_registro;
+    uint32_t capacidad;
+    uint32_t num_productos;
+    uint64_t t_base_real_ns;
+    char     catalogo[LOG_MAX_CATALOGO][LOG_LARGO_NOMBRE];
+} EncabezadoLog;
+
+/**
+ * Un evento (24 bytes; la línea de texto equivalente ocupa ~105)
+ *
+ * ts_ns:      Nanosegundos desde t_base_real_ns (reloj monotónico)
+ * ocupados:   Espacios ocupados del área después del evento
+ * id:         Número del cajero o empacador (con corrutinas puede haber
+ *             más de 65535)
+ * rol_accion: RolHilo en el bit 7 y AccionLog en los bits 0-6
+ * catalogo:   Índice del producto en el catálogo del encabezado
+ * reservado:  Relleno explícito (se escribe en 0)
+ */
+typedef struct {
+    uint64_t ts_ns;
+    uint32_t ocupados;
+    uint32_t id;
+    uint8_t  rol_accion;
+    uint8_t  catalogo;
+    uint8_t  reservado[6];
+} RegistroLog;
+
+#define LOG_ROL(r)            ((r)->rol_accion >> 7)
+#define LOG_ACCION(r)         ((r)->rol_accion & 0x7f)
+#define LOG_ROL_ACCION(r, a)  (uint8_t)(((r) << 7) | ((a) & 0x7f))
+
+#endif